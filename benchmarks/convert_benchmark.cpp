@@ -0,0 +1,229 @@
+// Sample type conversion benchmark of image_io.h.
+//
+// For every type pair that load_png and save_png convert, a 2048x2048 RGB image is
+// converted between the rows of the file (interleaved, 16-bit samples big-endian) and the
+// planes of Image<T>.  Once with the loops image_io had before the bulk conversions,
+// convert() per sample inside the pixel and channel loops, and once with image_io's row
+// conversions.  The report shows both throughputs in megasamples per second, and the
+// speedup.  Both results are compared, so the benchmark also fails if the bulk conversion
+// is not bit-exact.
+//
+// usage: convert_benchmark
+
+#include <Halide.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "utils/clock.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+static const int width = 2048, height = 2048, channels = 3, runs = 10;
+
+template <typename T>
+static void randomize(Image<T> &im) {
+    for (int c=0; c<im.channels(); c++)
+        for (int y=0; y<im.height(); y++)
+            for (int x=0; x<im.width(); x++)
+                convert((uint16_t)rand(), im(x, y, c));
+}
+
+template <>
+void randomize(Image<uint8_t> &im) {
+    for (int c=0; c<im.channels(); c++)
+        for (int y=0; y<im.height(); y++)
+            for (int x=0; x<im.width(); x++)
+                im(x, y, c) = (uint8_t)rand();
+}
+
+// File rows of 'bytes' bytes per sample
+struct file_rows {
+    file_rows(int bytes) : bytes(bytes), data((size_t)width * height * channels * bytes) {
+        for (size_t i=0; i<data.size(); i++)
+            data[i] = (uint8_t)rand();
+    }
+    uint8_t *row(int y) { return &data[(size_t)y * width * channels * bytes]; }
+
+    int bytes;
+    std::vector<uint8_t> data;
+};
+
+// The loops of load_png before the bulk conversions
+template <typename T>
+static void scalar_load(file_rows &rows, Image<T> &im) {
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    T *ptr = (T*)im.data();
+    if (rows.bytes == 1) {
+        for (int y = 0; y < im.height(); y++) {
+            uint8_t *srcPtr = rows.row(y);
+            for (int x = 0; x < im.width(); x++) {
+                for (int c = 0; c < im.channels(); c++) {
+                    convert(*srcPtr++, ptr[c*c_stride]);
+                }
+                ptr++;
+            }
+        }
+    } else {
+        for (int y = 0; y < im.height(); y++) {
+            uint8_t *srcPtr = rows.row(y);
+            for (int x = 0; x < im.width(); x++) {
+                for (int c = 0; c < im.channels(); c++) {
+                    uint16_t hi = (*srcPtr++) << 8;
+                    uint16_t lo = hi | (*srcPtr++);
+                    convert(lo, ptr[c*c_stride]);
+                }
+                ptr++;
+            }
+        }
+    }
+}
+
+// The loops of load_png now
+template <typename T>
+static void bulk_load(file_rows &rows, Image<T> &im) {
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    T *ptr = (T*)im.data();
+    if (rows.bytes == 1) {
+        for (int y = 0; y < im.height(); y++) {
+            deinterleave_row(rows.row(y), im.channels(), ptr + y*im.stride(1), c_stride, im.width());
+        }
+    } else {
+        std::vector<uint16_t> row(im.width() * im.channels());
+        for (int y = 0; y < im.height(); y++) {
+            load_be16(rows.row(y), &row[0], (int)row.size());
+            deinterleave_row(&row[0], im.channels(), ptr + y*im.stride(1), c_stride, im.width());
+        }
+    }
+}
+
+// The loops of save_png before the bulk conversions
+template <typename T>
+static void scalar_save(Image<T> &im, file_rows &rows) {
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    T *srcPtr = (T*)im.data();
+    for (int y = 0; y < im.height(); y++) {
+        uint8_t *dstPtr = rows.row(y);
+        if (rows.bytes == 2) {
+            for (int x = 0; x < im.width(); x++) {
+                for (int c = 0; c < im.channels(); c++) {
+                    uint16_t out;
+                    convert(srcPtr[c*c_stride], out);
+                    *dstPtr++ = out >> 8;
+                    *dstPtr++ = out & 0xff;
+                }
+                srcPtr++;
+            }
+        } else {
+            for (int x = 0; x < im.width(); x++) {
+                for (int c = 0; c < im.channels(); c++) {
+                    uint8_t out;
+                    convert(srcPtr[c*c_stride], out);
+                    *dstPtr++ = out;
+                }
+                srcPtr++;
+            }
+        }
+    }
+}
+
+// The loops of save_png now
+template <typename T>
+static void bulk_save(Image<T> &im, file_rows &rows) {
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    T *srcPtr = (T*)im.data();
+    std::vector<uint16_t> row(im.width() * im.channels());
+    for (int y = 0; y < im.height(); y++) {
+        uint8_t *dstPtr = rows.row(y);
+        if (rows.bytes == 2) {
+            interleave_row(srcPtr + y*im.stride(1), im.stride(0), c_stride, im.channels(),
+                           &row[0], im.channels(), im.width());
+            store_be16(&row[0], dstPtr, (int)row.size());
+        } else {
+            interleave_row(srcPtr + y*im.stride(1), im.stride(0), c_stride, im.channels(),
+                           dstPtr, im.channels(), im.width());
+        }
+    }
+}
+
+template <typename A, typename B>
+static double throughput(void (*convert_image)(A &, B &), A &a, B &b) {
+    convert_image(a, b);
+    timings t;
+    for (int r=0; r<runs; r++) {
+        interval iv(t);
+        convert_image(a, b);
+    }
+    double dev = 0;
+    return (double)width * height * channels / 1000.0 / t.mean(dev);
+}
+
+template <typename T>
+static bool same(const Image<T> &a, const Image<T> &b) {
+    return memcmp(a.data(), b.data(), (size_t)width * height * channels * sizeof(T)) == 0;
+}
+
+static bool same(const file_rows &a, const file_rows &b) {
+    return a.data == b.data;
+}
+
+static void report(const char *direction, const char *from, const char *to,
+                   double scalar_rate, double bulk_rate, bool exact) {
+    printf("%-5s %-9s %-9s %10.1f %10.1f %7.2fx %s\n", direction, from, to,
+           scalar_rate, bulk_rate, bulk_rate / scalar_rate, exact ? "" : "MISMATCH");
+}
+
+// From 8 or 16-bit file rows to Image<T>
+template <typename T>
+static bool benchmark_load(const char *name, int bytes) {
+    file_rows rows(bytes);
+    Image<T> scalar(width, height, channels), bulk(width, height, channels);
+    const double scalar_rate = throughput(scalar_load<T>, rows, scalar);
+    const double bulk_rate = throughput(bulk_load<T>, rows, bulk);
+    const bool exact = same(scalar, bulk);
+    report("load", bytes == 1 ? "uint8_t" : "uint16_t", name, scalar_rate, bulk_rate, exact);
+    return exact;
+}
+
+// From Image<T> to file rows, of 8-bit samples for 8-bit types and 16-bit otherwise
+template <typename T>
+static bool benchmark_save(const char *name) {
+    const int bytes = sizeof(T) == 1 ? 1 : 2;
+    Image<T> im(width, height, channels);
+    randomize(im);
+    file_rows scalar(bytes), bulk(bytes);
+    const double scalar_rate = throughput(scalar_save<T>, im, scalar);
+    const double bulk_rate = throughput(bulk_save<T>, im, bulk);
+    const bool exact = same(scalar, bulk);
+    report("save", name, bytes == 1 ? "uint8_t" : "uint16_t", scalar_rate, bulk_rate, exact);
+    return exact;
+}
+
+#define LOAD(T) ok &= benchmark_load<T>(#T, 1) & benchmark_load<T>(#T, 2)
+#define SAVE(T) ok &= benchmark_save<T>(#T)
+
+int main(int argc, const char **argv) {
+    printf("%dx%dx%d samples, file rows <-> Image planes\n", width, height, channels);
+    printf("%-5s %-9s %-9s %10s %10s %8s   (MSamples/s)\n", "", "from", "to", "scalar", "bulk", "speedup");
+
+    bool ok = true;
+    LOAD(uint8_t);
+    LOAD(uint16_t);
+    LOAD(uint32_t);
+    LOAD(int8_t);
+    LOAD(int16_t);
+    LOAD(int32_t);
+    LOAD(float);
+    LOAD(double);
+
+    SAVE(uint8_t);
+    SAVE(uint16_t);
+    SAVE(uint32_t);
+    SAVE(int8_t);
+    SAVE(int16_t);
+    SAVE(int32_t);
+    SAVE(float);
+    SAVE(double);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
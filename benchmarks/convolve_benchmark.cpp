@@ -0,0 +1,151 @@
+// Constant-kernel convolution benchmark.
+//
+// Every 3x3 and 5x5 kernel of the excursions functions runs on a 4096x2048 grayscale
+// int32 image twice: once as the function defines it, a Func of weights summed over an
+// RDom, and once through convolve() with the same weights as a const_kernel.  Both are
+// scheduled by schedule_output.  The report shows both throughputs in megapixels per
+// second, the speedup, and whether the outputs match (exactly for integer kernels, within
+// 1e-3 for the float kernel of fast_unsharp_mask).
+//
+// usage: convolve_benchmark [kernel-name ...]
+
+#include <Halide.h>
+#include <string>
+#include <stdlib.h>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "samples/function_table.h"
+
+static const int width = 4096, height = 2048, runs = 10;
+
+static const int sobel_x[3][3]   = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+static const int sobel_y[3][3]   = { { -1, -2, -1 }, { 0, 0, 0 }, { 1, 2, 1 } };
+static const int scharr_x[3][3]  = { { -3, 0, 3 }, { -10, 0, 10 }, { -3, 0, 3 } };
+static const int scharr_y[3][3]  = { { -3, -10, -3 }, { 0, 0, 0 }, { 3, 10, 3 } };
+static const int prewitt_x[3][3] = { { -1, 0, 1 }, { -1, 0, 1 }, { -1, 0, 1 } };
+static const int prewitt_y[3][3] = { { -1, -1, -1 }, { 0, 0, 0 }, { 1, 1, 1 } };
+static const int gauss_3x3[3][3] = { { 1, 2, 1 }, { 2, 4, 2 }, { 1, 2, 1 } };
+static const int box[3][3]       = { { 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 } };
+static const int gauss_5x5[5][5] = { { 1,  4,  6,  4, 1 },
+                                     { 4, 16, 24, 16, 4 },
+                                     { 6, 24, 36, 24, 6 },
+                                     { 4, 16, 24, 16, 4 },
+                                     { 1,  4,  6,  4, 1 } };
+static const int gauss_5x5_delta14[5][5] = { { 2,  4,  5,  4, 2 },
+                                             { 4,  9, 12,  9, 4 },
+                                             { 5, 12, 15, 12, 5 },
+                                             { 4,  9, 12,  9, 4 },
+                                             { 2,  4,  5,  4, 2 } };
+static const float unsharp_gamma = 5.0f;
+
+namespace rdom {
+static Halide::Func sobel_x(Halide::Func in) { return sobel_3x3<2>(in).first; }
+static Halide::Func sobel_y(Halide::Func in) { return sobel_3x3<2>(in).second; }
+static Halide::Func scharr_x(Halide::Func in) { return scharr_3x3(in, true).first; }
+static Halide::Func scharr_y(Halide::Func in) { return scharr_3x3(in, true).second; }
+static Halide::Func prewitt_x(Halide::Func in) { return prewitt_3x3(in, true).first; }
+static Halide::Func prewitt_y(Halide::Func in) { return prewitt_3x3(in, true).second; }
+static Halide::Func gaussian_3x3(Halide::Func in) { return ::gaussian_3x3<2>(in); }
+static Halide::Func box_3x3(Halide::Func in) { return ::box_3x3<2>(in); }
+static Halide::Func gaussian_5x5(Halide::Func in) { return ::gaussian_5x5<2>(in); }
+static Halide::Func gaussian_5x5_delta14(Halide::Func in) { return ::gaussian_5x5_delta14(in, true); }
+static Halide::Func unsharp(Halide::Func in) { return fast_unsharp_mask(in, unsharp_gamma, true); }
+} // namespace rdom
+
+namespace constant {
+static Halide::Func sobel_x(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::sobel_x)); }
+static Halide::Func sobel_y(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::sobel_y)); }
+static Halide::Func scharr_x(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::scharr_x)); }
+static Halide::Func scharr_y(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::scharr_y)); }
+static Halide::Func prewitt_x(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::prewitt_x)); }
+static Halide::Func prewitt_y(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::prewitt_y)); }
+static Halide::Func gaussian_3x3(Halide::Func in) { return convolve<2>(in, const_kernel<int>(gauss_3x3, 16)); }
+static Halide::Func box_3x3(Halide::Func in) { return convolve<2>(in, const_kernel<int>(box, 9)); }
+static Halide::Func gaussian_5x5(Halide::Func in) { return convolve<2>(in, const_kernel<int>(gauss_5x5, 256)); }
+static Halide::Func gaussian_5x5_delta14(Halide::Func in) { return convolve<2>(in, const_kernel<int>(::gauss_5x5_delta14, 159)); }
+static Halide::Func unsharp(Halide::Func in) {
+    // The kernel of fast_unsharp_mask
+    const float v = (1.0f - unsharp_gamma) / 9.0f, w = (8.0f * unsharp_gamma + 1.0f) / 9.0f;
+    const float k[3][3] = { { v, v, v }, { v, w, v }, { v, v, v } };
+    return convolve<2>(in, const_kernel<float>(k));
+}
+} // namespace constant
+
+struct kernel_entry {
+    const char *name;
+    Halide::Func (*rdom)(Halide::Func in);
+    Halide::Func (*constant)(Halide::Func in);
+};
+
+static const kernel_entry kernels[] = {
+    { "sobel_x",              rdom::sobel_x,              constant::sobel_x },
+    { "sobel_y",              rdom::sobel_y,              constant::sobel_y },
+    { "scharr_x",             rdom::scharr_x,             constant::scharr_x },
+    { "scharr_y",             rdom::scharr_y,             constant::scharr_y },
+    { "prewitt_x",            rdom::prewitt_x,            constant::prewitt_x },
+    { "prewitt_y",            rdom::prewitt_y,            constant::prewitt_y },
+    { "gaussian_3x3",         rdom::gaussian_3x3,         constant::gaussian_3x3 },
+    { "box_3x3",              rdom::box_3x3,              constant::box_3x3 },
+    { "gaussian_5x5",         rdom::gaussian_5x5,         constant::gaussian_5x5 },
+    { "gaussian_5x5_delta14", rdom::gaussian_5x5_delta14, constant::gaussian_5x5_delta14 },
+    { "fast_unsharp_mask",    rdom::unsharp,              constant::unsharp },
+};
+
+static bool selected(const char *name, int argc, const char **argv) {
+    if (argc <= 1)
+        return true;
+    for (int i=1; i<argc; i++)
+        if (std::string(name) == argv[i])
+            return true;
+    return false;
+}
+
+// Realizes f into 'out' and returns its throughput in megapixels per second
+template <typename T>
+static double throughput(Halide::Func f, Halide::Image<T> out) {
+    schedule_output(f);
+    f.compile_jit();
+    f.realize(out);
+    timings t;
+    for (int r=0; r<runs; r++) {
+        interval iv(t);
+        f.realize(out);
+    }
+    double dev = 0;
+    return (double)width * height / 1000.0 / t.mean(dev);
+}
+
+template <typename T>
+static bool benchmark(const kernel_entry &entry, Halide::Func input, const excursions::image_tolerance &tol) {
+    Halide::Image<T> a(width, height), b(width, height);
+    const double rdom_rate = throughput(entry.rdom(input), a);
+    const double constant_rate = throughput(entry.constant(input), b);
+    const excursions::image_comparison result = excursions::compare_images(b, a, tol);
+    printf("%-22s %10.1f %10.1f %7.2fx %s\n", entry.name, rdom_rate, constant_rate,
+           constant_rate / rdom_rate, result.match ? "" : "MISMATCH");
+    if (!result.match)
+        result.print(entry.name);
+    return result.match;
+}
+
+int main(int argc, const char **argv) {
+    Halide::ImageParam image(Halide::UInt(8), 2);
+    Halide::Image<uint8_t> in(width, height);
+    excursions::randomize(in);
+    image.set(in);
+    Halide::Func input = widen_int32(clamped_input(image));
+
+    printf("%dx%d int32, %d runs\n", width, height, runs);
+    printf("%-22s %10s %10s %8s   (MPix/s)\n", "kernel", "RDom", "constant", "speedup");
+    bool ok = true;
+    for (size_t i=0; i<sizeof(kernels)/sizeof(kernels[0]); i++) {
+        if (!selected(kernels[i].name, argc, argv))
+            continue;
+        if (kernels[i].rdom == rdom::unsharp)
+            ok &= benchmark<float>(kernels[i], input, excursions::image_tolerance(1e-3));
+        else
+            ok &= benchmark<int32_t>(kernels[i], input, excursions::image_tolerance());
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+// NUMA scaling benchmark of utils/thread_pool.h.
+//
+// A separable blur of an 8192x8192 grayscale image, computed in strips of rows in
+// parallel, runs on Halide's thread pool and on excursions::thread_pool with 1, 2 and 4
+// NUMA nodes.  Each pool places its workers anywhere, pinned to cores, or pinned to nodes,
+// and the input and output are numa_images whose rows are placed on the node of the worker
+// that processes them.  A machine with fewer nodes than a configuration has its CPUs split
+// into groups standing in for the nodes ("emulated"): the placement is then exercised but
+// all memory is local.  The report shows the throughput in megapixels per second with 1, 2,
+// 4, ... up to the number of CPUs of the configuration threads.  Every output is compared
+// with the output of Halide's thread pool.
+//
+// usage: numa_benchmark
+
+#include <Halide.h>
+#include <string>
+#include <stdlib.h>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/thread_pool.h"
+
+static const int width = 8192, height = 8192, runs = 10;
+
+static Halide::Func strip_blur(Halide::ImageParam input) {
+    Halide::Var x,y,yo,yi;
+    Halide::Func padded("padded"), blur_x("blur_x"), blur_y("blur_y");
+    padded(x,y) = Halide::cast<uint16_t>(input(clamp(x, 0, input.width()-1), clamp(y, 0, input.height()-1)));
+    blur_x(x,y) = padded(x-1,y) + 2 * padded(x,y) + padded(x+1,y);
+    blur_y(x,y) = Halide::cast<uint8_t>((blur_x(x,y-1) + 2 * blur_x(x,y) + blur_x(x,y+1)) >> 4);
+
+    const int vector_width = Scheduler::natural_vector_width(blur_y);
+    blur_y.split(y, yo, yi, 16).parallel(yo).vectorize(x, vector_width);
+    blur_x.store_at(blur_y, yo).compute_at(blur_y, yi).vectorize(x, vector_width);
+    return blur_y;
+}
+
+static double throughput(Halide::Func f, Halide::Buffer out) {
+    f.realize(out);
+    timings t;
+    for (int r=0; r<runs; r++) {
+        interval iv(t);
+        f.realize(out);
+    }
+    double dev = 0;
+    return (double)width * height / 1000.0 / t.mean(dev);
+}
+
+static std::vector<int> thread_counts(int cpus) {
+    std::vector<int> counts;
+    for (int t=1; t<cpus; t*=2)
+        counts.push_back(t);
+    counts.push_back(cpus);
+    return counts;
+}
+
+int main(int argc, const char **argv) {
+    const excursions::numa_topology machine = excursions::numa_topology::detect();
+    printf("%dx%d separable blur, %zu node(s), %d CPUs   (MPix/s)\n", width, height,
+           machine.nodes.size(), machine.cpus());
+
+    Halide::Image<uint8_t> source(width, height);
+    excursions::randomize(source);
+
+    // Reference: Halide's thread pool
+    Halide::ImageParam halide_input(Halide::UInt(8), 2);
+    halide_input.set(source);
+    Halide::Func halide_blur = strip_blur(halide_input);
+    halide_blur.compile_jit();
+    Halide::Image<uint8_t> expected(width, height);
+    const double halide_rate = throughput(halide_blur, expected);
+    printf("%-28s %d threads: %8.1f\n", "Halide thread pool", machine.cpus(), halide_rate);
+
+    Halide::ImageParam input(Halide::UInt(8), 2);
+    Halide::Func blur = strip_blur(input);
+    excursions::use_thread_pool(blur);
+    blur.compile_jit();
+
+    const char *placements[] = { "anywhere", "cores", "nodes" };
+    const int node_counts[] = { 1, 2, 4 };
+    bool ok = true;
+    for (int n=0; n<3; n++) {
+        const excursions::numa_topology topology = machine.select(node_counts[n]);
+        const std::vector<int> counts = thread_counts(topology.cpus());
+        for (int p=0; p<3; p++) {
+            char label[64];
+            snprintf(label, sizeof(label), "%d node%s%s, %s", node_counts[n], node_counts[n] > 1 ? "s" : "",
+                     topology.emulated ? " (emulated)" : "", placements[p]);
+            printf("%-28s", label);
+            for (size_t t=0; t<counts.size(); t++) {
+                excursions::thread_pool pool(counts[t], (excursions::thread_placement)p, topology);
+                excursions::numa_image<uint8_t> in(pool, width, height), out(pool, width, height);
+                memcpy(in.pixels(), source.data(), (size_t)width * height);
+                input.set(in.buffer());
+                double rate = 0;
+                pool.run([&]() { rate = throughput(blur, out.buffer()); });
+                const bool same = memcmp(out.pixels(), expected.data(), (size_t)width * height) == 0;
+                printf("  %3d: %8.1f%s", counts[t], rate, same ? "" : " MISMATCH");
+                ok &= same;
+            }
+            printf("\n");
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
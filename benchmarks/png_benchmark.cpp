@@ -0,0 +1,111 @@
+// PNG encoding benchmark of image_io.h.
+//
+// A 4096x4096 RGB image (8 and 16-bit), smooth with some noise like the output of a
+// filter, is saved with save_png's defaults (libpng, as before the encoder options), with
+// a fast compression level, and with the parallel encoder at levels 1 and 6 (the default)
+// on 2, 4, ... up to the number of online CPUs threads.  The report shows the encoding
+// throughput in megapixels per second, the speedup over the default save_png, and the file
+// size.  Every file is loaded back and compared with the image.
+//
+// usage: png_benchmark [output-directory]
+
+#include <Halide.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "utils/clock.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+static const int width = 4096, height = 4096, runs = 5;
+
+template <typename T>
+static Image<T> test_image() {
+    Image<T> im(width, height, 3);
+    const double scale = sizeof(T) == 1 ? 255 : 65535;
+    for (int c=0; c<3; c++)
+        for (int y=0; y<height; y++)
+            for (int x=0; x<width; x++) {
+                double v = 0.5 + 0.25 * sin(x * 0.01 * (c + 1)) + 0.2 * cos(y * 0.013) +
+                           0.02 * ((double)rand() / RAND_MAX);
+                im(x, y, c) = (T)(std::max(0.0, std::min(1.0, v)) * scale);
+            }
+    return im;
+}
+
+static long file_size(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+template <typename T>
+static bool identical(const Image<T> &a, const Image<T> &b) {
+    if (a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels())
+        return false;
+    for (int c=0; c<a.channels(); c++)
+        for (int y=0; y<a.height(); y++)
+            for (int x=0; x<a.width(); x++)
+                if (a(x, y, c) != b(x, y, c))
+                    return false;
+    return true;
+}
+
+// Returns the throughput in megapixels per second, or 0 if the file does not load back
+// as the image
+template <typename T>
+static double encode(const Image<T> &im, const std::string &filename, const char *label,
+                     const png_options &options, double reference) {
+    timings t;
+    for (int r=0; r<runs; r++) {
+        interval iv(t);
+        save_png(im, filename, options);
+    }
+    double dev = 0;
+    const double rate = (double)width * height / 1000.0 / t.mean(dev);
+    const bool ok = identical(im, load_png<T>(filename));
+    printf("%-28s %10.1f %8.2fx %10.2f MB %s\n", label, rate, reference > 0 ? rate / reference : 1.0,
+           file_size(filename) / 1e6, ok ? "" : "MISMATCH");
+    remove(filename.c_str());
+    return ok ? rate : 0;
+}
+
+template <typename T>
+static bool benchmark(const std::string &directory, int bit_depth) {
+    const Image<T> im = test_image<T>();
+    const std::string filename = directory + "/png_benchmark.png";
+    const int max_threads = std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    char label[64];
+
+    printf("\n%dx%d RGB, %d-bit\n", width, height, bit_depth);
+    printf("%-28s %10s %9s %13s\n", "encoder", "MPix/s", "speedup", "size");
+    const double reference = encode(im, filename, "save_png (libpng defaults)", png_options(), 0);
+    bool ok = reference > 0;
+    ok &= encode(im, filename, "libpng, level 1", png_options(1), reference) > 0;
+    std::vector<int> thread_counts;
+    for (int t=2; t<max_threads; t*=2)
+        thread_counts.push_back(t);
+    if (max_threads > 1)
+        thread_counts.push_back(max_threads);
+    const int levels[] = { 1, 6 };
+    for (int l=0; l<2; l++)
+        for (size_t t=0; t<thread_counts.size(); t++) {
+            snprintf(label, sizeof(label), "parallel, level %d, %d thr", levels[l], thread_counts[t]);
+            ok &= encode(im, filename, label, png_options(levels[l], PNG_ALL_FILTERS, -1, thread_counts[t]), reference) > 0;
+        }
+    return ok;
+}
+
+int main(int argc, const char **argv) {
+    const std::string directory = argc > 1 ? argv[1] : ".";
+    bool ok = benchmark<uint8_t>(directory, 8);
+    ok &= benchmark<uint16_t>(directory, 16);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
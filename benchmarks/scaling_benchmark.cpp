@@ -0,0 +1,102 @@
+// Size and thread-scaling benchmark of the excursions functions.
+//
+// Every function of samples/function_table.h runs on synthetic images from 256x256 to
+// 8192x8192, with 1, 2, 4, ... up to the number of online CPUs worker threads.
+// For each (function, size) the report shows the throughput in megapixels per second at
+// every thread count, and the parallel efficiency at the highest thread count:
+//     efficiency(n) = throughput(n) / (n * throughput(1))
+// A throughput drop between two sizes at the same thread count shows the working set
+// falling out of a cache level; an efficiency far below 100% shows where the schedule
+// stops scaling.
+//
+// usage: scaling_benchmark [function-name ...]
+
+#include <Halide.h>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "samples/function_table.h"
+
+// Halide reads HL_NUM_THREADS when it creates its thread pool; shutting the pool down makes
+// the next realize create a new one with the requested number of threads
+static void set_num_threads(int threads) {
+    char value[16];
+    snprintf(value, sizeof(value), "%d", threads);
+    setenv("HL_NUM_THREADS", value, 1);
+    halide_shutdown_thread_pool();
+}
+
+static bool selected(const char *name, int argc, const char **argv) {
+    if (argc <= 1)
+        return true;
+    for (int i=1; i<argc; i++)
+        if (std::string(name) == argv[i])
+            return true;
+    return false;
+}
+
+int main(int argc, const char **argv) {
+    const int sizes[] = { 256, 512, 1024, 2048, 4096, 8192 };
+    const int max_threads = std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    std::vector<int> thread_counts;
+    for (int t=1; t<max_threads; t*=2)
+        thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    printf("%-22s %6s", "function", "size");
+    for (size_t t=0; t<thread_counts.size(); t++)
+        printf("  %3d thr", thread_counts[t]);
+    printf("  efficiency   (MPix/s)\n");
+
+    const std::vector<excursion_function> &functions = excursion_functions();
+    for (size_t i=0; i<functions.size(); i++) {
+        const excursion_function &fn = functions[i];
+        if (!selected(fn.name, argc, argv))
+            continue;
+
+        Halide::ImageParam input(Halide::UInt(8), fn.grayscale ? 2 : 3);
+        Halide::Func f;
+
+        for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+            const int size = sizes[s];
+            Halide::Image<uint8_t> in = fn.grayscale ? Halide::Image<uint8_t>(size, size) : Halide::Image<uint8_t>(size, size, 3);
+            Halide::Image<uint8_t> out = fn.grayscale ? Halide::Image<uint8_t>(size, size) : Halide::Image<uint8_t>(size, size, 3);
+            excursions::randomize(in);
+            input.set(in);
+            // Functions that bake the image size into their definition are rebuilt per size
+            if (!f.defined() || fn.size_dependent) {
+                f = fn.make(clamped_input(input), size, size);
+                schedule_output(f);
+                f.compile_jit();
+            }
+
+            const double pixels = (double)size * size;
+            // about 64M pixels per measurement, between 3 and 50 runs
+            const int runs = std::max(3, std::min(50, (int)((1 << 26) / pixels)));
+            std::vector<double> throughput;
+            for (size_t t=0; t<thread_counts.size(); t++) {
+                set_num_threads(thread_counts[t]);
+                f.realize(out);     // warm up, and create the thread pool
+                timings times;
+                for (int r=0; r<runs; r++) {
+                    interval iv(times);
+                    f.realize(out);
+                }
+                double dev = 0;
+                throughput.push_back(pixels / 1000.0 / times.mean(dev));
+            }
+
+            printf("%-22s %6d", fn.name, size);
+            for (size_t t=0; t<throughput.size(); t++)
+                printf("  %7.1f", throughput[t]);
+            printf("  %9.1f%%\n", 100.0 * throughput.back() / (thread_counts.back() * throughput[0]));
+        }
+    }
+
+    unsetenv("HL_NUM_THREADS");
+    halide_shutdown_thread_pool();
+    return EXIT_SUCCESS;
+}
@@ -14,14 +14,82 @@ enum interpolation_type {
     BILINEAR
 };
 
+enum border_mode {
+    BORDER_CONSTANT,
+    BORDER_REPLICATE
+};
+
+// The pure coordinates of a Dims-dimensional image function: (x,y) for 2D (grayscale)
+// images, (x,y,c) for 3D images and (x,y,c,n) for a batch of 3D images (grayscale images
+// are batched with one channel).  Functions templated on Dims are defined once over
+// args() and at(), and the geometry is fixed at compile time.
+template <int Dims>
+struct image_coords {
+    Halide::Var x, y, c, n;
+    // The arguments of a function of this geometry
+    std::vector<Halide::Var> args() const;
+    // The coordinates of the pixel at offset (dx,dy) from (x,y)
+    std::vector<Halide::Expr> at(Halide::Expr dx, Halide::Expr dy) const;
+};
+
+template <>
+inline std::vector<Halide::Var> image_coords<2>::args() const { return {x, y}; }
+template <>
+inline std::vector<Halide::Var> image_coords<3>::args() const { return {x, y, c}; }
+template <>
+inline std::vector<Halide::Expr> image_coords<2>::at(Halide::Expr dx, Halide::Expr dy) const { return {x+dx, y+dy}; }
+template <>
+inline std::vector<Halide::Expr> image_coords<3>::at(Halide::Expr dx, Halide::Expr dy) const { return {x+dx, y+dy, c}; }
+template <>
+inline std::vector<Halide::Var> image_coords<4>::args() const { return {x, y, c, n}; }
+template <>
+inline std::vector<Halide::Expr> image_coords<4>::at(Halide::Expr dx, Halide::Expr dy) const { return {x+dx, y+dy, c, n}; }
+
 Halide::Func scale(interpolation_type interpolation);
+// Dims is 2 (grayscale), 3, or 4 (a batch); the bool grayscale versions select 2 or 3 at run time
+template <int Dims> std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input);
+template <int Dims> Halide::Func gaussian_3x3(Halide::Func input, const Scheduler &s = NoPSched());
+template <int Dims> Halide::Func gaussian_5x5(Halide::Func input, const Scheduler &s = NoPSched());
+template <int Dims> Halide::Func box_3x3(Halide::Func input, const Scheduler &s = NoPSched());
+template <int Dims> Halide::Func erode_3x3(Halide::Func input);
+template <int Dims> Halide::Func dilate_3x3(Halide::Func input);
 std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input, bool grayscale = false);
 Halide::Func gaussian_3x3(Halide::Func input, bool grayscale = false, const Scheduler &s = NoPSched());
-Halide::Func gaussian_5x5(Halide::Func input);
+Halide::Func gaussian_5x5(Halide::Func input, bool grayscale = false);
 Halide::Func erode_3x3(Halide::Func input);
 Halide::Func dilate_3x3(Halide::Func input);
 Halide::Func box_3x3(Halide::Func input, bool grayscale = false);
-Halide::Func integral_image(Halide::Func input);
+Halide::Func integral_image(Halide::Func input, Halide::Expr width, Halide::Expr height);
+std::vector<Halide::Func> gaussian_pyramid(Halide::Func input, Halide::Expr width, Halide::Expr height, int levels);
+Halide::Expr pyramid_extent(Halide::Expr extent, int level);
+Halide::Func warp_affine(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                         const float matrix[6], interpolation_type interpolation = BILINEAR,
+                         border_mode border = BORDER_CONSTANT, Halide::Expr constant = 0,
+                         bool grayscale = false, const Scheduler &s = NoPSched());
+Halide::Func warp_perspective(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                              const float matrix[9], interpolation_type interpolation = BILINEAR,
+                              border_mode border = BORDER_CONSTANT, Halide::Expr constant = 0,
+                              bool grayscale = false, const Scheduler &s = NoPSched());
+Halide::Func channel_extract(Halide::Func input, int channel);
+Halide::Func channel_combine(Halide::Func plane0, Halide::Func plane1, Halide::Func plane2,
+                             Halide::Func plane3 = Halide::Func());
+void set_interleaved_layout(Halide::OutputImageParam buffer, int channels);
+void schedule_interleaved(Halide::Func f, int channels, int vector_width = 16);
+// Fixed-point (integer coordinates) affine warp, for uint8 inputs only
+Halide::Func warp_affine_fixed(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                               const float matrix[6], interpolation_type interpolation = BILINEAR,
+                               border_mode border = BORDER_CONSTANT, Halide::Expr constant = 0,
+                               bool grayscale = false, const Scheduler &s = NoPSched());
+
+// Pyramidal Lucas-Kanade feature tracking (OpenVX OpticalFlowPyrLK).
+// prev, next: 2D grayscale frames of size width x height (any numeric type).
+// points: the features to track, points(p, 0) = x and points(p, 1) = y of feature p.
+// Returns tracked(p, c), the float location of each feature in 'next' (c=0 for x, c=1 for y).
+// The per-point stages are scheduled internally to run in parallel across points.
+Halide::Func optical_flow_pyr_lk(Halide::Func prev, Halide::Func next,
+                                 Halide::Expr width, Halide::Expr height,
+                                 Halide::Func points, int levels = 4,
+                                 int window_size = 15, int num_iterations = 10);
 
 // Alternative implementations of Gaussian 3x3 kernel.  Not useful except for testing if 
 // the algorithm implementation has bearings on the performance
@@ -30,6 +98,37 @@ Halide::Func gaussian_3x3_3(Halide::Func input, const Scheduler &s = NoPSched())
 Halide::Func gaussian_3x3_4(Halide::Func input, const Scheduler &s = NoPSched());
 Halide::Func gaussian_3x3_5(Halide::Func input, const Scheduler &s = NoPSched());
 
+//
+// Convolution with a constant kernel
+//
+// The weights are C++ constants when the pipeline is defined, so convolve() emits one term
+// per tap with its weight as an immediate: zero taps are dropped, weights of +-1 become
+// additions and subtractions, and power-of-two weights and divisors of integer kernels
+// become shifts.  A kernel defined as a Func and summed over an RDom (as in sobel_3x3) is
+// looked up at run time instead, and every tap is multiplied, zero or not.
+// Integer inputs are summed in int32 (float for float kernels) and float inputs in their
+// own type, like input * k(r.x, r.y).
+//
+//     static const int sobel_x[3][3] = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+//     Halide::Func gx = convolve<2>(input, const_kernel<int>(sobel_x));
+//
+template <typename T>
+struct const_kernel {
+    // A W x H kernel centered on the output pixel (W and H odd); weights[j][i] is the
+    // weight of the input pixel at offset (i - W/2, j - H/2)
+    template <int W, int H>
+    const_kernel(const T (&weights)[H][W], T divisor = 1)
+        : width(W), height(H), weights(&weights[0][0], &weights[0][0] + W*H), divisor(divisor) {}
+
+    int width, height;
+    std::vector<T> weights;     // row-major
+    T divisor;
+};
+
+// Dims is 2 (grayscale), 3, or 4 (a batch); T is int or float
+template <int Dims, typename T>
+Halide::Func convolve(Halide::Func input, const const_kernel<T> &kernel, const Scheduler &s = NoPSched());
+
 
 //
 // Color conversion functions
@@ -44,6 +143,29 @@ enum {
 Halide::Func rgb_extract_luma(Halide::Func rgb);
 Halide::Func rgb2luma(Halide::Func rgb);
 
+// Image formats of the OpenVX ColorConvert function.  A (multi-planar) image is a vector
+// of uint8 functions, one per plane:
+//     FORMAT_RGB, FORMAT_RGBX: plane 0 is rgb(x,y,c) with 3 or 4 channels
+//     FORMAT_NV12, FORMAT_NV21: plane 0 is Y(x,y); plane 1 is the interleaved chroma plane,
+//         addressed as uv(c, x, y) where x,y are at half resolution and c=0 is the first
+//         byte of each pair (U for NV12, V for NV21).  A buffer of extents (2, width/2,
+//         height/2) has the same memory layout as the interleaved plane.
+//     FORMAT_IYUV: planes 0,1,2 are Y(x,y), U(x,y), V(x,y); U and V are at half resolution
+//     FORMAT_YUV4: planes 0,1,2 are Y(x,y), U(x,y), V(x,y), all at full resolution
+enum color_format {
+    FORMAT_RGB,
+    FORMAT_RGBX,
+    FORMAT_NV12,
+    FORMAT_NV21,
+    FORMAT_IYUV,
+    FORMAT_YUV4
+};
+
+typedef std::vector<Halide::Func> image_planes;
+
+image_planes color_convert(const image_planes &src, color_format src_format, color_format dst_format,
+                           const Scheduler &s = NoPSched());
+
 // Gradient direction
 enum {
     DIRECTION_45UP,
@@ -53,6 +175,13 @@ enum {
     DIRECTION_UNKNWON,
 };
 
+// Dims is 2 (grayscale), 3, or 4 (a batch); the bool grayscale versions select 2 or 3 at run time
+template <int Dims> std::pair<Halide::Func, Halide::Func> scharr_3x3(Halide::Func input);
+template <int Dims> std::pair<Halide::Func, Halide::Func> prewitt_3x3(Halide::Func input);
+template <int Dims> Halide::Func gaussian_5x5_delta14(Halide::Func input);
+template <int Dims> Halide::Func canny_detector(Halide::Func input);
+template <int Dims> Halide::Func fast_unsharp_mask(Halide::Func input, float gamma);
+template <int Dims> Halide::Func unsharp_mask(Halide::Func input, Halide::Func avg_mask, float gamma);
 std::pair<Halide::Func, Halide::Func> scharr_3x3(Halide::Func input, bool grayscale = false);
 std::pair<Halide::Func, Halide::Func> prewitt_3x3(Halide::Func input, bool grayscale = false);
 Halide::Func gaussian_5x5_delta14(Halide::Func input, bool grayscale = false);
@@ -67,6 +196,66 @@ Halide::Func bilinear_scale(Halide::Func input, float w_factor, float h_factor);
 Halide::Func nn_scale(Halide::Func input, float w_factor, float h_factor);
 Halide::Func reflect_vert(Halide::Func input, int k, int width);
 
+//
+// Pixelwise arithmetic (OpenVX Add, Subtract, AbsDiff, Multiply, Threshold, And, Or, Xor, Not)
+//
+// The operations work on PixelExpr values rather than on Funcs: composing them only builds
+// up an expression tree, and to_func() emits the whole chain as a single stage (one load
+// per input and one store per pixel).  Chaining separate Funcs with compute_root() instead
+// makes a full round trip to memory for every operation.
+// Unless noted otherwise, results have the type of the first operand, and narrow integer
+// types are computed in a wider type and then saturated (or wrapped) per convert_policy.
+//
+//     PixelExpr a = pixel(frame0), b = pixel(frame1);
+//     Halide::Func motion = to_func(threshold_binary(abs_diff(a, b), 20, 255, 0));
+//
+
+enum convert_policy {
+    CONVERT_POLICY_WRAP,
+    CONVERT_POLICY_SATURATE
+};
+
+enum rounding_policy {
+    ROUND_TO_ZERO,
+    ROUND_TO_NEAREST_EVEN
+};
+
+class PixelExpr {
+public:
+    explicit PixelExpr(Halide::Expr e) : e(e) {}
+    Halide::Expr expr() const { return e; }
+    Halide::Type type() const { return e.type(); }
+private:
+    Halide::Expr e;
+};
+
+// The value of 'image' at the pixel being computed
+PixelExpr pixel(Halide::Func image, bool grayscale = false);
+Halide::Func to_func(const PixelExpr &e, bool grayscale = false, const std::string &name = "pixelwise");
+
+PixelExpr convert_depth(const PixelExpr &a, Halide::Type t, convert_policy policy = CONVERT_POLICY_SATURATE);
+PixelExpr add(const PixelExpr &a, const PixelExpr &b, convert_policy policy = CONVERT_POLICY_SATURATE);
+PixelExpr subtract(const PixelExpr &a, const PixelExpr &b, convert_policy policy = CONVERT_POLICY_SATURATE);
+PixelExpr abs_diff(const PixelExpr &a, const PixelExpr &b);
+PixelExpr multiply(const PixelExpr &a, const PixelExpr &b, float scale = 1.0f,
+                   convert_policy policy = CONVERT_POLICY_SATURATE, rounding_policy rounding = ROUND_TO_ZERO);
+PixelExpr threshold_binary(const PixelExpr &a, Halide::Expr threshold,
+                           Halide::Expr true_value = 255, Halide::Expr false_value = 0);
+PixelExpr threshold_range(const PixelExpr &a, Halide::Expr lower, Halide::Expr upper,
+                          Halide::Expr true_value = 255, Halide::Expr false_value = 0);
+PixelExpr bitwise_and(const PixelExpr &a, const PixelExpr &b);
+PixelExpr bitwise_or(const PixelExpr &a, const PixelExpr &b);
+PixelExpr bitwise_xor(const PixelExpr &a, const PixelExpr &b);
+PixelExpr bitwise_not(const PixelExpr &a);
+
+// Saturating arithmetic and bitwise operators
+PixelExpr operator+(const PixelExpr &a, const PixelExpr &b);
+PixelExpr operator-(const PixelExpr &a, const PixelExpr &b);
+PixelExpr operator&(const PixelExpr &a, const PixelExpr &b);
+PixelExpr operator|(const PixelExpr &a, const PixelExpr &b);
+PixelExpr operator^(const PixelExpr &a, const PixelExpr &b);
+PixelExpr operator~(const PixelExpr &a);
+
 /*
  * Invert input over the specified reduction domain (r)
  * 
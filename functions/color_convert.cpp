@@ -22,3 +22,163 @@ Halide::Func rgb2luma(Halide::Func rgb) {
                     0.114f * rgb(x, y, BLUE);
     return luma;
 }
+
+//
+// OpenVX ColorConvert
+//
+// All conversions use 14-bit fixed-point arithmetic with the BT.709 (full range)
+// coefficients mandated by OpenVX.  Chroma sub-sampling averages each 2x2 block, and
+// chroma up-sampling replicates each sample; both are fused into the conversion, so
+// there are no intermediate full-resolution chroma planes.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d1/dc1/group__group__vision__function__colorconvert.html
+//
+
+namespace {
+
+struct yuv_exprs {
+    Halide::Expr y, u, v;
+};
+
+struct rgb_exprs {
+    Halide::Expr r, g, b;
+};
+
+// Fixed-point (Q14) multiply-accumulate with round-to-nearest
+Halide::Expr q14(Halide::Expr e) {
+    return (e + 8192) >> 14;
+}
+
+Halide::Expr saturate_u8(Halide::Expr e) {
+    return Halide::cast<uint8_t>(clamp(e, 0, 255));
+}
+
+bool is_rgb(color_format format) {
+    return format == FORMAT_RGB || format == FORMAT_RGBX;
+}
+
+// The R,G,B values of pixel (x,y) of an RGB/RGBX image
+rgb_exprs rgb_at(const image_planes &src, Halide::Expr x, Halide::Expr y) {
+    rgb_exprs rgb;
+    rgb.r = Halide::cast<int32_t>(src[0](x, y, RED));
+    rgb.g = Halide::cast<int32_t>(src[0](x, y, GREEN));
+    rgb.b = Halide::cast<int32_t>(src[0](x, y, BLUE));
+    return rgb;
+}
+
+yuv_exprs rgb_to_yuv(const rgb_exprs &rgb) {
+    yuv_exprs yuv;
+    yuv.y = q14(3483 * rgb.r + 11718 * rgb.g + 1183 * rgb.b);
+    yuv.u = q14(-1878 * rgb.r - 6314 * rgb.g + 8192 * rgb.b) + 128;
+    yuv.v = q14(8192 * rgb.r - 7442 * rgb.g - 750 * rgb.b) + 128;
+    return yuv;
+}
+
+rgb_exprs yuv_to_rgb(const yuv_exprs &yuv) {
+    Halide::Expr u = yuv.u - 128, v = yuv.v - 128;
+    rgb_exprs rgb;
+    rgb.r = yuv.y + q14(25802 * v);
+    rgb.g = yuv.y + q14(-3069 * u - 7669 * v);
+    rgb.b = yuv.y + q14(30402 * u);
+    return rgb;
+}
+
+// The Y,U,V values of the full-resolution pixel (x,y) of an image in any format.
+// Sub-sampled chroma is up-sampled by replication.
+yuv_exprs yuv_at(const image_planes &src, color_format format, Halide::Expr x, Halide::Expr y) {
+    yuv_exprs yuv;
+    switch (format) {
+    case FORMAT_RGB:
+    case FORMAT_RGBX:
+        return rgb_to_yuv(rgb_at(src, x, y));
+    case FORMAT_NV12:
+    case FORMAT_NV21: {
+        Halide::Expr u_index = (format == FORMAT_NV12) ? 0 : 1;
+        yuv.y = Halide::cast<int32_t>(src[0](x, y));
+        yuv.u = Halide::cast<int32_t>(src[1](u_index, x/2, y/2));
+        yuv.v = Halide::cast<int32_t>(src[1](1 - u_index, x/2, y/2));
+        break;
+    }
+    case FORMAT_IYUV:
+        yuv.y = Halide::cast<int32_t>(src[0](x, y));
+        yuv.u = Halide::cast<int32_t>(src[1](x/2, y/2));
+        yuv.v = Halide::cast<int32_t>(src[2](x/2, y/2));
+        break;
+    case FORMAT_YUV4:
+        yuv.y = Halide::cast<int32_t>(src[0](x, y));
+        yuv.u = Halide::cast<int32_t>(src[1](x, y));
+        yuv.v = Halide::cast<int32_t>(src[2](x, y));
+        break;
+    }
+    return yuv;
+}
+
+// The U,V values of the 2x2 block whose top-left pixel is (2x, 2y)
+yuv_exprs subsampled_chroma_at(const image_planes &src, color_format format, Halide::Expr x, Halide::Expr y) {
+    if (format == FORMAT_NV12 || format == FORMAT_NV21 || format == FORMAT_IYUV)
+        return yuv_at(src, format, 2*x, 2*y);
+
+    yuv_exprs p00 = yuv_at(src, format, 2*x,   2*y);
+    yuv_exprs p10 = yuv_at(src, format, 2*x+1, 2*y);
+    yuv_exprs p01 = yuv_at(src, format, 2*x,   2*y+1);
+    yuv_exprs p11 = yuv_at(src, format, 2*x+1, 2*y+1);
+    yuv_exprs chroma;
+    chroma.u = (p00.u + p10.u + p01.u + p11.u + 2) >> 2;
+    chroma.v = (p00.v + p10.v + p01.v + p11.v + 2) >> 2;
+    return chroma;
+}
+
+} // namespace
+
+// Converts an image between two of the formats of color_format.  Width and height must be even.
+// The returned planes use the layout described in excursions.h; in particular, the
+// interleaved chroma plane of NV12/NV21 is a function uv(c, x, y) so that its
+// (de)interleaving is vectorized by unrolling c.
+// The scheduler is applied to each of the returned planes.
+image_planes color_convert(const image_planes &src, color_format src_format, color_format dst_format,
+                           const Scheduler &s) {
+    Halide::Var x,y,c;
+    image_planes dst;
+
+    if (is_rgb(dst_format)) {
+        Halide::Func rgb(dst_format == FORMAT_RGB ? "to_rgb" : "to_rgbx");
+        rgb_exprs value = is_rgb(src_format) ? rgb_at(src, x, y) : yuv_to_rgb(yuv_at(src, src_format, x, y));
+        Halide::Expr alpha = 255;
+        if (src_format == FORMAT_RGBX)
+            alpha = Halide::cast<int32_t>(src[0](x, y, 3));
+        rgb(x,y,c) = saturate_u8(select(c == RED, value.r,
+                                 select(c == GREEN, value.g,
+                                 select(c == BLUE, value.b, alpha))));
+        rgb.bound(c, 0, dst_format == FORMAT_RGB ? 3 : 4).reorder(c, x, y).unroll(c);
+        dst.push_back(rgb);
+    } else {
+        Halide::Func luma("to_y");
+        luma(x,y) = saturate_u8(yuv_at(src, src_format, x, y).y);
+        dst.push_back(luma);
+
+        if (dst_format == FORMAT_YUV4) {
+            Halide::Func u("to_u"), v("to_v");
+            u(x,y) = saturate_u8(yuv_at(src, src_format, x, y).u);
+            v(x,y) = saturate_u8(yuv_at(src, src_format, x, y).v);
+            dst.push_back(u);
+            dst.push_back(v);
+        } else if (dst_format == FORMAT_IYUV) {
+            Halide::Func u("to_u"), v("to_v");
+            u(x,y) = saturate_u8(subsampled_chroma_at(src, src_format, x, y).u);
+            v(x,y) = saturate_u8(subsampled_chroma_at(src, src_format, x, y).v);
+            dst.push_back(u);
+            dst.push_back(v);
+        } else {
+            Halide::Func uv(dst_format == FORMAT_NV12 ? "to_uv" : "to_vu");
+            yuv_exprs chroma = subsampled_chroma_at(src, src_format, x, y);
+            Halide::Expr first = (dst_format == FORMAT_NV12) ? chroma.u : chroma.v;
+            Halide::Expr second = (dst_format == FORMAT_NV12) ? chroma.v : chroma.u;
+            uv(c,x,y) = saturate_u8(select(c == 0, first, second));
+            uv.bound(c, 0, 2).reorder(c, x, y).unroll(c);
+            dst.push_back(uv);
+        }
+    }
+
+    for (size_t i=0; i<dst.size(); i++)
+        s.schedule(dst[i], x, y);
+    return dst;
+}
@@ -0,0 +1,77 @@
+#include "excursions.h"
+#include <limits>
+
+// The type the taps are summed in, as input * k(r.x, r.y) promotes: int32 for integer
+// inputs (float for float kernels), and the input type for float inputs
+static Halide::Type accumulator_type(Halide::Type input, bool float_kernel) {
+    if (input.is_float())
+        return input;
+    return float_kernel ? Halide::Float(32) : Halide::Int(32);
+}
+
+// log2(w) if w is a power of two greater than 1, 0 otherwise
+template <typename T>
+static int shift_of(T w) {
+    const int v = (int)w;
+    if ((T)v != w || v < 2 || (v & (v - 1)) != 0)
+        return 0;
+    int shift = 0;
+    while ((1 << shift) < v)
+        shift++;
+    return shift;
+}
+
+// Sum of 'terms', or an undefined Expr if there are none
+static Halide::Expr add_all(const std::vector<Halide::Expr> &terms) {
+    Halide::Expr e;
+    for (size_t i=0; i<terms.size(); i++)
+        e = e.defined() ? e + terms[i] : terms[i];
+    return e;
+}
+
+template <int Dims, typename T>
+Halide::Func convolve(Halide::Func input, const const_kernel<T> &kernel, const Scheduler &s) {
+    Halide::Func conv("convolve");
+    image_coords<Dims> p;
+    const Halide::Type acc = accumulator_type(Halide::Expr(input(p.at(0, 0))).type(), !std::numeric_limits<T>::is_integer);
+    const bool shifts = !acc.is_float();
+
+    // Taps of positive and of negative weight, so that a weight of -1 is a subtraction
+    std::vector<Halide::Expr> added, subtracted;
+    for (int j=0; j<kernel.height; j++) {
+        for (int i=0; i<kernel.width; i++) {
+            const T w = kernel.weights[j*kernel.width + i];
+            if (w == 0)
+                continue;
+            const T magnitude = w < 0 ? -w : w;
+            const int shift = shifts ? shift_of(magnitude) : 0;
+            Halide::Expr tap = Halide::cast(acc, input(p.at(i - kernel.width/2, j - kernel.height/2)));
+            if (shift)
+                tap = tap << shift;
+            else if (magnitude != 1)
+                tap = tap * Halide::cast(acc, magnitude);
+            (w < 0 ? subtracted : added).push_back(tap);
+        }
+    }
+
+    Halide::Expr positive = add_all(added), negative = add_all(subtracted);
+    Halide::Expr e = positive.defined() && negative.defined() ? positive - negative :
+                     positive.defined() ? positive :
+                     negative.defined() ? -negative : Halide::cast(acc, 0);
+    if (kernel.divisor != 1) {
+        // Halide's integer division rounds down, like an arithmetic shift
+        const int shift = shifts ? shift_of(kernel.divisor) : 0;
+        e = shift ? e >> shift : e / Halide::cast(acc, kernel.divisor);
+    }
+
+    conv(p.args()) = e;
+    s.schedule(conv, p.x, p.y);
+    return conv;
+}
+
+template Halide::Func convolve<2, int>(Halide::Func input, const const_kernel<int> &kernel, const Scheduler &s);
+template Halide::Func convolve<3, int>(Halide::Func input, const const_kernel<int> &kernel, const Scheduler &s);
+template Halide::Func convolve<4, int>(Halide::Func input, const const_kernel<int> &kernel, const Scheduler &s);
+template Halide::Func convolve<2, float>(Halide::Func input, const const_kernel<float> &kernel, const Scheduler &s);
+template Halide::Func convolve<3, float>(Halide::Func input, const const_kernel<float> &kernel, const Scheduler &s);
+template Halide::Func convolve<4, float>(Halide::Func input, const const_kernel<float> &kernel, const Scheduler &s);
@@ -3,71 +3,80 @@
 // Scharr operator
 // Computes x,y gradients
 // http://patrick-fuller.com/gradients-image-processing-for-scientists-and-engineers-part-3/
-std::pair<Halide::Func, Halide::Func> scharr_3x3(Halide::Func input, bool grayscale) {
+template <int Dims>
+std::pair<Halide::Func, Halide::Func> scharr_3x3(Halide::Func input) {
     Halide::Func kx("kx"), ky("ky");
     Halide::Func gx("gradient_x"), gy("gradient_y");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
     
     kx(x,y) = 0;
     kx(-1,-1) =  -3;    kx(0,-1) = 0;    kx(1,-1) =  3;
     kx(-1, 0) = -10;    kx(0, 0) = 0;    kx(1, 0) = 10;
     kx(-1, 1) =  -3;    kx(0, 1) = 0;    kx(1, 1) =  3;
-    if (grayscale)
-        gx(x,y) = sum(input(x+r.x, y+r.y) * kx(r.x, r.y));
-    else
-        gx(x,y,c) = sum(input(x+r.x, y+r.y, c) * kx(r.x, r.y));
+    gx(p.args()) = sum(input(p.at(r.x, r.y)) * kx(r.x, r.y));
         
     ky(x,y) = 0;
     ky(-1,-1) = -3;    ky(0,-1) = -10;    ky(1,-1) = -3;
     ky(-1, 0) =  0;    ky(0, 0) =   0;    ky(1, 0) =  0;
     ky(-1, 1) =  3;    ky(0, 1) =  10;    ky(1, 1) =  3;
-    if (grayscale)
-        gy(x,y) = sum(input(x+r.x, y+r.y) * ky(r.x, r.y));
-    else
-        gy(x,y,c) = sum(input(x+r.x, y+r.y, c) * ky(r.x, r.y));
+    gy(p.args()) = sum(input(p.at(r.x, r.y)) * ky(r.x, r.y));
 
     std::pair<Halide::Func, Halide::Func> ret = std::make_pair(gx, gy);
     return ret;
 }
 
+template std::pair<Halide::Func, Halide::Func> scharr_3x3<2>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> scharr_3x3<3>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> scharr_3x3<4>(Halide::Func input);
+
+std::pair<Halide::Func, Halide::Func> scharr_3x3(Halide::Func input, bool grayscale) {
+    return grayscale ? scharr_3x3<2>(input) : scharr_3x3<3>(input);
+}
+
 // Prewitt operator
 // Computes x,y gradients
 // http://en.wikipedia.org/wiki/Prewitt_operator
-std::pair<Halide::Func, Halide::Func> prewitt_3x3(Halide::Func input, bool grayscale) {
+template <int Dims>
+std::pair<Halide::Func, Halide::Func> prewitt_3x3(Halide::Func input) {
     Halide::Func kx("kx"), ky("ky");
     Halide::Func gx("gradient_x"), gy("gradient_y");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
     
     kx(x,y) = 0;
     kx(-1,-1) = -1;    kx(0,-1) = 0;    kx(1,-1) = 1;
     kx(-1, 0) = -1;    kx(0, 0) = 0;    kx(1, 0) = 1;
     kx(-1, 1) = -1;    kx(0, 1) = 0;    kx(1, 1) = 1;
-    if (grayscale)
-        gx(x,y) = sum(input(x+r.x, y+r.y) * kx(r.x, r.y));
-    else
-        gx(x,y,c) = sum(input(x+r.x, y+r.y, c) * kx(r.x, r.y));
+    gx(p.args()) = sum(input(p.at(r.x, r.y)) * kx(r.x, r.y));
         
     ky(x,y) = 0;
     ky(-1,-1) = -1;    ky(0,-1) = -1;    ky(1,-1) = -1;
     ky(-1, 0) =  0;    ky(0, 0) =  0;    ky(1, 0) =  0;
     ky(-1, 1) =  1;    ky(0, 1) =  1;    ky(1, 1) =  1;
-    if (grayscale)
-        gy(x,y) = sum(input(x+r.x, y+r.y) * ky(r.x, r.y));
-    else
-        gy(x,y,c) = sum(input(x+r.x, y+r.y, c) * ky(r.x, r.y));
+    gy(p.args()) = sum(input(p.at(r.x, r.y)) * ky(r.x, r.y));
 
     std::pair<Halide::Func, Halide::Func> ret = std::make_pair(gx, gy);
     return ret;
 }
 
-// compute gradient magnitude
+template std::pair<Halide::Func, Halide::Func> prewitt_3x3<2>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> prewitt_3x3<3>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> prewitt_3x3<4>(Halide::Func input);
+
+std::pair<Halide::Func, Halide::Func> prewitt_3x3(Halide::Func input, bool grayscale) {
+    return grayscale ? prewitt_3x3<2>(input) : prewitt_3x3<3>(input);
+}
+
+// compute gradient magnitude (of 2D, 3D or 4D gradients)
 Halide::Func grad_magnitude(Halide::Func Gx, Halide::Func Gy) {
     Halide::Func mag("grad_magnitude");
-    Halide::Var x,y,c;
-    mag(x,y) =  Halide::sqrt( 
-                     Halide::pow(Gx(x,y), 2) + Halide::pow(Gy(x,y), 2)
+    std::vector<Halide::Var> args = Gx.args();
+    std::vector<Halide::Expr> coords(args.begin(), args.end());
+    mag(args) =  Halide::sqrt( 
+                     Halide::pow(Gx(coords), 2) + Halide::pow(Gy(coords), 2)
                 );
     return mag;
 }
@@ -109,10 +118,12 @@ Halide::Func grad_direction(Halide::Func Gx, Halide::Func Gy)
 // Gaussian 5x5 filter; with delta=1.4
 // Used by Canny edge detector
 // http://en.wikipedia.org/wiki/Canny_edge_detector
-Halide::Func gaussian_5x5_delta14(Halide::Func input, bool grayscale) {
+template <int Dims>
+Halide::Func gaussian_5x5_delta14(Halide::Func input) {
     Halide::Func k, gaussian("gaussian_5x5_delta14");
     Halide::RDom r(-2,5,-2,5);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
 
     k(x,y) = 0;
     k(-2,-2) = 2;    k(-1,-2) =  4;   k(0,-2) =  5;   k(1,-2) =  4;   k(2,-2) = 2;
@@ -121,35 +132,46 @@ Halide::Func gaussian_5x5_delta14(Halide::Func input, bool grayscale) {
     k(-2, 1) = 4;    k(-1, 1) =  9;   k(0, 1) = 12;   k(1, 1) =  9;   k(2, 1) = 4;
     k(-2, 2) = 2;    k(-1, 2) =  4;   k(0, 2) =  5;   k(1, 2) =  4;   k(2, 2) = 2;
 
-    if (grayscale) {
-        gaussian(x,y) = sum(input(x+r.x, y+r.y) * k(r.x, r.y));
-        gaussian(x,y) /= 159;
-    } else {
-        gaussian(x,y,c) = sum(input(x+r.x, y+r.y, c) * k(r.x, r.y));
-        gaussian(x,y,c) /= 159;
-    }
+    gaussian(p.args()) = sum(input(p.at(r.x, r.y)) * k(r.x, r.y));
+    gaussian(p.args()) /= 159;
 
     return gaussian;
 }
 
+template Halide::Func gaussian_5x5_delta14<2>(Halide::Func input);
+template Halide::Func gaussian_5x5_delta14<3>(Halide::Func input);
+template Halide::Func gaussian_5x5_delta14<4>(Halide::Func input);
+
+Halide::Func gaussian_5x5_delta14(Halide::Func input, bool grayscale) {
+    return grayscale ? gaussian_5x5_delta14<2>(input) : gaussian_5x5_delta14<3>(input);
+}
+
 
 // Canny edge detector
 // http://docs.opencv.org/doc/tutorials/imgproc/imgtrans/canny_detector/canny_detector.html
 // http://dasl.mem.drexel.edu/alumni/bGreen/www.pages.drexel.edu/_weg22/can_tut.html
-Halide::Func canny_detector(Halide::Func input, bool grayscale) {
+template <int Dims>
+Halide::Func canny_detector(Halide::Func input) {
     // 1. noise reduction
-    Halide::Func blur = gaussian_5x5_delta14(input, grayscale);
+    Halide::Func blur = gaussian_5x5_delta14<Dims>(input);
     // 2a. gradient calculation
-    std::pair<Halide::Func, Halide::Func> gradients = sobel_3x3(blur, grayscale);
-    // 2b. gradient magnitude and direction
+    std::pair<Halide::Func, Halide::Func> gradients = sobel_3x3<Dims>(blur);
+    // 2b. gradient magnitude (and the direction, grad_direction, once 3. uses it)
     Halide::Func mag = grad_magnitude(gradients.first, gradients.second);
-    Halide::Func dir = grad_direction(gradients.first, gradients.second);
 
     // 3. non-maximum suppression
     // 4. hysteresis
     return mag;
 }
 
+template Halide::Func canny_detector<2>(Halide::Func input);
+template Halide::Func canny_detector<3>(Halide::Func input);
+template Halide::Func canny_detector<4>(Halide::Func input);
+
+Halide::Func canny_detector(Halide::Func input, bool grayscale) {
+    return grayscale ? canny_detector<2>(input) : canny_detector<3>(input);
+}
+
 
 // -------------------------------------------------------------------------------------------------------------
 // one-sides (vertical) reflection across the line x=k
@@ -185,7 +207,7 @@ Halide::Func bilinear_scale(Halide::Func input, float w_factor, float h_factor)
     Halide::Expr t = (y * h_factor) - y_lower;
 
     scale(x,y,c) =  Halide::cast<uint8_t>(
-                    (1-s) * (1-t) * input(x_lower, y_lower+1, c)  +
+                    (1-s) * (1-t) * input(x_lower, y_lower, c)    +
                     s * (1-t)     * input(x_lower+1, y_lower, c)  +
                     (1-s) * t     * input(x_lower, y_lower+1, c)  + 
                     s * t         * input(x_lower+1, y_lower+1, c)
@@ -200,23 +222,31 @@ Halide::Func bilinear_scale(Halide::Func input, float w_factor, float h_factor)
 //        = gamma * input + (1-gamma) * average_mask
 // if gamma>1, then high-frequency component is emphasized
 // Handbook of Computer Vision Algorithms in Image Algebra, 2nd Ed - Gerhard X. Ritter, section 2.10
-Halide::Func unsharp_mask(Halide::Func input, Halide::Func avg_mask, float gamma, bool grayscale) {
+template <int Dims>
+Halide::Func unsharp_mask(Halide::Func input, Halide::Func avg_mask, float gamma) {
     Halide::Func output("unsharp_mask_output");
-    Halide::Var x,y,c;
+    image_coords<Dims> p;
 
-    if (grayscale)
-        output(x,y) = gamma * input(x,y) + (1.0f-gamma) * avg_mask(x,y);
-    else
-        output(x,y,c) = gamma * input(x,y,c) + (1.0f-gamma) * avg_mask(x,y,c);
+    output(p.args()) = gamma * input(p.at(0, 0)) + (1.0f-gamma) * avg_mask(p.at(0, 0));
     return output;
 }
 
+template Halide::Func unsharp_mask<2>(Halide::Func input, Halide::Func avg_mask, float gamma);
+template Halide::Func unsharp_mask<3>(Halide::Func input, Halide::Func avg_mask, float gamma);
+template Halide::Func unsharp_mask<4>(Halide::Func input, Halide::Func avg_mask, float gamma);
+
+Halide::Func unsharp_mask(Halide::Func input, Halide::Func avg_mask, float gamma, bool grayscale) {
+    return grayscale ? unsharp_mask<2>(input, avg_mask, gamma) : unsharp_mask<3>(input, avg_mask, gamma);
+}
+
 // This implementation uses an equal weight mean function for the average mask and the unsharp 
 // mask is applied in one go using a convolution with a 3x3 neighborhood
-Halide::Func fast_unsharp_mask(Halide::Func input, float gamma, float grayscale) {
+template <int Dims>
+Halide::Func fast_unsharp_mask(Halide::Func input, float gamma) {
     Halide::Func output("output"),f("convolution");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
 
     Halide::Expr v = (1.0f-gamma) / 9.0f;
     Halide::Expr w = (8.0f * gamma + 1.0f) / 9.0f;
@@ -226,9 +256,14 @@ Halide::Func fast_unsharp_mask(Halide::Func input, float gamma, float grayscale)
     f(-1, 0) = v;    f(0, 0) = w;    f(1, 0) = v;
     f(-1, 1) = v;    f(0, 1) = v;    f(1, 1) = v;
 
-    if (grayscale)
-        output(x,y) = sum(input(x+r.x, y+r.y) * f(r.x, r.y));
-    else
-        output(x,y,c) = sum(input(x+r.x, y+r.y, c) * f(r.x, r.y));
+    output(p.args()) = sum(input(p.at(r.x, r.y)) * f(r.x, r.y));
     return output;
 }
+
+template Halide::Func fast_unsharp_mask<2>(Halide::Func input, float gamma);
+template Halide::Func fast_unsharp_mask<3>(Halide::Func input, float gamma);
+template Halide::Func fast_unsharp_mask<4>(Halide::Func input, float gamma);
+
+Halide::Func fast_unsharp_mask(Halide::Func input, float gamma, float grayscale) {
+    return grayscale ? fast_unsharp_mask<2>(input, gamma) : fast_unsharp_mask<3>(input, gamma);
+}
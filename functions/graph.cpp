@@ -0,0 +1,268 @@
+#include "graph.h"
+#include <cassert>
+#include <cstdio>
+
+//
+// Graph construction, verification (scheduling + compilation) and execution.
+// See graph.h for the model.
+//
+
+// Where a node's output is computed, relative to the loop nest of the graph outputs
+enum placement {
+    PLACE_INLINE,   // fused into its (single) consumer
+    PLACE_ROW,      // per row of output, with a sliding window over each strip of rows
+    PLACE_ROOT      // the whole image, before the output loop nest
+};
+
+Graph::image_id Graph::add_image(const std::string &name, image_kind kind) {
+    image_desc image;
+    image.name = name;
+    image.kind = kind;
+    image.producer = -1;
+    images.push_back(image);
+    verified = false;
+    return images.size() - 1;
+}
+
+Graph::image_id Graph::input(Halide::Type t, int dimensions, const std::string &name) {
+    image_id id = add_image(name.empty() ? "graph_input" : name, IMAGE_INPUT);
+    images[id].param = Halide::ImageParam(t, dimensions, images[id].name);
+    return id;
+}
+
+Graph::image_id Graph::virtual_image(const std::string &name) {
+    return add_image(name.empty() ? "graph_virtual" : name, IMAGE_VIRTUAL);
+}
+
+Graph::image_id Graph::output(const std::string &name) {
+    image_id id = add_image(name.empty() ? "graph_output" : name, IMAGE_OUTPUT);
+    outputs.push_back(id);
+    return id;
+}
+
+void Graph::add_node(const std::string &name, node_function fn, const std::vector<image_id> &inputs,
+                     image_id output, node_kind kind) {
+    node_desc node;
+    node.name = name;
+    node.fn = fn;
+    node.inputs = inputs;
+    node.output = output;
+    node.kind = kind;
+    nodes.push_back(node);
+    verified = false;
+}
+
+// Order the nodes so that every node comes after the producers of its inputs.
+// Returns false if the graph has a cycle.
+bool Graph::topological_order(std::vector<size_t> &order) const {
+    std::vector<size_t> pending(nodes.size());
+    std::vector<size_t> ready;
+    for (size_t n=0; n<nodes.size(); n++) {
+        for (size_t i=0; i<nodes[n].inputs.size(); i++)
+            if (images[nodes[n].inputs[i]].kind != IMAGE_INPUT)
+                pending[n]++;
+        if (pending[n] == 0)
+            ready.push_back(n);
+    }
+
+    order.clear();
+    while (!ready.empty()) {
+        size_t n = ready.back();
+        ready.pop_back();
+        order.push_back(n);
+        const std::vector<size_t> &consumers = images[nodes[n].output].consumers;
+        for (size_t c=0; c<consumers.size(); c++) {
+            // a node may read the same image more than once
+            const std::vector<image_id> &inputs = nodes[consumers[c]].inputs;
+            for (size_t i=0; i<inputs.size(); i++)
+                if (inputs[i] == nodes[n].output && --pending[consumers[c]] == 0)
+                    ready.push_back(consumers[c]);
+        }
+    }
+    return order.size() == nodes.size();
+}
+
+bool Graph::verify(const Halide::Target &t) {
+    verified = false;
+    target = t;
+
+    // Connectivity: every non-input image has exactly one producer, inputs have none
+    for (size_t i=0; i<images.size(); i++) {
+        images[i].producer = -1;
+        images[i].consumers.clear();
+    }
+    for (size_t n=0; n<nodes.size(); n++) {
+        image_desc &out = images[nodes[n].output];
+        if (out.kind == IMAGE_INPUT || out.producer != -1) {
+            fprintf(stderr, "Graph: image %s is written by node %s but is %s\n", out.name.c_str(),
+                    nodes[n].name.c_str(), out.kind == IMAGE_INPUT ? "a graph input" : "already written");
+            return false;
+        }
+        out.producer = n;
+        for (size_t i=0; i<nodes[n].inputs.size(); i++) {
+            std::vector<size_t> &consumers = images[nodes[n].inputs[i]].consumers;
+            if (consumers.empty() || consumers.back() != n)
+                consumers.push_back(n);
+        }
+    }
+    for (size_t i=0; i<images.size(); i++) {
+        if (images[i].kind != IMAGE_INPUT && images[i].producer == -1) {
+            fprintf(stderr, "Graph: image %s is never written\n", images[i].name.c_str());
+            return false;
+        }
+        if (images[i].kind == IMAGE_VIRTUAL && images[i].consumers.empty()) {
+            fprintf(stderr, "Graph: virtual image %s is never read\n", images[i].name.c_str());
+            return false;
+        }
+    }
+    if (outputs.empty()) {
+        fprintf(stderr, "Graph: no output images\n");
+        return false;
+    }
+
+    std::vector<size_t> order;
+    if (!topological_order(order)) {
+        fprintf(stderr, "Graph: the graph has a cycle\n");
+        return false;
+    }
+
+    // Build the algorithm.  Inputs are clamped to their extents, so that stencils
+    // may read past the borders.
+    for (size_t i=0; i<images.size(); i++) {
+        if (images[i].kind != IMAGE_INPUT)
+            continue;
+        Halide::ImageParam &param = images[i].param;
+        Halide::Func clamped(images[i].name + "_clamped");
+        Halide::Var x,y,c;
+        if (param.dimensions() == 2)
+            clamped(x,y) = param(clamp(x, 0, param.width()-1), clamp(y, 0, param.height()-1));
+        else
+            clamped(x,y,c) = param(clamp(x, 0, param.width()-1), clamp(y, 0, param.height()-1), c);
+        images[i].func = clamped;
+    }
+    for (size_t o=0; o<order.size(); o++) {
+        const node_desc &node = nodes[order[o]];
+        std::vector<Halide::Func> inputs;
+        for (size_t i=0; i<node.inputs.size(); i++)
+            inputs.push_back(images[node.inputs[i]].func);
+        images[node.output].func = node.fn(inputs);
+    }
+
+    const int dims = images[outputs[0]].func.dimensions();
+    for (size_t o=1; o<outputs.size(); o++) {
+        if (images[outputs[o]].func.dimensions() != dims) {
+            fprintf(stderr, "Graph: output %s has %d dimensions, expected %d\n",
+                    images[outputs[o]].name.c_str(), images[outputs[o]].func.dimensions(), dims);
+            return false;
+        }
+    }
+
+    // All outputs are produced together, as the elements of a single Tuple function
+    std::vector<Halide::Var> args;
+    std::vector<Halide::Expr> coords;
+    for (int d=0; d<dims; d++) {
+        args.push_back(Halide::Var());
+        coords.push_back(args.back());
+    }
+    pipeline = Halide::Func("graph");
+    if (outputs.size() == 1) {
+        pipeline(args) = images[outputs[0]].func(coords);
+    } else {
+        std::vector<Halide::Expr> values;
+        for (size_t o=0; o<outputs.size(); o++)
+            values.push_back(images[outputs[o]].func(coords));
+        pipeline(args) = Halide::Tuple(values);
+    }
+
+    schedule();
+    pipeline.compile_jit(target);
+    verified = true;
+    return true;
+}
+
+// Decide where each node is computed, visiting consumers before their producers:
+//  - a pointwise node read by a single node is inlined into it
+//  - a global node is computed at root, and so is everything a root node reads
+//  - everything else is computed row by row inside the output loop nest, storing a
+//    strip of rows so that stencils slide over their input instead of recomputing it
+void Graph::schedule() {
+    std::vector<size_t> order;
+    topological_order(order);
+
+    // 'evaluated' is where an image is actually computed: for an inlined image, that is
+    // wherever the function it is inlined into is computed
+    std::vector<placement> place(images.size(), PLACE_ROW), evaluated(images.size(), PLACE_ROW);
+    for (size_t o=order.size(); o-- > 0;) {
+        const node_desc &node = nodes[order[o]];
+        const image_desc &out = images[node.output];
+
+        bool read_at_root = false;
+        for (size_t c=0; c<out.consumers.size(); c++)
+            if (evaluated[nodes[out.consumers[c]].output] == PLACE_ROOT)
+                read_at_root = true;
+
+        if (node.kind == NODE_POINTWISE && out.kind == IMAGE_VIRTUAL && out.consumers.size() == 1) {
+            place[node.output] = PLACE_INLINE;
+            evaluated[node.output] = evaluated[nodes[out.consumers[0]].output];
+        } else {
+            place[node.output] = (node.kind == NODE_GLOBAL || read_at_root) ? PLACE_ROOT : PLACE_ROW;
+            evaluated[node.output] = place[node.output];
+        }
+    }
+
+    Halide::Var x = pipeline.args()[0];
+    Halide::Var yo, yi;
+    const int vector_width = target.natural_vector_size(pipeline.output_types()[0]);
+    if (pipeline.dimensions() >= 2)
+        pipeline.split(pipeline.args()[1], yo, yi, strip_height).parallel(yo);
+    pipeline.vectorize(x, vector_width);
+
+    for (size_t i=0; i<images.size(); i++) {
+        if (images[i].kind == IMAGE_INPUT)
+            continue;
+        Halide::Func f = images[i].func;
+        std::vector<Halide::Var> fargs = f.args();
+        int width = target.natural_vector_size(f.output_types()[0]);
+        switch (place[i]) {
+        case PLACE_INLINE:
+            break;
+        case PLACE_ROW:
+            if (pipeline.dimensions() >= 2)
+                f.store_at(pipeline, yo).compute_at(pipeline, yi);
+            else
+                f.compute_at(pipeline, x);
+            f.vectorize(fargs[0], width);
+            break;
+        case PLACE_ROOT:
+            f.compute_root();
+            if (fargs.size() >= 2)
+                f.parallel(fargs[1]);
+            f.vectorize(fargs[0], width);
+            break;
+        }
+    }
+}
+
+void Graph::bind(image_id image, Halide::Buffer buffer) {
+    assert(image < images.size() && images[image].kind != IMAGE_VIRTUAL);
+    images[image].buffer = buffer;
+    if (images[image].kind == IMAGE_INPUT)
+        images[image].param.set(buffer);
+}
+
+void Graph::execute() {
+    assert(verified);
+    if (outputs.size() == 1) {
+        pipeline.realize(images[outputs[0]].buffer, target);
+        return;
+    }
+    std::vector<Halide::Buffer> buffers;
+    for (size_t o=0; o<outputs.size(); o++)
+        buffers.push_back(images[outputs[o]].buffer);
+    pipeline.realize(Halide::Realization(buffers), target);
+}
+
+Halide::Func Graph::func(image_id image) const {
+    assert(image < images.size());
+    return images[image].func;
+}
@@ -17,34 +17,38 @@ Halide::Func scale(interpolation_type interpolation) {
 //
 // https://www.khronos.org/registry/vx/specs/1.0/html/da/d4b/group__group__vision__function__sobel3x3.html
 //
-std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input, bool grayscale) {
+template <int Dims>
+std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input) {
     Halide::Func kx("kx"), ky("ky");
     Halide::Func gradient_x("gradient_x"), gradient_y("gradient_y");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
     
     kx(x,y) = 0;
     kx(-1,-1) = -1;    kx(0,-1) = 0;    kx(1,-1) = 1;
     kx(-1, 0) = -2;    kx(0, 0) = 0;    kx(1, 0) = 2;
     kx(-1, 1) = -1;    kx(0, 1) = 0;    kx(1, 1) = 1;
-    if (grayscale)
-        gradient_x(x,y) = sum(input(x+r.x, y+r.y) * kx(r.x, r.y));
-    else
-        gradient_x(x,y,c) = sum(input(x+r.x, y+r.y, c) * kx(r.x, r.y));
+    gradient_x(p.args()) = sum(input(p.at(r.x, r.y)) * kx(r.x, r.y));
         
     ky(x,y) = 0;
     ky(-1,-1) = -1;    ky(0,-1) = -2;    ky(1,-1) = -1;
     ky(-1, 0) =  0;    ky(0, 0) =  0;    ky(1, 0) =  0;
     ky(-1, 1) =  1;    ky(0, 1) =  2;    ky(1, 1) =  1;
-    if (grayscale)
-        gradient_y(x,y) = sum(input(x+r.x, y+r.y) * ky(r.x, r.y));
-    else
-        gradient_y(x,y,c) = sum(input(x+r.x, y+r.y, c) * ky(r.x, r.y));
+    gradient_y(p.args()) = sum(input(p.at(r.x, r.y)) * ky(r.x, r.y));
 
     std::pair<Halide::Func, Halide::Func> ret = std::make_pair(gradient_x, gradient_y);
     return ret;
 }
 
+template std::pair<Halide::Func, Halide::Func> sobel_3x3<2>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> sobel_3x3<3>(Halide::Func input);
+template std::pair<Halide::Func, Halide::Func> sobel_3x3<4>(Halide::Func input);
+
+std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input, bool grayscale) {
+    return grayscale ? sobel_3x3<2>(input) : sobel_3x3<3>(input);
+}
+
 // Per OpenVX
 // Computes a Gaussian filter over a window of the input image.
 // This filter uses the following convolution matrix:
@@ -53,28 +57,32 @@ std::pair<Halide::Func, Halide::Func> sobel_3x3(Halide::Func input, bool graysca
 //         1  2  1
 //
 // https://www.khronos.org/registry/vx/specs/1.0/html/d6/d58/group__group__vision__function__gaussian__image.html
-Halide::Func gaussian_3x3(Halide::Func input, bool grayscale, const Scheduler &s) {
+template <int Dims>
+Halide::Func gaussian_3x3(Halide::Func input, const Scheduler &s) {
     Halide::Func k, gaussian("gaussian_3x3");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,xi,yi,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
     
     k(x,y) = 0;
     k(-1,-1) = 1;    k(0,-1) = 2;    k(1,-1) = 1;
     k(-1, 0) = 2;    k(0, 0) = 4;    k(1, 0) = 2;
     k(-1, 1) = 1;    k(0, 1) = 2;    k(1, 1) = 1;
 
-    if (grayscale) {
-        gaussian(x,y) = sum(input(x+r.x, y+r.y) * k(r.x, r.y)) / 16;
-        //gaussian(x,y) /= 16;
-    } else {
-        gaussian(x,y,c) = sum(input(x+r.x, y+r.y, c) * k(r.x, r.y)) / 16;
-        //gaussian(x,y,c) /= 16;
-    }
+    gaussian(p.args()) = sum(input(p.at(r.x, r.y)) * k(r.x, r.y)) / 16;
     
-    s.schedule(gaussian, x, y);
+    s.schedule(gaussian, p.x, p.y);
     return gaussian;
 }
 
+template Halide::Func gaussian_3x3<2>(Halide::Func input, const Scheduler &s);
+template Halide::Func gaussian_3x3<3>(Halide::Func input, const Scheduler &s);
+template Halide::Func gaussian_3x3<4>(Halide::Func input, const Scheduler &s);
+
+Halide::Func gaussian_3x3(Halide::Func input, bool grayscale, const Scheduler &s) {
+    return grayscale ? gaussian_3x3<2>(input, s) : gaussian_3x3<3>(input, s);
+}
+
 Halide::Func gaussian_3x3_2(Halide::Func input, const Scheduler &s) {
     Halide::Func k, gaussian("gaussian_3x3");
     Halide::Var x,y,xi,yi,c;
@@ -128,10 +136,12 @@ Halide::Func gaussian_3x3_5(Halide::Func input, const Scheduler &s) {
 }
 // Per OpenVX
 // https://www.khronos.org/registry/vx/specs/1.0/html/d0/d15/group__group__vision__function__gaussian__pyramid.html
-Halide::Func gaussian_5x5(Halide::Func input) {
-    Halide::Func k, gaussian;
+template <int Dims>
+Halide::Func gaussian_5x5(Halide::Func input, const Scheduler &s) {
+    Halide::Func k, gaussian("gaussian_5x5");
     Halide::RDom r(-2,5,-2,5);
-    Halide::Var x,y,c;
+    Halide::Var x,y;
+    image_coords<Dims> p;
 
     k(x,y) = 0;
     k(-2,-2) = 1;    k(-1,-2) =  4;   k(0,-2) =  6;   k(1,-2) =  4;   k(2,-2) = 1;
@@ -140,70 +150,329 @@ Halide::Func gaussian_5x5(Halide::Func input) {
     k(-2, 1) = 4;    k(-1, 1) = 16;   k(0, 1) = 24;   k(1, 1) = 16;   k(2, 1) = 4;
     k(-2, 2) = 1;    k(-1, 2) =  4;   k(0, 2) =  6;   k(1, 2) =  4;   k(2, 2) = 1;
 
-    gaussian(x,y,c) = sum(input(x+r.x, y+r.y, c) * k(r.x, r.y));
-    gaussian(x,y,c) /= 256;
+    gaussian(p.args()) = sum(input(p.at(r.x, r.y)) * k(r.x, r.y));
+    gaussian(p.args()) /= 256;
 
+    s.schedule(gaussian, p.x, p.y);
     return gaussian;
 }
 
+template Halide::Func gaussian_5x5<2>(Halide::Func input, const Scheduler &s);
+template Halide::Func gaussian_5x5<3>(Halide::Func input, const Scheduler &s);
+template Halide::Func gaussian_5x5<4>(Halide::Func input, const Scheduler &s);
+
+Halide::Func gaussian_5x5(Halide::Func input, bool grayscale) {
+    return grayscale ? gaussian_5x5<2>(input) : gaussian_5x5<3>(input);
+}
+
+// Per OpenVX
+// Builds a half-scale Gaussian pyramid: each level is the previous level smoothed by
+// gaussian_5x5 and then decimated by 2 in each dimension.  Level 0 is the input itself.
+// The input must be a 2D (grayscale) function of size width x height.  Every level is
+// clamped to its own extent before it is filtered, so the returned levels can be sampled
+// anywhere, but only the region [0, pyramid_extent(width, l)) is meaningful.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d0/d15/group__group__vision__function__gaussian__pyramid.html
+std::vector<Halide::Func> gaussian_pyramid(Halide::Func input, Halide::Expr width, Halide::Expr height, int levels) {
+    std::vector<Halide::Func> pyramid;
+    Halide::Var x,y;
+
+    pyramid.push_back(input);
+    for (int l=1; l<levels; l++) {
+        Halide::Expr w = pyramid_extent(width, l-1);
+        Halide::Expr h = pyramid_extent(height, l-1);
+        Halide::Func clamped, level("gaussian_pyramid_" + std::to_string(l));
+
+        clamped(x,y) = pyramid[l-1](clamp(x, 0, w-1), clamp(y, 0, h-1));
+        Halide::Func blur = gaussian_5x5<2>(clamped);
+        level(x,y) = blur(2*x, 2*y);
+        pyramid.push_back(level);
+    }
+    return pyramid;
+}
+
+// The extent of a dimension at pyramid level 'level' (OpenVX rounds up when halving)
+Halide::Expr pyramid_extent(Halide::Expr extent, int level) {
+    for (int l=0; l<level; l++)
+        extent = (extent + 1) / 2;
+    return extent;
+}
+
 
 // Per OpenVX 
 // Implements Erosion, which shrinks the white space in an image.
 // This k uses a 3x3 box around the output pixel used to determine value.
 // https://www.khronos.org/registry/vx/specs/1.0/html/dc/dff/group__group__vision__function__erode__image.html
+template <int Dims>
 Halide::Func erode_3x3(Halide::Func input) {
     Halide::Func erode("erode");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    image_coords<Dims> p;
 
-    erode(x,y,c) = Halide::minimum(input(x+r.x, y+r.y, c));
+    erode(p.args()) = Halide::minimum(input(p.at(r.x, r.y)));
     return erode;
 }
 
+template Halide::Func erode_3x3<2>(Halide::Func input);
+template Halide::Func erode_3x3<3>(Halide::Func input);
+template Halide::Func erode_3x3<4>(Halide::Func input);
+
+Halide::Func erode_3x3(Halide::Func input) {
+    return erode_3x3<3>(input);
+}
+
 // Per OpenVX 
 // Implements Dilation, which grows the white space in an image.
 // This k uses a 3x3 box around the output pixel used to determine value.
 // https://www.khronos.org/registry/vx/specs/1.0/html/dc/d73/group__group__vision__function__dilate__image.html
+template <int Dims>
 Halide::Func dilate_3x3(Halide::Func input) {
     Halide::Func dilate("dilate");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    image_coords<Dims> p;
 
-    dilate(x,y,c) = Halide::maximum(input(x+r.x, y+r.y, c));
+    dilate(p.args()) = Halide::maximum(input(p.at(r.x, r.y)));
     return dilate;
 }
 
+template Halide::Func dilate_3x3<2>(Halide::Func input);
+template Halide::Func dilate_3x3<3>(Halide::Func input);
+template Halide::Func dilate_3x3<4>(Halide::Func input);
+
+Halide::Func dilate_3x3(Halide::Func input) {
+    return dilate_3x3<3>(input);
+}
+
 // Per OpenVX 
 // Computes a Box filter over a window of the input image.
 // https://www.khronos.org/registry/vx/specs/1.0/html/da/d7c/group__group__vision__function__box__image.html
-Halide::Func box_3x3(Halide::Func input, bool grayscale) {
+template <int Dims>
+Halide::Func box_3x3(Halide::Func input, const Scheduler &s) {
     Halide::Func box("box");
     Halide::RDom r(-1,3,-1,3);
-    Halide::Var x,y,c;
+    image_coords<Dims> p;
 
-    if (grayscale)
-        box(x,y) = Halide::sum(input(x+r.x, y+r.y)) / 9;
-    else
-        box(x,y,c) = Halide::sum(input(x+r.x, y+r.y, c)) / 9;
+    box(p.args()) = Halide::sum(input(p.at(r.x, r.y))) / 9;
 
+    s.schedule(box, p.x, p.y);
     return box;
 }
+
+template Halide::Func box_3x3<2>(Halide::Func input, const Scheduler &s);
+template Halide::Func box_3x3<3>(Halide::Func input, const Scheduler &s);
+template Halide::Func box_3x3<4>(Halide::Func input, const Scheduler &s);
+
+Halide::Func box_3x3(Halide::Func input, bool grayscale) {
+    return grayscale ? box_3x3<2>(input) : box_3x3<3>(input);
+}
     
-// Per OpenVX
+// Per OpenVX: the uint32 sum of the input over [0,x] x [0,y], for 0 <= x < width and
+// 0 <= y < height
 // https://www.khronos.org/registry/vx/specs/1.0/html/d0/d7b/group__group__vision__function__integral__image.html
-// TODO: this is currently incorrect
-Halide::Func integral_image(Halide::Func input) {
-    Halide::Func integral("integral");
-    Halide::RDom r(-1,2,-1,2);
+Halide::Func integral_image(Halide::Func input, Halide::Expr width, Halide::Expr height) {
+    Halide::Func rows("integral_rows"), integral("integral");
+    Halide::RDom rx(1, width - 1), ry(1, height - 1);
     Halide::Var x,y,c;
 
-    integral(x,y,c) = 0;
-    integral(-1,y,c) = 0;
-    integral(x,-1,c) = 0;
-    //integral(x,y,c) = Halide::sum(Halide::cast<int32_t>(input(x+r.x, y+r.y, c)));
-    //integral(x,y,c) = integral(x,y,c) + integral(x-1,y,c) + integral(x,y-1,c) + integral(x-1,y-1,c);
-    Halide::Expr e[] = { integral(x,y,c), integral(x-1,y,c), integral(x,y-1,c), integral(x-1,y-1,c) };
-    integral(x,y,c) = e[0] + e[1] + e[2] + e[3];
+    // Running sums along each row, then down each column of the row sums
+    rows(x,y,c) = Halide::cast<uint32_t>(input(x,y,c));
+    rows(rx,y,c) += rows(rx-1,y,c);
+    integral(x,y,c) = rows(x,y,c);
+    integral(x,ry,c) += integral(x,ry-1,c);
+    rows.compute_root();
     return integral;
 }
 
+
+// The value of pixel (x,y) of a 2D (grayscale) or 3D input
+static Halide::Expr pixel_at(Halide::Func input, Halide::Expr x, Halide::Expr y, Halide::Var c, bool grayscale) {
+    if (grayscale)
+        return input(x,y);
+    return input(x,y,c);
+}
+
+// Extend the input beyond its width x height extent according to the border mode
+static Halide::Func apply_border(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                                 border_mode border, Halide::Expr constant, bool grayscale) {
+    Halide::Func bordered("bordered");
+    Halide::Var x,y,c;
+
+    Halide::Expr clamped = pixel_at(input, clamp(x, 0, width-1), clamp(y, 0, height-1), c, grayscale);
+    Halide::Expr value = clamped;
+    if (border == BORDER_CONSTANT) {
+        Halide::Expr inside = x >= 0 && x < width && y >= 0 && y < height;
+        value = select(inside, clamped, Halide::cast(input.output_types()[0], constant));
+    }
+
+    if (grayscale)
+        bordered(x,y) = value;
+    else
+        bordered(x,y,c) = value;
+    return bordered;
+}
+
+// Sample the bordered input at the (floating-point) source location (sx, sy)
+static Halide::Expr warp_sample(Halide::Func bordered, Halide::Expr sx, Halide::Expr sy,
+                                interpolation_type interpolation, Halide::Var c, bool grayscale) {
+    Halide::Type t = bordered.output_types()[0];
+
+    if (interpolation == NEAREST_NEIGHBOR) {
+        Halide::Expr ix = Halide::cast<int>(Halide::floor(sx + 0.5f));
+        Halide::Expr iy = Halide::cast<int>(Halide::floor(sy + 0.5f));
+        return pixel_at(bordered, ix, iy, c, grayscale);
+    }
+
+    Halide::Expr x0 = Halide::floor(sx), y0 = Halide::floor(sy);
+    Halide::Expr ix = Halide::cast<int>(x0), iy = Halide::cast<int>(y0);
+    Halide::Expr s = sx - x0, u = sy - y0;
+    Halide::Expr value = (1.0f-s) * (1.0f-u) * pixel_at(bordered, ix,   iy,   c, grayscale) +
+                         s * (1.0f-u)        * pixel_at(bordered, ix+1, iy,   c, grayscale) +
+                         (1.0f-s) * u        * pixel_at(bordered, ix,   iy+1, c, grayscale) +
+                         s * u               * pixel_at(bordered, ix+1, iy+1, c, grayscale);
+    if (!t.is_float())
+        value = value + 0.5f;   // round to nearest
+    return Halide::cast(t, value);
+}
+
+// Per OpenVX
+// Warps the input using an affine transformation.  The 2x3 matrix is given in the OpenVX
+// (column-major) layout, and maps output coordinates to input coordinates:
+//     x0 = matrix[0]*x + matrix[2]*y + matrix[4]
+//     y0 = matrix[1]*x + matrix[3]*y + matrix[5]
+// Only NEAREST_NEIGHBOR and BILINEAR interpolation are supported (AREA is treated as BILINEAR).
+// Samples outside the width x height input are either 'constant' or replicate the nearest
+// edge pixel.  Use a TileSched scheduler for large rotations: scanning the output in tiles
+// keeps the (rotated) source footprint of each tile in cache.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d5/d5f/group__group__vision__function__warp__affine.html
+Halide::Func warp_affine(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                         const float matrix[6], interpolation_type interpolation,
+                         border_mode border, Halide::Expr constant, bool grayscale, const Scheduler &s) {
+    Halide::Func warp("warp_affine");
+    Halide::Var x,y,c;
+    Halide::Func bordered = apply_border(input, width, height, border, constant, grayscale);
+
+    Halide::Expr sx = matrix[0] * x + matrix[2] * y + matrix[4];
+    Halide::Expr sy = matrix[1] * x + matrix[3] * y + matrix[5];
+
+    if (grayscale)
+        warp(x,y) = warp_sample(bordered, sx, sy, interpolation, c, grayscale);
+    else
+        warp(x,y,c) = warp_sample(bordered, sx, sy, interpolation, c, grayscale);
+
+    s.schedule(warp, x, y);
+    return warp;
+}
+
+// Per OpenVX
+// Warps the input using a perspective transformation.  The 3x3 matrix is given in the OpenVX
+// (column-major) layout, and maps output coordinates to input coordinates:
+//     x0 = matrix[0]*x + matrix[3]*y + matrix[6]
+//     y0 = matrix[1]*x + matrix[4]*y + matrix[7]
+//     z0 = matrix[2]*x + matrix[5]*y + matrix[8]
+//     output(x,y) = input(x0/z0, y0/z0)
+// https://www.khronos.org/registry/vx/specs/1.0/html/d4/d71/group__group__vision__function__warp__perspective.html
+Halide::Func warp_perspective(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                              const float matrix[9], interpolation_type interpolation,
+                              border_mode border, Halide::Expr constant, bool grayscale, const Scheduler &s) {
+    Halide::Func warp("warp_perspective");
+    Halide::Var x,y,c;
+    Halide::Func bordered = apply_border(input, width, height, border, constant, grayscale);
+
+    Halide::Expr z = matrix[2] * x + matrix[5] * y + matrix[8];
+    Halide::Expr sx = (matrix[0] * x + matrix[3] * y + matrix[6]) / z;
+    Halide::Expr sy = (matrix[1] * x + matrix[4] * y + matrix[7]) / z;
+
+    if (grayscale)
+        warp(x,y) = warp_sample(bordered, sx, sy, interpolation, c, grayscale);
+    else
+        warp(x,y,c) = warp_sample(bordered, sx, sy, interpolation, c, grayscale);
+
+    s.schedule(warp, x, y);
+    return warp;
+}
+
+// Affine warp of uint8 images using 16.16 fixed-point source coordinates and 8-bit
+// bilinear weights, so that the whole computation stays in 32-bit integer arithmetic.
+// Same semantics as warp_affine, with rounding differences of at most 1.  The coordinates
+// must satisfy |matrix coefficient| * max(width, height) < 32768 to avoid overflow.
+Halide::Func warp_affine_fixed(Halide::Func input, Halide::Expr width, Halide::Expr height,
+                               const float matrix[6], interpolation_type interpolation,
+                               border_mode border, Halide::Expr constant, bool grayscale, const Scheduler &s) {
+    Halide::Func warp("warp_affine_fixed");
+    Halide::Var x,y,c;
+    Halide::Func bordered = apply_border(input, width, height, border, constant, grayscale);
+
+    int m[6];
+    for (int i=0; i<6; i++)
+        m[i] = (int)lroundf(matrix[i] * 65536.0f);
+
+    Halide::Expr sx = m[0] * x + m[2] * y + m[4];
+    Halide::Expr sy = m[1] * x + m[3] * y + m[5];
+
+    Halide::Expr value;
+    if (interpolation == NEAREST_NEIGHBOR) {
+        value = pixel_at(bordered, (sx + 32768) >> 16, (sy + 32768) >> 16, c, grayscale);
+    } else {
+        Halide::Expr ix = sx >> 16, iy = sy >> 16;
+        Halide::Expr a = (sx >> 8) & 0xff, b = (sy >> 8) & 0xff;
+        Halide::Expr p00 = Halide::cast<int32_t>(pixel_at(bordered, ix,   iy,   c, grayscale));
+        Halide::Expr p10 = Halide::cast<int32_t>(pixel_at(bordered, ix+1, iy,   c, grayscale));
+        Halide::Expr p01 = Halide::cast<int32_t>(pixel_at(bordered, ix,   iy+1, c, grayscale));
+        Halide::Expr p11 = Halide::cast<int32_t>(pixel_at(bordered, ix+1, iy+1, c, grayscale));
+        Halide::Expr top = p00 * (256 - a) + p10 * a;
+        Halide::Expr bottom = p01 * (256 - a) + p11 * a;
+        value = Halide::cast<uint8_t>((top * (256 - b) + bottom * b + 32768) >> 16);
+    }
+
+    if (grayscale)
+        warp(x,y) = value;
+    else
+        warp(x,y,c) = value;
+
+    s.schedule(warp, x, y);
+    return warp;
+}
+
+// Per OpenVX
+// Extracts a single plane from a multi-channel image
+// https://www.khronos.org/registry/vx/specs/1.0/html/d3/d50/group__group__vision__function__channelextract.html
+Halide::Func channel_extract(Halide::Func input, int channel) {
+    Halide::Func extract("channel_extract");
+    Halide::Var x,y;
+
+    extract(x,y) = input(x,y,channel);
+    return extract;
+}
+
+// Per OpenVX
+// Combines 3 or 4 single-channel planes into a multi-channel image.  plane3 is optional.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d1/d60/group__group__vision__function__channelcombine.html
+Halide::Func channel_combine(Halide::Func plane0, Halide::Func plane1, Halide::Func plane2, Halide::Func plane3) {
+    Halide::Func combine("channel_combine");
+    Halide::Var x,y,c;
+
+    Halide::Expr last = plane2(x,y);
+    if (plane3.defined())
+        last = select(c == 2, plane2(x,y), plane3(x,y));
+    combine(x,y,c) = select(c == 0, plane0(x,y),
+                     select(c == 1, plane1(x,y), last));
+    combine.bound(c, 0, plane3.defined() ? 4 : 3);
+    return combine;
+}
+
+// Declare that an input or output buffer stores its channels interleaved (RGBRGB...),
+// i.e. channel is the innermost dimension in memory.  Knowing the strides at compile
+// time lets Halide turn the strided loads/stores into dense vector loads/stores and shuffles.
+void set_interleaved_layout(Halide::OutputImageParam buffer, int channels) {
+    buffer.set_stride(0, channels).set_stride(2, 1);
+}
+
+// Schedule a 3D (x,y,c) function whose output is stored interleaved: the channel loop is
+// made innermost and unrolled, and x is vectorized, so that the channels are combined
+// with vector shuffles and written with dense stores.
+void schedule_interleaved(Halide::Func f, int channels, int vector_width) {
+    std::vector<Halide::Var> args = f.args();
+    Halide::Var x = args[0], y = args[1], c = args[2];
+
+    f.bound(c, 0, channels).reorder(c, x, y).unroll(c).vectorize(x, vector_width).parallel(y);
+    set_interleaved_layout(f.output_buffer(), channels);
+}
@@ -0,0 +1,134 @@
+#include "excursions.h"
+
+// Sample a (clamped) float image at a sub-pixel location using bilinear interpolation
+static Halide::Expr bilinear_sample(Halide::Func f, Halide::Expr x, Halide::Expr y) {
+    Halide::Expr x0 = Halide::floor(x), y0 = Halide::floor(y);
+    Halide::Expr ix = Halide::cast<int>(x0), iy = Halide::cast<int>(y0);
+    Halide::Expr a = x - x0, b = y - y0;
+
+    return (1.0f-a) * (1.0f-b) * f(ix, iy)   + a * (1.0f-b) * f(ix+1, iy) +
+           (1.0f-a) * b        * f(ix, iy+1) + a * b        * f(ix+1, iy+1);
+}
+
+// Per OpenVX
+// Pyramidal Lucas-Kanade optical flow, as described by Bouguet:
+// "Pyramidal Implementation of the Lucas Kanade Feature Tracker" (Intel, 2000)
+//
+// Tracking starts at the coarsest pyramid level with a zero guess.  At every level the
+// spatial gradient matrix G of the prev-frame window is computed once (from scharr_3x3
+// gradients), and then 'num_iterations' Newton-Raphson steps refine the displacement
+// using the temporal difference against the next frame.  The result is propagated to the
+// next (finer) level as 2 * (guess + displacement).
+//
+// All the per-point stages are computed at root and parallelized across points, so a whole
+// batch of features is tracked by a single realize() call.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d0/d0c/group__group__vision__function__opticalflowpyrlk.html
+Halide::Func optical_flow_pyr_lk(Halide::Func prev, Halide::Func next,
+                                 Halide::Expr width, Halide::Expr height,
+                                 Halide::Func points, int levels,
+                                 int window_size, int num_iterations) {
+    Halide::Var x,y,u,v,p,c;
+    Halide::Func prev_f("prev_f"), next_f("next_f");
+    prev_f(x,y) = Halide::cast<float>(prev(x,y));
+    next_f(x,y) = Halide::cast<float>(next(x,y));
+
+    std::vector<Halide::Func> prev_pyr = gaussian_pyramid(prev_f, width, height, levels);
+    std::vector<Halide::Func> next_pyr = gaussian_pyramid(next_f, width, height, levels);
+
+    const int half = window_size / 2;
+    Halide::RDom r(-half, window_size, -half, window_size);
+    // Determinants below this are treated as a textureless (untrackable) window
+    const float min_det = 1e-6f;
+
+    // The initial guess at the coarsest level is zero
+    Halide::Func guess("lk_guess");
+    guess(p) = Halide::Tuple(0.0f, 0.0f);
+
+    for (int l=levels-1; l>=0; l--) {
+        Halide::Expr w = pyramid_extent(width, l);
+        Halide::Expr h = pyramid_extent(height, l);
+        const std::string level = std::to_string(l);
+
+        Halide::Func I("lk_prev_" + level), J("lk_next_" + level);
+        I(x,y) = prev_pyr[l](clamp(x, 0, w-1), clamp(y, 0, h-1));
+        J(x,y) = next_pyr[l](clamp(x, 0, w-1), clamp(y, 0, h-1));
+        I.compute_root().parallel(y).vectorize(x, 8);
+        J.compute_root().parallel(y).vectorize(x, 8);
+        if (l > 0) {
+            prev_pyr[l].compute_root().parallel(y).vectorize(x, 8);
+            next_pyr[l].compute_root().parallel(y).vectorize(x, 8);
+        }
+
+        // Scharr gradients, normalized so that they approximate the derivative
+        std::pair<Halide::Func, Halide::Func> grad = scharr_3x3(I, true);
+        Halide::Func Ix("lk_ix_" + level), Iy("lk_iy_" + level);
+        Ix(x,y) = grad.first(x,y) / 32.0f;
+        Iy(x,y) = grad.second(x,y) / 32.0f;
+        Ix.compute_root().parallel(y).vectorize(x, 8);
+        Iy.compute_root().parallel(y).vectorize(x, 8);
+
+        // Location of each feature at this level
+        const float scale = 1.0f / (1 << l);
+        Halide::Expr px = points(p, 0) * scale;
+        Halide::Expr py = points(p, 1) * scale;
+
+        // The prev-frame window (intensity and gradients) does not change between
+        // iterations, so it is sampled once per level
+        Halide::Func patch("lk_patch_" + level);
+        patch(u,v,p) = Halide::Tuple(bilinear_sample(I,  px + u, py + v),
+                                     bilinear_sample(Ix, px + u, py + v),
+                                     bilinear_sample(Iy, px + u, py + v));
+        patch.compute_root().parallel(p);
+
+        // Spatial gradient matrix G = [gxx gxy; gxy gyy]
+        Halide::Func G("lk_G_" + level);
+        Halide::Expr gx = patch(r.x, r.y, p)[1];
+        Halide::Expr gy = patch(r.x, r.y, p)[2];
+        G(p) = Halide::Tuple(0.0f, 0.0f, 0.0f);
+        G(p) = Halide::Tuple(G(p)[0] + gx * gx, G(p)[1] + gx * gy, G(p)[2] + gy * gy);
+        G.compute_root().parallel(p);
+        G.update(0).parallel(p);
+
+        Halide::Expr det = G(p)[0] * G(p)[2] - G(p)[1] * G(p)[1];
+        Halide::Expr trackable = Halide::abs(det) > min_det;
+
+        Halide::Func d("lk_d_" + level + "_0");
+        d(p) = Halide::Tuple(0.0f, 0.0f);
+        for (int k=0; k<num_iterations; k++) {
+            const std::string iter = level + "_" + std::to_string(k+1);
+            Halide::Expr dx = d(p)[0], dy = d(p)[1];
+            Halide::Expr nx = px + guess(p)[0] + dx;
+            Halide::Expr ny = py + guess(p)[1] + dy;
+
+            // Image mismatch vector b
+            Halide::Func b("lk_b_" + iter);
+            Halide::Expr it = patch(r.x, r.y, p)[0] - bilinear_sample(J, nx + r.x, ny + r.y);
+            b(p) = Halide::Tuple(0.0f, 0.0f);
+            b(p) = Halide::Tuple(b(p)[0] + it * gx, b(p)[1] + it * gy);
+            b.compute_root().parallel(p);
+            b.update(0).parallel(p);
+
+            // Newton-Raphson step: d += G^-1 * b
+            Halide::Expr vx = (G(p)[2] * b(p)[0] - G(p)[1] * b(p)[1]) / det;
+            Halide::Expr vy = (G(p)[0] * b(p)[1] - G(p)[1] * b(p)[0]) / det;
+            Halide::Func d_next("lk_d_" + iter);
+            d_next(p) = Halide::Tuple(select(trackable, dx + vx, dx),
+                                      select(trackable, dy + vy, dy));
+            d_next.compute_root().parallel(p);
+            d = d_next;
+        }
+
+        // Propagate to the next (finer) level
+        Halide::Func next_guess("lk_guess_" + level);
+        if (l > 0)
+            next_guess(p) = Halide::Tuple(2.0f * (guess(p)[0] + d(p)[0]), 2.0f * (guess(p)[1] + d(p)[1]));
+        else
+            next_guess(p) = Halide::Tuple(guess(p)[0] + d(p)[0], guess(p)[1] + d(p)[1]);
+        next_guess.compute_root().parallel(p);
+        guess = next_guess;
+    }
+
+    Halide::Func tracked("optical_flow_pyr_lk");
+    tracked(p,c) = points(p,c) + select(c == 0, guess(p)[0], guess(p)[1]);
+    return tracked;
+}
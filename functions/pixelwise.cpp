@@ -0,0 +1,137 @@
+#include "excursions.h"
+
+//
+// Pixelwise arithmetic.
+// Every PixelExpr is defined over the same (named) pixel variables, so any number of
+// operations can be chained and then turned into a single Func by to_func().
+//
+
+static Halide::Var pixel_x("pixel_x"), pixel_y("pixel_y"), pixel_c("pixel_c");
+
+// A type wide enough to hold the exact result of adding/subtracting two values of type t
+static Halide::Type widen(Halide::Type t) {
+    if (t.is_float())
+        return t;
+    return t.bits < 32 ? Halide::Int(32) : Halide::Int(64);
+}
+
+// Convert a (wide) value to type t, either saturating or wrapping around on overflow
+static Halide::Expr narrow(Halide::Expr value, Halide::Type t, convert_policy policy) {
+    if (policy == CONVERT_POLICY_SATURATE && !t.is_float()) {
+        Halide::Type wt = value.type();
+        value = clamp(value, Halide::cast(wt, t.min()), Halide::cast(wt, t.max()));
+    }
+    return Halide::cast(t, value);
+}
+
+PixelExpr pixel(Halide::Func image, bool grayscale) {
+    if (grayscale)
+        return PixelExpr(image(pixel_x, pixel_y));
+    return PixelExpr(image(pixel_x, pixel_y, pixel_c));
+}
+
+Halide::Func to_func(const PixelExpr &e, bool grayscale, const std::string &name) {
+    Halide::Func f(name);
+    if (grayscale)
+        f(pixel_x, pixel_y) = e.expr();
+    else
+        f(pixel_x, pixel_y, pixel_c) = e.expr();
+    return f;
+}
+
+PixelExpr convert_depth(const PixelExpr &a, Halide::Type t, convert_policy policy) {
+    Halide::Type wt = a.type().is_float() ? a.type() : widen(t.bits > a.type().bits ? t : a.type());
+    return PixelExpr(narrow(Halide::cast(wt, a.expr()), t, policy));
+}
+
+// Per OpenVX
+// https://www.khronos.org/registry/vx/specs/1.0/html/d2/d7e/group__group__vision__function__add.html
+PixelExpr add(const PixelExpr &a, const PixelExpr &b, convert_policy policy) {
+    Halide::Type wt = widen(a.type());
+    return PixelExpr(narrow(Halide::cast(wt, a.expr()) + Halide::cast(wt, b.expr()), a.type(), policy));
+}
+
+// Per OpenVX
+// https://www.khronos.org/registry/vx/specs/1.0/html/d9/dd1/group__group__vision__function__sub.html
+PixelExpr subtract(const PixelExpr &a, const PixelExpr &b, convert_policy policy) {
+    Halide::Type wt = widen(a.type());
+    return PixelExpr(narrow(Halide::cast(wt, a.expr()) - Halide::cast(wt, b.expr()), a.type(), policy));
+}
+
+// Per OpenVX
+// |a - b|, saturated to the type of a
+// https://www.khronos.org/registry/vx/specs/1.0/html/d6/dbb/group__group__vision__function__absdiff.html
+PixelExpr abs_diff(const PixelExpr &a, const PixelExpr &b) {
+    Halide::Type wt = widen(a.type());
+    Halide::Expr wa = Halide::cast(wt, a.expr()), wb = Halide::cast(wt, b.expr());
+    return PixelExpr(narrow(select(wa > wb, wa - wb, wb - wa), a.type(), CONVERT_POLICY_SATURATE));
+}
+
+// Per OpenVX
+// a * b * scale, converted to the type of a
+// Products of 8-bit values are exact in a float; wider types are multiplied in double, where
+// 16-bit products are exact.  Converting an out-of-range float to an integer is undefined,
+// so the product is saturated while it is still a float, or clamped to a wide integer type
+// that it then wraps from.
+// https://www.khronos.org/registry/vx/specs/1.0/html/d7/d44/group__group__vision__function__mult.html
+PixelExpr multiply(const PixelExpr &a, const PixelExpr &b, float scale,
+                   convert_policy policy, rounding_policy rounding) {
+    Halide::Type t = a.type();
+    Halide::Type ft = t.is_float() ? t : t.bits <= 8 ? Halide::Float(32) : Halide::Float(64);
+    Halide::Expr product = Halide::cast(ft, a.expr()) * Halide::cast(ft, b.expr()) * Halide::cast(ft, scale);
+    if (t.is_float())
+        return PixelExpr(product);
+    if (rounding == ROUND_TO_NEAREST_EVEN)
+        product = Halide::round(product);
+    // Casting a float to an integer type rounds towards zero
+    if (policy == CONVERT_POLICY_WRAP) {
+        Halide::Type wt = t.bits <= 8 ? Halide::Int(32) : Halide::Int(64);
+        Halide::Expr limit = Halide::cast(ft, t.bits <= 8 ? (float)(1 << 30) : (float)(1LL << 62));
+        product = Halide::cast(wt, clamp(product, -limit, limit));
+    }
+    return PixelExpr(narrow(product, t, policy));
+}
+
+// Per OpenVX
+// Binary threshold: true_value where a > threshold, false_value elsewhere
+// https://www.khronos.org/registry/vx/specs/1.0/html/d3/d1e/group__group__vision__function__threshold.html
+PixelExpr threshold_binary(const PixelExpr &a, Halide::Expr threshold,
+                           Halide::Expr true_value, Halide::Expr false_value) {
+    Halide::Type t = a.type();
+    return PixelExpr(select(a.expr() > Halide::cast(t, threshold),
+                            Halide::cast(t, true_value), Halide::cast(t, false_value)));
+}
+
+// Per OpenVX
+// Range threshold: false_value where a > upper or a < lower, true_value elsewhere
+PixelExpr threshold_range(const PixelExpr &a, Halide::Expr lower, Halide::Expr upper,
+                          Halide::Expr true_value, Halide::Expr false_value) {
+    Halide::Type t = a.type();
+    Halide::Expr outside = a.expr() > Halide::cast(t, upper) || a.expr() < Halide::cast(t, lower);
+    return PixelExpr(select(outside, Halide::cast(t, false_value), Halide::cast(t, true_value)));
+}
+
+// Per OpenVX
+// https://www.khronos.org/registry/vx/specs/1.0/html/d4/d5a/group__group__vision__function__and.html
+PixelExpr bitwise_and(const PixelExpr &a, const PixelExpr &b) {
+    return PixelExpr(a.expr() & b.expr());
+}
+
+PixelExpr bitwise_or(const PixelExpr &a, const PixelExpr &b) {
+    return PixelExpr(a.expr() | b.expr());
+}
+
+PixelExpr bitwise_xor(const PixelExpr &a, const PixelExpr &b) {
+    return PixelExpr(a.expr() ^ b.expr());
+}
+
+PixelExpr bitwise_not(const PixelExpr &a) {
+    return PixelExpr(~a.expr());
+}
+
+PixelExpr operator+(const PixelExpr &a, const PixelExpr &b) { return add(a, b); }
+PixelExpr operator-(const PixelExpr &a, const PixelExpr &b) { return subtract(a, b); }
+PixelExpr operator&(const PixelExpr &a, const PixelExpr &b) { return bitwise_and(a, b); }
+PixelExpr operator|(const PixelExpr &a, const PixelExpr &b) { return bitwise_or(a, b); }
+PixelExpr operator^(const PixelExpr &a, const PixelExpr &b) { return bitwise_xor(a, b); }
+PixelExpr operator~(const PixelExpr &a) { return bitwise_not(a); }
@@ -0,0 +1,107 @@
+#ifndef __GRAPH_H
+#define __GRAPH_H
+
+#include "Halide.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// An OpenVX-style graph of Excursions functions, with verify-once, execute-many semantics.
+// For the OpenVX graph model, see: https://www.khronos.org/registry/vx/specs/1.0/html/d3/dc5/group__group__graph.html
+//
+// Nodes are Excursions functions and edges are images.  An image is either a graph input
+// (a buffer supplied by the caller on every execution), a virtual image (an intermediate
+// which the caller never sees) or a graph output.
+//
+// verify() checks the graph, chooses where each node is computed (inlined into its consumer,
+// computed per row inside the output loop nest with a sliding window, or computed at root),
+// and JIT-compiles the whole graph once, as a single pipeline which produces all outputs.
+// execute() runs the compiled pipeline on the buffers currently bound to the inputs and
+// outputs.  Binding new buffers does not trigger any recompilation.
+//
+//     Graph g;
+//     Graph::image_id in = g.input(Halide::UInt(8), 3);
+//     Graph::image_id blurred = g.virtual_image();
+//     Graph::image_id out = g.output();
+//     g.add_node("blur", [](const std::vector<Halide::Func> &in) { return box_3x3(in[0]); },
+//                std::vector<Graph::image_id>(1, in), blurred, NODE_STENCIL);
+//     g.add_node("invert", ..., std::vector<Graph::image_id>(1, blurred), out, NODE_POINTWISE);
+//     g.verify();
+//     for (each frame) {
+//         g.bind(in, frame);
+//         g.bind(out, result);
+//         g.execute();
+//     }
+//
+// Graph inputs are presented to the nodes with their borders replicated (clamped), so
+// stencil nodes may read outside the input buffer.  All outputs must have the same
+// dimensions and extents, as they are computed in the same loop nest.
+//
+
+// How an output pixel of a node depends on the pixels of its inputs
+enum node_kind {
+    NODE_POINTWISE,     // only on the input pixels at the same location
+    NODE_STENCIL,       // on a small neighborhood around the same location
+    NODE_GLOBAL         // on arbitrary locations (warps, scaling, reductions, ...)
+};
+
+class Graph {
+public:
+    typedef size_t image_id;
+    typedef std::function<Halide::Func(const std::vector<Halide::Func> &)> node_function;
+
+    Graph(int strip_height = 32) : strip_height(strip_height), verified(false) {}
+
+    image_id input(Halide::Type t, int dimensions, const std::string &name = "");
+    image_id virtual_image(const std::string &name = "");
+    image_id output(const std::string &name = "");
+    void add_node(const std::string &name, node_function fn, const std::vector<image_id> &inputs,
+                  image_id output, node_kind kind = NODE_STENCIL);
+
+    // Validate the graph, schedule it and compile it.  Returns false (and prints the
+    // reason) if the graph is malformed.
+    bool verify(const Halide::Target &target = Halide::get_jit_target_from_environment());
+    // Bind a buffer to an input or output image
+    void bind(image_id image, Halide::Buffer buffer);
+    // Run the compiled graph
+    void execute();
+
+    // The function computing an image (valid after verify), for inspection
+    Halide::Func func(image_id image) const;
+
+private:
+    enum image_kind { IMAGE_INPUT, IMAGE_VIRTUAL, IMAGE_OUTPUT };
+
+    struct image_desc {
+        std::string name;
+        image_kind kind;
+        Halide::ImageParam param;   // inputs only
+        Halide::Buffer buffer;      // inputs and outputs
+        Halide::Func func;
+        int producer;               // index of the producing node, -1 for inputs
+        std::vector<size_t> consumers;
+    };
+
+    struct node_desc {
+        std::string name;
+        node_function fn;
+        std::vector<image_id> inputs;
+        image_id output;
+        node_kind kind;
+    };
+
+    image_id add_image(const std::string &name, image_kind kind);
+    bool topological_order(std::vector<size_t> &order) const;
+    void schedule();
+
+    std::vector<image_desc> images;
+    std::vector<node_desc> nodes;
+    std::vector<image_id> outputs;
+    Halide::Func pipeline;
+    Halide::Target target;
+    int strip_height;
+    bool verified;
+};
+
+#endif // __GRAPH_H
@@ -12,6 +12,20 @@ int canny_example(int argc, const char **argv);
 int cv_example(int argc, const char **argv);
 int scale_example(int argc, const char **argv);
 int sched_example(int argc, const char **argv);
+int optical_flow_example(int argc, const char **argv);
+int warp_example(int argc, const char **argv);
+int color_convert_example(int argc, const char **argv);
+int channels_example(int argc, const char **argv);
+int pixelwise_example(int argc, const char **argv);
+int graph_example(int argc, const char **argv);
+int stream_example(int argc, const char **argv);
+int mapped_io_example(int argc, const char **argv);
+int buffer_pool_example(int argc, const char **argv);
+int perf_counters_example(int argc, const char **argv);
+int batch_example(int argc, const char **argv);
+int roi_example(int argc, const char **argv);
+int tiles_example(int argc, const char **argv);
+int thread_pool_example(int argc, const char **argv);
 
 Halide::Func rotate(Halide::Func input, int height) {
     Halide::Func rot;
@@ -38,6 +52,20 @@ example examples[] = {
     {"cv", cv_example, 1, {"images/bikesgray-wikipedia.png"} },
     {"scale", scale_example, 1, {"images/rgb.png"} },
     {"sched", sched_example, 1, {"images/rgb.png"} },
+    {"optical_flow", optical_flow_example, 0, {} },
+    {"warp", warp_example, 1, {"images/rgb.png"} },
+    {"yuv", color_convert_example, 1, {"images/rgb.png"} },
+    {"channels", channels_example, 0, {} },
+    {"pixelwise", pixelwise_example, 0, {} },
+    {"graph", graph_example, 1, {"images/rgb.png"} },
+    {"stream", stream_example, 0, {} },
+    {"mmap", mapped_io_example, 0, {} },
+    {"pool", buffer_pool_example, 0, {} },
+    {"perf", perf_counters_example, 0, {} },
+    {"batch", batch_example, 0, {} },
+    {"roi", roi_example, 0, {} },
+    {"tiles", tiles_example, 0, {} },
+    {"threads", thread_pool_example, 0, {} },
 };
 
 
@@ -0,0 +1,81 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/image_batch.h"
+
+// A clamped 3x3 Gaussian blur of uint8 images of geometry Dims (3 for one image, 4 for a batch)
+template <int Dims>
+static Halide::Func thumbnail_blur(Halide::ImageParam input, const Scheduler &s) {
+    image_coords<Dims> p;
+    Halide::Func clamped("clamped"), blurred("blurred");
+    std::vector<Halide::Expr> at = p.at(0, 0);
+    at[0] = clamp(p.x, 0, input.width()-1);
+    at[1] = clamp(p.y, 0, input.height()-1);
+    clamped(p.args()) = Halide::cast<int16_t>(input(at));
+    Halide::Func gaussian = gaussian_3x3<Dims>(clamped);
+    blurred(p.args()) = Halide::cast<uint8_t>(gaussian(p.at(0, 0)));
+    s.schedule(blurred, p.x, p.y);
+    return blurred;
+}
+
+// Throughput of blurring many small images, one realize per image and one realize per batch
+int batch_example(int argc, const char **argv) {
+    const int sizes[] = { 64, 128, 256 };
+    const int batch_sizes[] = { 1, 4, 16, 64, 256 };
+    const int total = 256, passes = 5;
+    const size_t num_batch_sizes = sizeof(batch_sizes)/sizeof(batch_sizes[0]);
+
+    printf("%d images per pass, images/s\n", total);
+    printf("%-9s %10s", "size", "per-image");
+    for (size_t b=0; b<num_batch_sizes; b++)
+        printf("  batch %-4d", batch_sizes[b]);
+    printf("\n");
+
+    for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+        const int size = sizes[s];
+        excursions::image_batch<uint8_t> in(size, size, 3, total), out(size, size, 3, total);
+        for (int n=0; n<total; n++) {
+            Halide::Image<uint8_t> image = in.image(n);
+            excursions::randomize(image);
+        }
+        double dev = 0;
+
+        // One image per realize, parallel over its rows; the fast path reads the input with
+        // dense vector loads when its x stride is 1
+        Halide::ImageParam image(Halide::UInt(8), 3);
+        Halide::Func single = thumbnail_blur<3>(image, SpecializeSched(16, std::vector<Halide::OutputImageParam>(1, image)));
+        single.compile_jit();
+        timings single_time;
+        for (int pass=0; pass<passes; pass++) {
+            interval iv(single_time);
+            for (int n=0; n<total; n++) {
+                image.set(in.image(n));
+                single.realize(out.image(n));
+            }
+        }
+        printf("%4dx%-4d %10.0f", size, size, total * 1000.0 / single_time.mean(dev));
+
+        // 'batch' images per realize, parallel over the rows of the whole batch
+        Halide::ImageParam batch(Halide::UInt(8), 4);
+        Halide::Func batched = thumbnail_blur<4>(batch, BatchSched(16));
+        batched.compile_jit();
+        for (size_t b=0; b<num_batch_sizes; b++) {
+            const int batch_size = batch_sizes[b];
+            timings batch_time;
+            for (int pass=0; pass<passes; pass++) {
+                interval iv(batch_time);
+                for (int n=0; n<total; n+=batch_size) {
+                    batch.set(in.buffer(n, batch_size));
+                    batched.realize(out.buffer(n, batch_size));
+                }
+            }
+            printf("  %10.0f", total * 1000.0 / batch_time.mean(dev));
+        }
+        printf("\n");
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
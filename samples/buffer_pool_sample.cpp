@@ -0,0 +1,103 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/buffer_pool.h"
+#include <atomic>
+#include <new>
+
+// Counts the heap allocations of the whole program (this replaces the global operator new),
+// so that the steady state of the pool can be checked for allocations other than pixels
+static std::atomic<unsigned long long> heap_allocations(0);
+
+void *operator new(size_t size) {
+    heap_allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// A pipeline with two compute_root intermediates, which are allocated on every realize
+static Halide::Func separable_blur(Halide::ImageParam input) {
+    Halide::Var x,y,c;
+    Halide::Func padded("padded"), blur_x("blur_x"), blur_y("blur_y"), output("output");
+    padded(x,y,c) = Halide::cast<uint16_t>(input(clamp(x, 0, input.width()-1), clamp(y, 0, input.height()-1), c));
+    blur_x(x,y,c) = padded(x-1,y,c) + 2 * padded(x,y,c) + padded(x+1,y,c);
+    blur_y(x,y,c) = blur_x(x,y-1,c) + 2 * blur_x(x,y,c) + blur_x(x,y+1,c);
+    output(x,y,c) = Halide::cast<uint8_t>(blur_y(x,y,c) >> 4);
+
+    blur_x.compute_root().vectorize(x, 16).parallel(y);
+    blur_y.compute_root().vectorize(x, 16).parallel(y);
+    output.vectorize(x, 16).parallel(y);
+    return output;
+}
+
+// Process a stream of frames, allocating a new output image per frame as the other samples do,
+// with the default allocators and with the buffer pool
+int buffer_pool_example(int argc, const char **argv) {
+    const int width = 1920, height = 1080, frames = 50;
+    Halide::Image<uint8_t> input(width, height, 3);
+    excursions::randomize(input);
+
+    Halide::ImageParam in(Halide::UInt(8), 3);
+    in.set(input);
+
+    Halide::Func plain = separable_blur(in);
+    plain.compile_jit();
+    timings plain_time;
+    for (int i=0; i<frames; i++) {
+        interval iv(plain_time);
+        Halide::Image<uint8_t> output(width, height, 3);
+        plain.realize(output);
+    }
+
+    Halide::Func pooled = separable_blur(in);
+    excursions::use_buffer_pool(pooled);
+    pooled.compile_jit();
+    excursions::buffer_pool &pool = excursions::buffer_pool::global();
+
+    // The first frame fills the pool
+    {
+        excursions::pooled_image<uint8_t> output(width, height, 3);
+        pooled.realize(output.buffer());
+    }
+    pool.get_stats().print("first frame");
+    pool.reset_stats();
+
+    timings pooled_time;
+    unsigned long long image_allocations = 0, realize_allocations = 0;
+    for (int i=0; i<frames; i++) {
+        interval iv(pooled_time);
+        unsigned long long before = heap_allocations;
+        {
+            excursions::pooled_image<uint8_t> output(width, height, 3);
+            Halide::Buffer buffer = output.buffer();
+            unsigned long long realize_start = heap_allocations;
+            pooled.realize(buffer);
+            realize_allocations += heap_allocations - realize_start;
+        }
+        image_allocations += heap_allocations - before;
+    }
+    image_allocations -= realize_allocations;
+    excursions::buffer_pool::stats steady = pool.get_stats();
+    steady.print("steady state");
+    printf("steady state: %.1f heap allocations per frame in realize(), %llu for images and intermediates\n",
+           (double)realize_allocations / frames, image_allocations);
+
+    double dev = 0;
+    printf("%dx%d, %d frames: default allocators %.2f ms/frame, buffer pool %.2f ms/frame\n",
+           width, height, frames, plain_time.mean(dev), pooled_time.mean(dev));
+    if (steady.system_allocs != 0)
+        printf("unexpected: %llu buffers allocated in steady state\n", (unsigned long long)steady.system_allocs);
+    if (image_allocations != 0)
+        printf("unexpected: %llu heap allocations for pooled images in steady state\n", image_allocations);
+
+    printf("%s DONE\n", __func__);
+    return steady.system_allocs == 0 && image_allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
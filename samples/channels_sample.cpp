@@ -0,0 +1,91 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+static double time_realize(Halide::Func f, Halide::Buffer output) {
+    f.compile_jit();
+    f.realize(output);
+    timings t;
+    for (int i=0; i<20; i++) {
+        interval iv(t);
+        f.realize(output);
+    }
+    double dev = 0;
+    return t.mean(dev);
+}
+
+// Compare ChannelExtract/ChannelCombine on interleaved images against the naive
+// per-pixel (x,y,c) lambdas
+int channels_example(int argc, const char **argv) {
+    const int width = 1920, height = 1080;
+    const int channel_counts[] = { 3, 4 };
+    Halide::Var x,y,c;
+
+    for (size_t n=0; n<sizeof(channel_counts)/sizeof(channel_counts[0]); n++) {
+        const int channels = channel_counts[n];
+
+        Halide::Image<uint8_t> storage, combined_storage;
+        Halide::Buffer interleaved = excursions::interleaved_buffer(storage, width, height, channels);
+        Halide::Buffer combined = excursions::interleaved_buffer(combined_storage, width, height, channels);
+        excursions::randomize(storage);
+        Halide::Image<uint8_t> plane(width, height);
+        std::vector<Halide::Image<uint8_t> > planes;
+        for (int i=0; i<channels; i++) {
+            planes.push_back(Halide::Image<uint8_t>(width, height));
+            excursions::randomize(planes.back());
+        }
+
+        // ChannelExtract
+        // The naive version makes no assumption about the layout of the input
+        Halide::ImageParam input(Halide::UInt(8), 3);
+        input.set(interleaved);
+        input.set_stride(0, Halide::Expr());
+        Halide::Func naive_extract = Halide::lambda(x, y, input(x,y,1));
+
+        Halide::ImageParam input_interleaved(Halide::UInt(8), 3);
+        input_interleaved.set(interleaved);
+        set_interleaved_layout(input_interleaved, channels);
+        Halide::Func in;
+        in(x,y,c) = input_interleaved(x,y,c);
+        Halide::Func extract = channel_extract(in, 1);
+        extract.vectorize(extract.args()[0], 16).parallel(extract.args()[1]);
+
+        Halide::Image<uint8_t> naive_plane(width, height);
+        double naive_ms = time_realize(naive_extract, naive_plane);
+        double vectorized_ms = time_realize(extract, plane);
+        printf("%dx%dx%d extract: naive %7.2f ms  vectorized %7.2f ms  (%s)\n", width, height, channels,
+               naive_ms, vectorized_ms, excursions::compare_images(plane, naive_plane) ? "identical" : "MISMATCH");
+
+        // ChannelCombine
+        Halide::Func p0, p1, p2, p3;
+        p0(x,y) = planes[0](x,y);
+        p1(x,y) = planes[1](x,y);
+        p2(x,y) = planes[2](x,y);
+        if (channels == 4)
+            p3(x,y) = planes[3](x,y);
+
+        Halide::Func naive_combine = Halide::lambda(x, y, c,
+            select(c == 0, p0(x,y), select(c == 1, p1(x,y), channels == 4 ? select(c == 2, p2(x,y), p3(x,y)) : Halide::Expr(p2(x,y)))));
+        naive_combine.output_buffer().set_stride(0, Halide::Expr());
+
+        Halide::Func combine = channel_combine(p0, p1, p2, p3);
+        schedule_interleaved(combine, channels);
+
+        Halide::Image<uint8_t> naive_storage;
+        Halide::Buffer naive_combined = excursions::interleaved_buffer(naive_storage, width, height, channels);
+        naive_ms = time_realize(naive_combine, naive_combined);
+        vectorized_ms = time_realize(combine, combined);
+        printf("%dx%dx%d combine: naive %7.2f ms  vectorized %7.2f ms  (%s)\n", width, height, channels,
+               naive_ms, vectorized_ms,
+               excursions::compare_images(Halide::Image<uint8_t>(combined), Halide::Image<uint8_t>(naive_combined))
+                   ? "identical" : "MISMATCH");
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+class ColorConvertSched : public Scheduler {
+public:
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        Halide::Var yi;
+        f.split(y, y, yi, 8).parallel(y).vectorize(x, 16);
+    }
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {}
+};
+
+static const char *format_name(color_format format) {
+    const char *names[] = { "RGB", "RGBX", "NV12", "NV21", "IYUV", "YUV4" };
+    return names[format];
+}
+
+// Allocate the buffers of a width x height image in the given format (see color_format)
+static std::vector<Halide::Image<uint8_t> > allocate_planes(color_format format, int width, int height) {
+    std::vector<Halide::Image<uint8_t> > planes;
+    switch (format) {
+    case FORMAT_RGB:
+        planes.push_back(Halide::Image<uint8_t>(width, height, 3));
+        break;
+    case FORMAT_RGBX:
+        planes.push_back(Halide::Image<uint8_t>(width, height, 4));
+        break;
+    case FORMAT_NV12:
+    case FORMAT_NV21:
+        planes.push_back(Halide::Image<uint8_t>(width, height));
+        planes.push_back(Halide::Image<uint8_t>(2, width/2, height/2));
+        break;
+    case FORMAT_IYUV:
+        planes.push_back(Halide::Image<uint8_t>(width, height));
+        planes.push_back(Halide::Image<uint8_t>(width/2, height/2));
+        planes.push_back(Halide::Image<uint8_t>(width/2, height/2));
+        break;
+    case FORMAT_YUV4:
+        planes.push_back(Halide::Image<uint8_t>(width, height));
+        planes.push_back(Halide::Image<uint8_t>(width, height));
+        planes.push_back(Halide::Image<uint8_t>(width, height));
+        break;
+    }
+    return planes;
+}
+
+// Wrap image buffers as functions, clamped to the extents of each plane
+static image_planes as_funcs(std::vector<Halide::Image<uint8_t> > &planes) {
+    image_planes funcs;
+    Halide::Var x,y,z;
+    for (size_t i=0; i<planes.size(); i++) {
+        Halide::Image<uint8_t> p = planes[i];
+        Halide::Func f;
+        if (p.dimensions() == 2)
+            f(x,y) = p(clamp(x, 0, p.width()-1), clamp(y, 0, p.height()-1));
+        else
+            f(x,y,z) = p(clamp(x, 0, p.extent(0)-1), clamp(y, 0, p.extent(1)-1), clamp(z, 0, p.extent(2)-1));
+        funcs.push_back(f);
+    }
+    return funcs;
+}
+
+static void realize_planes(image_planes &funcs, std::vector<Halide::Image<uint8_t> > &planes) {
+    for (size_t i=0; i<funcs.size(); i++)
+        funcs[i].realize(planes[i]);
+}
+
+int color_convert_example(int argc, const char **argv) {
+    // Round trip: RGB -> NV12 -> RGB
+    Halide::Image<uint8_t> input = load<uint8_t>(argv[0]);
+    std::vector<Halide::Image<uint8_t> > rgb_planes(1, input);
+    std::vector<Halide::Image<uint8_t> > nv12 = allocate_planes(FORMAT_NV12, input.width(), input.height());
+    std::vector<Halide::Image<uint8_t> > rgb_out = allocate_planes(FORMAT_RGB, input.width(), input.height());
+    image_planes to_nv12 = color_convert(as_funcs(rgb_planes), FORMAT_RGB, FORMAT_NV12);
+    realize_planes(to_nv12, nv12);
+    image_planes to_rgb = color_convert(as_funcs(nv12), FORMAT_NV12, FORMAT_RGB);
+    realize_planes(to_rgb, rgb_out);
+    save(nv12[0], "output/nv12_y.png");
+    save(rgb_out[0], "output/nv12_rgb.png");
+
+    // Throughput at 1080p and 4K
+    const int frame_sizes[][2] = { {1920, 1080}, {3840, 2160} };
+    const color_format conversions[][2] = {
+        {FORMAT_NV12, FORMAT_RGB},  {FORMAT_NV12, FORMAT_RGBX}, {FORMAT_NV21, FORMAT_RGB},
+        {FORMAT_IYUV, FORMAT_RGB},  {FORMAT_YUV4, FORMAT_RGB},  {FORMAT_NV12, FORMAT_IYUV},
+        {FORMAT_RGB,  FORMAT_NV12}, {FORMAT_RGB,  FORMAT_IYUV}, {FORMAT_RGBX, FORMAT_YUV4},
+    };
+
+    for (size_t s=0; s<sizeof(frame_sizes)/sizeof(frame_sizes[0]); s++) {
+        const int width = frame_sizes[s][0], height = frame_sizes[s][1];
+        for (size_t i=0; i<sizeof(conversions)/sizeof(conversions[0]); i++) {
+            color_format from = conversions[i][0], to = conversions[i][1];
+            std::vector<Halide::Image<uint8_t> > src = allocate_planes(from, width, height);
+            std::vector<Halide::Image<uint8_t> > dst = allocate_planes(to, width, height);
+            for (size_t p=0; p<src.size(); p++)
+                excursions::randomize(src[p]);
+
+            image_planes convert = color_convert(as_funcs(src), from, to, ColorConvertSched());
+            for (size_t p=0; p<convert.size(); p++)
+                convert[p].compile_jit();
+            realize_planes(convert, dst);
+
+            timings t;
+            for (int n=0; n<20; n++) {
+                interval iv(t);
+                realize_planes(convert, dst);
+            }
+            double dev = 0;
+            double ms = t.mean(dev);
+            printf("%4dx%-4d %4s -> %-4s: %7.2f ms  %7.1f fps\n",
+                   width, height, format_name(from), format_name(to), ms, 1000.0 / ms);
+        }
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#ifndef __FUNCTION_TABLE_H
+#define __FUNCTION_TABLE_H
+
+//
+// A table of the excursions functions which map an image to an image of the same size,
+// each wrapped to take a clamped uint8 input and to produce a uint8 output of the same
+// dimensions.  Used by the benchmarking samples to run every function the same way.
+// Functions that compose several excursions functions (color_convert, channel_extract and
+// channel_combine, pixelwise) are benchmarked as a round trip back to the input format.
+//
+// Not in the table:
+//  - bilinear_scale, nn_scale, gaussian_pyramid: the output size differs from the input's
+//  - optical_flow_pyr_lk: tracks a list of points, it does not produce an image
+//  - integral_image: its uint32 sums do not fit a uint8 output
+//  - scale, reflect_vert, invert: a stub, a mirror of a fixed column, and a function that
+//    realizes a reduction of its input when it is defined
+//  - rgb_extract_luma, grad_magnitude, grad_angle, grad_direction: covered by rgb2luma and
+//    by the gradient functions that use them
+//  - convolve: benchmarks/convolve_benchmark.cpp compares it with the functions it can replace
+//
+
+#include "Halide.h"
+#include "excursions.h"
+#include <vector>
+
+struct excursion_function {
+    const char *name;
+    bool grayscale;         // 2D grayscale input and output; otherwise 3 channels
+    bool size_dependent;    // make() bakes width and height into the definition, so a Func
+                            // made for one image size is wrong for any other
+    Halide::Func (*make)(Halide::Func input, int width, int height);
+};
+
+// Saturate any function to uint8
+inline Halide::Func saturate_uint8(Halide::Func f, const char *name) {
+    std::vector<Halide::Var> args = f.args();
+    std::vector<Halide::Expr> coords(args.begin(), args.end());
+    Halide::Func out(name);
+    out(args) = Halide::cast<uint8_t>(clamp(f(coords), 0, 255));
+    return out;
+}
+
+inline Halide::Func widen_int32(Halide::Func f) {
+    std::vector<Halide::Var> args = f.args();
+    std::vector<Halide::Expr> coords(args.begin(), args.end());
+    Halide::Func wide;
+    wide(args) = Halide::cast<int32_t>(f(coords));
+    return wide;
+}
+
+namespace function_table {
+
+inline Halide::Func gaussian_3x3_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3<3>(widen_int32(in)), "gaussian_3x3"); }
+inline Halide::Func gaussian_3x3_gray(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3<2>(widen_int32(in)), "gaussian_3x3_gray"); }
+inline Halide::Func gaussian_5x5_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_5x5<3>(in), "gaussian_5x5"); }
+inline Halide::Func gaussian_5x5_delta14_gray(Halide::Func in, int, int) { return saturate_uint8(gaussian_5x5_delta14(in, true), "gaussian_5x5_delta14"); }
+inline Halide::Func erode_3x3_rgb(Halide::Func in, int, int) { return saturate_uint8(erode_3x3(in), "erode_3x3"); }
+inline Halide::Func dilate_3x3_rgb(Halide::Func in, int, int) { return saturate_uint8(dilate_3x3(in), "dilate_3x3"); }
+inline Halide::Func box_3x3_rgb(Halide::Func in, int, int) { return saturate_uint8(box_3x3<3>(in), "box_3x3"); }
+inline Halide::Func box_3x3_gray(Halide::Func in, int, int) { return saturate_uint8(box_3x3<2>(in), "box_3x3_gray"); }
+inline Halide::Func luma_rgb(Halide::Func in, int, int) { return saturate_uint8(rgb2luma(in), "rgb2luma"); }
+inline Halide::Func unsharp_rgb(Halide::Func in, int, int) { return saturate_uint8(fast_unsharp_mask(in, 5.0f), "fast_unsharp_mask"); }
+inline Halide::Func unsharp_mask_rgb(Halide::Func in, int, int) {
+    return saturate_uint8(unsharp_mask(in, gaussian_3x3<3>(widen_int32(in)), 5.0f), "unsharp_mask");
+}
+
+// The alternative implementations of the 3x3 Gaussian
+inline Halide::Func gaussian_3x3_2_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3_2(widen_int32(in)), "gaussian_3x3_2"); }
+inline Halide::Func gaussian_3x3_3_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3_3(widen_int32(in)), "gaussian_3x3_3"); }
+inline Halide::Func gaussian_3x3_4_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3_4(widen_int32(in)), "gaussian_3x3_4"); }
+inline Halide::Func gaussian_3x3_5_rgb(Halide::Func in, int, int) { return saturate_uint8(gaussian_3x3_5(widen_int32(in)), "gaussian_3x3_5"); }
+
+// RGB to NV12 and back
+inline Halide::Func color_convert_rgb(Halide::Func in, int, int) {
+    image_planes nv12 = color_convert(image_planes(1, in), FORMAT_RGB, FORMAT_NV12);
+    return saturate_uint8(color_convert(nv12, FORMAT_NV12, FORMAT_RGB)[0], "color_convert");
+}
+
+// RGB to BGR
+inline Halide::Func channels_rgb(Halide::Func in, int, int) {
+    return saturate_uint8(channel_combine(channel_extract(in, 2), channel_extract(in, 1), channel_extract(in, 0)),
+                          "channel_combine");
+}
+
+// Motion mask of the image against itself shifted by one pixel: one fused stage
+inline Halide::Func pixelwise_rgb(Halide::Func in, int, int) {
+    Halide::Var x,y,c;
+    Halide::Func shifted;
+    shifted(x,y,c) = in(x+1,y,c);
+    return saturate_uint8(to_func(threshold_binary(abs_diff(pixel(in), pixel(shifted)) + pixel(in), 64)), "pixelwise");
+}
+
+inline Halide::Func sobel_gray(Halide::Func in, int, int) {
+    std::pair<Halide::Func, Halide::Func> g = sobel_3x3<2>(in);
+    return saturate_uint8(grad_magnitude(g.first, g.second), "sobel_3x3");
+}
+inline Halide::Func scharr_gray(Halide::Func in, int, int) {
+    std::pair<Halide::Func, Halide::Func> g = scharr_3x3(in, true);
+    return saturate_uint8(grad_magnitude(g.first, g.second), "scharr_3x3");
+}
+inline Halide::Func prewitt_gray(Halide::Func in, int, int) {
+    std::pair<Halide::Func, Halide::Func> g = prewitt_3x3(in, true);
+    return saturate_uint8(grad_magnitude(g.first, g.second), "prewitt_3x3");
+}
+inline Halide::Func canny_gray(Halide::Func in, int, int) { return saturate_uint8(canny_detector(in, true), "canny_detector"); }
+
+// 30 degree rotation around the center of the image
+inline Halide::Func warp_affine_rgb(Halide::Func in, int width, int height) {
+    const float theta = 30 * (float)M_PI / 180, cs = cosf(theta), sn = sinf(theta);
+    const float cx = width / 2.0f, cy = height / 2.0f;
+    const float m[6] = { cs, -sn, sn, cs, cx - cs * cx - sn * cy, cy + sn * cx - cs * cy };
+    return saturate_uint8(warp_affine(in, width, height, m), "warp_affine");
+}
+
+// The same rotation in fixed point
+inline Halide::Func warp_affine_fixed_rgb(Halide::Func in, int width, int height) {
+    const float theta = 30 * (float)M_PI / 180, cs = cosf(theta), sn = sinf(theta);
+    const float cx = width / 2.0f, cy = height / 2.0f;
+    const float m[6] = { cs, -sn, sn, cs, cx - cs * cx - sn * cy, cy + sn * cx - cs * cy };
+    return saturate_uint8(warp_affine_fixed(in, width, height, m), "warp_affine_fixed");
+}
+
+// Mild keystone
+inline Halide::Func warp_perspective_rgb(Halide::Func in, int width, int height) {
+    const float m[9] = { 1.0f, 0.0f, 0.0002f,
+                         0.1f, 1.0f, 0.0f,
+                         0.0f, 0.0f, 1.0f };
+    return saturate_uint8(warp_perspective(in, width, height, m), "warp_perspective");
+}
+
+} // namespace function_table
+
+inline const std::vector<excursion_function> &excursion_functions() {
+    static const excursion_function table[] = {
+        { "gaussian_3x3",         false, false, function_table::gaussian_3x3_rgb },
+        { "gaussian_3x3_gray",    true,  false, function_table::gaussian_3x3_gray },
+        { "gaussian_5x5",         false, false, function_table::gaussian_5x5_rgb },
+        { "gaussian_5x5_delta14", true,  false, function_table::gaussian_5x5_delta14_gray },
+        { "erode_3x3",            false, false, function_table::erode_3x3_rgb },
+        { "dilate_3x3",           false, false, function_table::dilate_3x3_rgb },
+        { "box_3x3",              false, false, function_table::box_3x3_rgb },
+        { "box_3x3_gray",         true,  false, function_table::box_3x3_gray },
+        { "rgb2luma",             false, false, function_table::luma_rgb },
+        { "fast_unsharp_mask",    false, false, function_table::unsharp_rgb },
+        { "sobel_3x3",            true,  false, function_table::sobel_gray },
+        { "scharr_3x3",           true,  false, function_table::scharr_gray },
+        { "prewitt_3x3",          true,  false, function_table::prewitt_gray },
+        { "canny_detector",       true,  false, function_table::canny_gray },
+        { "warp_affine",          false, true,  function_table::warp_affine_rgb },
+        { "warp_affine_fixed",    false, true,  function_table::warp_affine_fixed_rgb },
+        { "warp_perspective",     false, true,  function_table::warp_perspective_rgb },
+        { "unsharp_mask",         false, false, function_table::unsharp_mask_rgb },
+        { "gaussian_3x3_2",       false, false, function_table::gaussian_3x3_2_rgb },
+        { "gaussian_3x3_3",       false, false, function_table::gaussian_3x3_3_rgb },
+        { "gaussian_3x3_4",       false, false, function_table::gaussian_3x3_4_rgb },
+        { "gaussian_3x3_5",       false, false, function_table::gaussian_3x3_5_rgb },
+        { "color_convert",        false, false, function_table::color_convert_rgb },
+        { "channel_combine",      false, false, function_table::channels_rgb },
+        { "pixelwise",            false, false, function_table::pixelwise_rgb },
+    };
+    static const std::vector<excursion_function> functions(table, table + sizeof(table)/sizeof(table[0]));
+    return functions;
+}
+
+// A clamped uint8 input function over 'image' (2D for grayscale functions, 3D otherwise)
+inline Halide::Func clamped_input(Halide::ImageParam image) {
+    Halide::Var x,y,c;
+    Halide::Func in("input");
+    if (image.dimensions() == 2)
+        in(x,y) = image(clamp(x, 0, image.width()-1), clamp(y, 0, image.height()-1));
+    else
+        in(x,y,c) = image(clamp(x, 0, image.width()-1), clamp(y, 0, image.height()-1), c);
+    return in;
+}
+
+// Row-parallel, vectorized schedule of the output stage, with the SpecializeSched fast
+// paths for outputs whose width is a multiple of the vector width (by default the natural
+// vector width of f)
+inline void schedule_output(Halide::Func f, int vector_width = 0) {
+    std::vector<Halide::Var> args = f.args();
+    SpecializeSched(vector_width).schedule(f, args[0], args[1]);
+}
+
+#endif // __FUNCTION_TABLE_H
@@ -0,0 +1,119 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/mapped_image.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+// Gaussian blur of an 8-bit, 3-channel image of any layout
+static Halide::Func blur(Halide::ImageParam input) {
+    Halide::Var x,y,c;
+    Halide::Func padded, padded32, blurred;
+    padded(x,y,c) = input(clamp(x, 0, input.width()-1), clamp(y, 0, input.height()-1), c);
+    padded32(x,y,c) = Halide::cast<int32_t>(padded(x,y,c));
+    blurred(x,y,c) = AS_UINT8(gaussian_3x3(padded32)(x,y,c));
+    return blurred;
+}
+
+// Load -> blur -> save, with stdio PPM IO and with memory-mapped files
+int mapped_io_example(int argc, const char **argv) {
+    // A 4K PPM test file
+    const int width = 3840, height = 2160, runs = 10;
+    Halide::Image<uint8_t> source(width, height, 3);
+    excursions::randomize(source);
+    save_ppm(source, "output/mapped_input.ppm");
+
+    // stdio: parse, de-interleave into a new image, blur, interleave and write
+    Halide::ImageParam planar_in(Halide::UInt(8), 3);
+    Halide::Func planar_blur = blur(planar_in);
+    planar_blur.compile_jit();
+    timings stdio_time;
+    for (int i=0; i<runs; i++) {
+        interval iv(stdio_time);
+        Halide::Image<uint8_t> in = load_ppm<uint8_t>("output/mapped_input.ppm");
+        Halide::Image<uint8_t> out(width, height, 3);
+        planar_in.set(in);
+        planar_blur.realize(out);
+        save_ppm(out, "output/mapped_stdio.ppm");
+    }
+
+    // mmap: the pipeline reads the pixels of the input file in place, and writes the
+    // pixels of the output file in place
+    Halide::ImageParam mapped_in(Halide::UInt(8), 3);
+    set_interleaved_layout(mapped_in, 3);
+    Halide::Func mapped_blur = blur(mapped_in);
+    schedule_interleaved(mapped_blur, 3);
+    mapped_blur.compile_jit();
+    timings mapped_time;
+    for (int i=0; i<runs; i++) {
+        interval iv(mapped_time);
+        excursions::mapped_image in("output/mapped_input.ppm");
+        excursions::mapped_image out("output/mapped_output.ppm", excursions::MAPPED_PPM, width, height, 3);
+        if (!in.valid() || !out.valid())
+            return EXIT_FAILURE;
+        mapped_in.set(in.buffer());
+        mapped_blur.realize(out.buffer());
+    }
+
+    // mmap, planar: interleaved PPM in, raw planar out
+    Halide::Func planar_out_blur = blur(mapped_in);
+    planar_out_blur.vectorize(planar_out_blur.args()[0], 16).parallel(planar_out_blur.args()[1]);
+    planar_out_blur.compile_jit();
+    timings raw_time;
+    for (int i=0; i<runs; i++) {
+        interval iv(raw_time);
+        excursions::mapped_image in("output/mapped_input.ppm");
+        excursions::mapped_image out("output/mapped_output.raw", excursions::MAPPED_RAW, width, height, 3);
+        mapped_in.set(in.buffer());
+        planar_out_blur.realize(out.buffer());
+    }
+
+    // mmap, hbuf: interleaved PPM in, hbuf out, which image_io loads back with a read()
+    timings hbuf_time;
+    for (int i=0; i<runs; i++) {
+        interval iv(hbuf_time);
+        excursions::mapped_image in("output/mapped_input.ppm");
+        excursions::mapped_image out("output/mapped_output.hbuf", excursions::MAPPED_HBUF, width, height, 3);
+        mapped_in.set(in.buffer());
+        planar_out_blur.realize(out.buffer());
+    }
+    timings hbuf_load_time, hbz_save_time, hbz_load_time;
+    Halide::Image<uint8_t> hbuf_result;
+    for (int i=0; i<runs; i++) {
+        {
+            interval iv(hbuf_load_time);
+            hbuf_result = load<uint8_t>("output/mapped_output.hbuf");
+        }
+        {
+            interval iv(hbz_save_time);
+            save(hbuf_result, "output/mapped_output.hbz");
+        }
+        interval iv(hbz_load_time);
+        hbuf_result = load<uint8_t>("output/mapped_output.hbz");
+    }
+
+    // The mapped and the stdio results must be identical
+    excursions::mapped_image stdio_result("output/mapped_stdio.ppm"), mapped_result("output/mapped_output.ppm");
+    Halide::Image<uint8_t> a = stdio_result.buffer(), b = mapped_result.buffer();
+    bool same = true;
+    for (int c=0; c<3 && same; c++)
+        for (int y=0; y<height && same; y++)
+            for (int x=0; x<width && same; x++)
+                same = a(x,y,c) == b(x,y,c) && a(x,y,c) == hbuf_result(x,y,c);
+
+    double dev = 0;
+    printf("%dx%d PPM load + blur + save:\n", width, height);
+    printf("\tstdio:                %8.2f ms\n", stdio_time.mean(dev));
+    printf("\tmmap (PPM -> PPM):    %8.2f ms\n", mapped_time.mean(dev));
+    printf("\tmmap (PPM -> raw):    %8.2f ms\n", raw_time.mean(dev));
+    printf("\tmmap (PPM -> hbuf):   %8.2f ms\n", hbuf_time.mean(dev));
+    printf("hbuf load:              %8.2f ms\n", hbuf_load_time.mean(dev));
+    printf("hbz save / load:        %8.2f / %.2f ms\n", hbz_save_time.mean(dev), hbz_load_time.mean(dev));
+    printf("\tresults %s\n", same ? "match" : "DIFFER");
+
+    printf("%s DONE\n", __func__);
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+
+// A smooth, textured test pattern which can be sampled at any sub-pixel location
+static float synthetic_texture(float x, float y) {
+    return 128.0f + 40.0f * sinf(0.21f * x) * cosf(0.17f * y)
+                  + 30.0f * sinf(0.05f * x + 0.07f * y)
+                  + 20.0f * cosf(0.11f * x - 0.13f * y);
+}
+
+// Create a (prev, next) frame pair where 'next' is 'prev' translated by (dx, dy)
+static void synthetic_frame_pair(Halide::Image<uint8_t> &prev, Halide::Image<uint8_t> &next, float dx, float dy) {
+    for (int y=0; y<prev.height(); y++) {
+        for (int x=0; x<prev.width(); x++) {
+            prev(x,y) = (uint8_t)excursions::clip(synthetic_texture(x, y), 0.0f, 255.0f);
+            next(x,y) = (uint8_t)excursions::clip(synthetic_texture(x - dx, y - dy), 0.0f, 255.0f);
+        }
+    }
+}
+
+// Spread n feature points on a regular grid, keeping away from the frame borders
+static void grid_points(Halide::Image<float> &points, int width, int height) {
+    const int n = points.width();
+    const int margin = 32;
+    int cols = (int)sqrtf(n * (float)width / height) + 1;
+    int rows = (n + cols - 1) / cols;
+    for (int p=0; p<n; p++) {
+        points(p, 0) = margin + (p % cols) * (width - 2*margin) / (float)cols;
+        points(p, 1) = margin + (p / cols) * (height - 2*margin) / (float)rows;
+    }
+}
+
+// Benchmark OpticalFlowPyrLK on synthetic 720p and 1080p frame pairs with 1k-10k features
+int optical_flow_example(int argc, const char **argv) {
+    const int frame_sizes[][2] = { {1280, 720}, {1920, 1080} };
+    const int num_points[] = { 1000, 2500, 5000, 10000 };
+    const float dx = 2.5f, dy = -1.5f;
+
+    for (size_t s=0; s<sizeof(frame_sizes)/sizeof(frame_sizes[0]); s++) {
+        const int width = frame_sizes[s][0], height = frame_sizes[s][1];
+        Halide::Image<uint8_t> prev(width, height), next(width, height);
+        synthetic_frame_pair(prev, next, dx, dy);
+
+        Halide::ImageParam prev_param(Halide::UInt(8), 2), next_param(Halide::UInt(8), 2);
+        Halide::ImageParam points_param(Halide::Float(32), 2);
+        Halide::Func prev_frame, next_frame, points;
+        Halide::Var x,y,p,c;
+        prev_frame(x,y) = prev_param(x,y);
+        next_frame(x,y) = next_param(x,y);
+        points(p,c) = points_param(p,c);
+
+        Halide::Func flow = optical_flow_pyr_lk(prev_frame, next_frame, width, height, points);
+        flow.compile_jit();
+        prev_param.set(prev);
+        next_param.set(next);
+
+        for (size_t n=0; n<sizeof(num_points)/sizeof(num_points[0]); n++) {
+            Halide::Image<float> features(num_points[n], 2), tracked(num_points[n], 2);
+            grid_points(features, width, height);
+            points_param.set(features);
+
+            // warm up
+            flow.realize(tracked);
+
+            timings t;
+            for (int i=0; i<10; i++) {
+                interval iv(t);
+                flow.realize(tracked);
+            }
+
+            double err = 0;
+            for (int i=0; i<tracked.width(); i++)
+                err += sqrtf(powf(tracked(i,0) - features(i,0) - dx, 2) + powf(tracked(i,1) - features(i,1) - dy, 2));
+
+            double dev = 0;
+            double ms = t.mean(dev);
+            printf("%4dx%-4d %5d points: %8.2f ms (std-dev %.2f)  %8.0f points/s  mean error %.3f px\n",
+                   width, height, num_points[n], ms, dev, num_points[n] * 1000.0 / ms, err / tracked.width());
+        }
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "function_table.h"
+
+// Hardware counters for every function in the function table: IPC and last-level cache
+// miss rate tell compute-bound schedules from memory-bound ones; bytes/pixel is the memory
+// traffic implied by the cache misses
+int perf_counters_example(int argc, const char **argv) {
+    const int width = 4096, height = 4096, runs = 10;
+    Halide::Image<uint8_t> rgb(width, height, 3), gray(width, height);
+    Halide::Image<uint8_t> rgb_out(width, height, 3), gray_out(width, height);
+    excursions::randomize(rgb);
+    excursions::randomize(gray);
+
+    // Worker threads only inherit the counters if they are created after the counters are opened
+    halide_shutdown_thread_pool();
+    perf_counters counters;
+    if (!counters.available())
+        printf("hardware counters are not available (check /proc/sys/kernel/perf_event_paranoid); "
+               "reporting times only\n");
+
+    printf("%dx%d, %d runs\n", width, height, runs);
+    printf("%-22s %9s %9s %6s %8s %9s %9s\n", "function", "ms", "MPix/s", "IPC", "LLC miss", "cyc/pix", "bytes/pix");
+    const std::vector<excursion_function> &functions = excursion_functions();
+    for (size_t i=0; i<functions.size(); i++) {
+        const excursion_function &fn = functions[i];
+        Halide::ImageParam input(Halide::UInt(8), fn.grayscale ? 2 : 3);
+        input.set(fn.grayscale ? Halide::Buffer(gray) : Halide::Buffer(rgb));
+        Halide::Image<uint8_t> &output = fn.grayscale ? gray_out : rgb_out;
+
+        Halide::Func f = fn.make(clamped_input(input), width, height);
+        schedule_output(f);
+        f.compile_jit();
+        f.realize(output);
+
+        timings t;
+        perf_timings p;
+        for (int r=0; r<runs; r++) {
+            interval iv(t);
+            perf_interval pv(counters, p);
+            f.realize(output);
+        }
+
+        double dev = 0;
+        double ms = t.mean(dev);
+        const double pixels = (double)width * height;
+        if (p.valid())
+            printf("%-22s %9.2f %9.1f %6.2f %7.1f%% %9.1f %9.2f\n", fn.name, ms, pixels / 1000.0 / ms,
+                   p.ipc(), 100.0 * p.cache_miss_rate(), p.cycles_per_pixel(pixels), p.bytes_per_pixel(pixels));
+        else
+            printf("%-22s %9.2f %9.1f %6s %8s %9s %9s\n", fn.name, ms, pixels / 1000.0 / ms, "n/a", "n/a", "n/a", "n/a");
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#include <Halide.h>
+#include <math.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/roi.h"
+
+// Sobel edge magnitude of a Gaussian-smoothed grayscale image: a 7x7 input halo
+static Halide::Func edges(Halide::Func input) {
+    Halide::Var x,y;
+    Halide::Func wide, out("edges");
+    wide(x,y) = Halide::cast<int32_t>(input(x,y));
+    std::pair<Halide::Func, Halide::Func> g = sobel_3x3<2>(gaussian_5x5_delta14(wide, true));
+    Halide::Func mag = grad_magnitude(g.first, g.second);
+    out(x,y) = Halide::cast<uint8_t>(clamp(mag(x,y), 0, 255));
+    out.vectorize(x, 16).parallel(y);
+    return out;
+}
+
+// Full frame against a region of interest of about 5% of it
+int roi_example(int argc, const char **argv) {
+    const int width = 4096, height = 4096, runs = 20;
+    Halide::Image<uint8_t> image(width, height), full(width, height);
+    excursions::randomize(image);
+
+    excursions::roi_input in(Halide::UInt(8), 2);
+    Halide::Func f = edges(in.clamped());
+    excursions::roi_pipeline roi(in, f);
+    f.compile_jit();
+
+    const excursions::rect frame = { 0, 0, width, height };
+    const int side = (int)(sqrt(0.05) * width);
+    const excursions::rect r = { 1500, 700, side, side };
+    Halide::Image<uint8_t> crop(r.width, r.height);
+    roi.realize(image, frame, full);
+    roi.realize(image, r, crop);
+
+    timings full_time, roi_time;
+    for (int i=0; i<runs; i++) {
+        {
+            interval iv(full_time);
+            roi.realize(image, frame, full);
+        }
+        {
+            interval iv(roi_time);
+            roi.realize(image, r, crop);
+        }
+    }
+
+    int mismatches = 0;
+    for (int y=0; y<r.height; y++)
+        for (int x=0; x<r.width; x++)
+            mismatches += crop(x, y) != full(r.x + x, r.y + y);
+
+    const excursions::rect region = roi.input_region(r, width, height);
+    double dev = 0;
+    const double full_ms = full_time.mean(dev), roi_ms = roi_time.mean(dev);
+    printf("full frame %dx%d: %.2f ms\n", width, height, full_ms);
+    printf("ROI %dx%d at (%d,%d), %.1f%% of the frame: %.2f ms (%.1f%% of the full frame time)\n",
+           r.width, r.height, r.x, r.y, 100.0 * r.width * r.height / ((double)width * height),
+           roi_ms, 100.0 * roi_ms / full_ms);
+    printf("input read: %dx%d at (%d,%d)\n", region.width, region.height, region.x, region.y);
+    printf("%d pixels differ from the full frame result\n", mismatches);
+
+    printf("%s DONE\n", __func__);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
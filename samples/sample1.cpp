@@ -51,13 +51,12 @@ int openvx_example(int argc, const char **argv) {
     gaussian_5x5_fn_uint8.realize(output);
     save(output, "output/gaussian_5x5.png");
 
-#if 0
-    Halide::Func integral_fn = integral_image(padded);
+    // The mean of the rectangle from the origin to each pixel
+    Halide::Func integral_fn = integral_image(padded, input.width(), input.height());
     Halide::Func integral_fn_uint8;
-    integral_fn_uint8(x,y,c) = Halide::cast<uint8_t>(integral_fn(x,y,c));
+    integral_fn_uint8(x,y,c) = Halide::cast<uint8_t>(integral_fn(x,y,c) / Halide::cast<uint32_t>((x+1) * (y+1)));
     integral_fn_uint8.realize(output);
     save(output, "output/integral.png");
-#endif    
 
     Halide::Func luma;
     luma = rgb2luma(padded);
@@ -2,6 +2,7 @@
 #include <string>
 #include "excursions.h"
 #include "utils/utils.h"
+#include "utils/buffer_pool.h"
 
 using Halide::Image;
 #include "utils/image_io.h"
@@ -14,7 +15,9 @@ int scale_example(int argc, const char **argv) {
     padded(x,y,c) = input(clamp(x, 0, input.width()-1), clamp(y, 0, input.height()-1), c);
 
     Halide::Func invert_fn = invert<uint8_t>(padded, r);
-    Halide::Image<uint8_t> output = invert_fn.realize(input.width(), input.height(), input.channels());
+    excursions::pooled_image<uint8_t> pooled_output(input.width(), input.height(), input.channels());
+    Halide::Image<uint8_t> output = pooled_output.image();
+    invert_fn.realize(output);
     save(output, "output/invert.png");
 
     Halide::Func reflect = reflect_vert(padded, 500, input.width());
@@ -27,12 +30,16 @@ int scale_example(int argc, const char **argv) {
 
     float w_scale = 2, h_scale = 2;
     Halide::Func nn_scale_up = nn_scale(padded, 1/w_scale, 1/h_scale);
-    Halide::Image<uint8_t> output_scaled_up = nn_scale_up.realize(input.width()*w_scale, input.height()*h_scale, input.channels());
+    excursions::pooled_image<uint8_t> pooled_scaled_up(input.width()*w_scale, input.height()*h_scale, input.channels());
+    Halide::Image<uint8_t> output_scaled_up = pooled_scaled_up.image();
+    nn_scale_up.realize(output_scaled_up);
     save(output_scaled_up, "output/nn_scale_up.png");
 
     w_scale = 0.5f, h_scale = 0.5f;
     Halide::Func nn_scale_down = nn_scale(padded, 1/w_scale, 1/h_scale);
-    Halide::Image<uint8_t> output_scaled_down = nn_scale_down.realize(input.width()*w_scale, input.height()*h_scale, input.channels());
+    excursions::pooled_image<uint8_t> pooled_scaled_down(input.width()*w_scale, input.height()*h_scale, input.channels());
+    Halide::Image<uint8_t> output_scaled_down = pooled_scaled_down.image();
+    nn_scale_down.realize(output_scaled_down);
     save(output_scaled_down, "output/nn_scale_down.png");
 
     Halide::Func bilinear_scale_down = bilinear_scale(padded, 1/w_scale, 1/h_scale);
@@ -3,101 +3,14 @@
 #include "excursions.h"
 #include "utils/utils.h"
 #include "utils/clock.h"
+#include "utils/profiler.h"
 
 using Halide::Image;
 #include "utils/image_io.h"
 
-class Separable2dConvolutionSched : public Scheduler {
-public:
-    Separable2dConvolutionSched(size_t policy) : policy(policy) {}
-    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {}
-    virtual void schedule(Halide::Func fx, Halide::Func fy, Halide::Var x, Halide::Var y) const {
-    //virtual void schedule(Halide::Func fx, Halide::Func fy) const {
-        //Halide::Var x,y,xi,yi;
-        Halide::Var xi,yi;
-        switch(policy) {
-        case 1:
-            fx.compute_at(fy, y);
-            break;
-        case 2:
-            fx.store_root().compute_at(fy, y);
-            break;
-        case 3:
-            fx.compute_at(fy, x).vectorize(x, 4);
-            break;
-        case 4:
-            fx.compute_at(fy, x).vectorize(x, 4);
-            fy.tile(x, y, xi, yi, 8, 8).parallel(y).vectorize(xi, 4);
-            break;
-        case 5:
-            fx.store_root()
-                    .compute_at(fy, y)
-                    .split(x, x, xi, 8)
-                    .vectorize(xi, 4)
-                    .parallel(x);
-            fy.split(x, x, xi, 8)
-                    .vectorize(xi, 4)
-                    .parallel(x);
-            break;
-        case 6:
-            fx.store_at(fy, y)
-                    .compute_at(fy, yi)
-                    .vectorize(x, 4); 
-            fy.split(y, y, yi, 8)
-                    .parallel(y)
-                    .vectorize(x, 4);
-            break;
-        }
-    }
-
-private:
-    size_t policy;
-};
-
-class ConvolutionSched : public Scheduler {
-public:
-    ConvolutionSched(size_t policy) : policy(policy) {}
-    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
-        Halide::Var xi,yi;
-        switch(policy) {
-        case 1:
-            f.compute_root();
-            break;
-        case 2:
-            f.store_root().vectorize(x, 4);
-            break;
-        case 3:
-            f.store_root().vectorize(x, 8);
-            break;
-        case 4:
-            f.store_root().split(x, x, xi, 8).vectorize(xi, 4).parallel(x);
-            break;
-        case 5:
-            f.store_root().split(x, x, xi, 8).vectorize(xi, 4);
-            break;
-        case 6:
-            f.tile(x, y, xi, yi, 256, 32).vectorize(xi, 8).parallel(y);
-            break;
-        case 7:
-            f.tile(x, y, xi, yi, 256, 32).vectorize(xi, 4).parallel(y);
-            break;
-        case 8:
-            //f.store_root().split(x, x, xi, 32).vectorize(xi, 4).parallel(y);
-            // f.store_root().split(x, x, xi, 256).vectorize(xi, 4).parallel(y);  -- increasing the split size doesn't help much
-            f.split(x, x, xi, 256).vectorize(xi, 4).parallel(y);
-            break;
-        }
-            
-    }    virtual void schedule(Halide::Func fx, Halide::Func fy, Halide::Var x, Halide::Var y) const {}
-
-private:
-    size_t policy;
-};
-
-
 static Halide::Func createAndSchedulePipeline(Halide::Image<uint8_t> input) {
     Halide::Var x,y,xi,yi,c;
-    Halide::Func padded, padded32;
+    Halide::Func padded("padded"), padded32("padded32");
 
     padded(x,y,c) = input(clamp(x, 0, input.width()-1),
                           clamp(y, 0, input.height()-1),
@@ -106,7 +19,8 @@ static Halide::Func createAndSchedulePipeline(Halide::Image<uint8_t> input) {
     padded32(x,y,c) = Halide::cast<int32_t>(padded(x,y,c));
 
     //Halide::Func test = gaussian_3x3_3(padded32, x,y, c, Separable2dConvolutionSched());
-    Halide::Func test = gaussian_3x3_3(padded32, Separable2dConvolutionSched(4));
+    // The schedule file named by EXCURSIONS_SCHEDULE, if any, replaces the compiled-in policy
+    Halide::Func test = gaussian_3x3_3(padded32, FileSched::from_environment(Separable2dConvolutionSched(4)));
     //Halide::Func test = gaussian_3x3_2(padded32, ConvolutionSched(8));
     //Halide::Func test = gaussian_3x3_4(padded32, Separable2dConvolutionSched(4));
     
@@ -117,7 +31,7 @@ static Halide::Func createAndSchedulePipeline(Halide::Image<uint8_t> input) {
     test2(x,y,c) = Halide::cast<uint8_t>(test(x,y,c));
     //test2.tile(x, y, xi, yi, 256, 32).vectorize(xi, 4).parallel(y);
     //test2.tile(x, y, xi, yi, 256, 32).vectorize(xi, 8).parallel(y);
-    test2.vectorize(x, 4).parallel(y);
+    test2.vectorize(x, Scheduler::natural_vector_width(test2)).parallel(y);
 
 #endif // PERFORM_EXTERNAL_CAST
 
@@ -151,7 +65,7 @@ int aot_sched_example(int argc, const char **argv) {
         output_buf.host = (uint8_t *)result;
         timings t;
         for (int i=0; i<50; i++) {
-            interval i(t);
+            interval iv(t);
             halide_sched_example(input_buf, &output_buf);
         }
         t.dump();
@@ -173,14 +87,28 @@ int jit_sched_example(int argc, const char **argv) {
     Halide::Target target = Halide::get_jit_target_from_environment();
     example.compile_jit(target);
 
-    {    
-        timings t(example.name());
+    timings t(example.name());
+    for (int i=0; i<50; i++) {
+        interval iv(t);
+        example.realize(output);
+    }
+
+    // Per-stage breakdown of the same pipeline, in the report after the pipeline timings
+    {
+        Halide::Func profiled = createAndSchedulePipeline(input);
+        Halide::Target profiling = profile_target(target);
+        profiled.compile_jit(profiling);
+        profiled.realize(output, profiling);
+        halide_profiler_reset();
+        stage_profile profile;
         for (int i=0; i<50; i++) {
-            interval i(t);
-            example.realize(output);
+            profiled.realize(output, profiling);
+            profile.collect();
         }
-        t.dump();
+        profile.print();
+        t.add_section(profile.table());
     }
+    t.dump();
     printf("%s (jit) DONE\n", __func__);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,113 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/stream.h"
+
+// Write 'frames' frames of a moving IYUV test pattern to a raw file
+static void write_yuv_file(const char *filename, int width, int height, int frames) {
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+        return;
+    std::vector<uint8_t> frame(width * height * 3 / 2);
+    uint8_t *u = &frame[width * height], *v = u + (width / 2) * (height / 2);
+    for (int n=0; n<frames; n++) {
+        for (int y=0; y<height; y++)
+            for (int x=0; x<width; x++)
+                frame[y * width + x] = (uint8_t)(x + y + 4*n);
+        for (int y=0; y<height/2; y++) {
+            for (int x=0; x<width/2; x++) {
+                u[y * (width/2) + x] = (uint8_t)(128 + x - n);
+                v[y * (width/2) + x] = (uint8_t)(128 + y + n);
+            }
+        }
+        fwrite(&frame[0], 1, frame.size(), f);
+    }
+    fclose(f);
+}
+
+// Split a raw IYUV frame (see yuv_file_source) into its Y, U and V planes
+static image_planes iyuv_planes(Halide::ImageParam frame, int width, int height) {
+    Halide::Var x,y;
+    Halide::Func luma, u, v;
+    Halide::Expr cx = clamp(x, 0, width/2 - 1), cy = clamp(y, 0, height/2 - 1);
+    Halide::Expr u_offset = cy * (width/2) + cx;
+    Halide::Expr v_offset = u_offset + (width/2) * (height/2);
+    luma(x,y) = frame(clamp(x, 0, width-1), clamp(y, 0, height-1));
+    u(x,y) = frame(u_offset % width, height + u_offset / width);
+    v(x,y) = frame(v_offset % width, height + v_offset / width);
+    image_planes planes;
+    planes.push_back(luma);
+    planes.push_back(u);
+    planes.push_back(v);
+    return planes;
+}
+
+static void schedule_rows(Halide::Func f) {
+    std::vector<Halide::Var> args = f.args();
+    f.vectorize(args[0], 16).parallel(args[1]);
+}
+
+// Stream processing of synthetic RGB frames and of a raw YUV file, reporting latency,
+// jitter and throughput for different numbers of buffers in the ring
+int stream_example(int argc, const char **argv) {
+    Halide::Var x,y,c;
+
+    // RGB: 3x3 gaussian blur of each frame
+    const int width = 1920, height = 1080, frames = 100;
+    Halide::ImageParam rgb_in(Halide::UInt(8), 3);
+    Halide::Func padded, padded32, blurred;
+    padded(x,y,c) = rgb_in(clamp(x, 0, rgb_in.width()-1), clamp(y, 0, rgb_in.height()-1), c);
+    padded32(x,y,c) = Halide::cast<int32_t>(padded(x,y,c));
+    blurred(x,y,c) = AS_UINT8(gaussian_3x3(padded32)(x,y,c));
+    schedule_rows(blurred);
+    blurred.compile_jit();
+
+    excursions::stream_runner::process_fn blur = [&](Halide::Image<uint8_t> &in, Halide::Image<uint8_t> &out) {
+        rgb_in.set(in);
+        blurred.realize(out);
+    };
+
+    {
+        excursions::synthetic_source source(320, 240, 5);
+        excursions::ppm_sequence_sink sink("output/stream_%03d.ppm");
+        excursions::stream_runner runner(source, sink, Halide::Image<uint8_t>(320, 240, 3));
+        runner.run(blur);
+    }
+
+    const int ring_sizes[] = { 1, 2, 3, 4 };
+    for (size_t r=0; r<sizeof(ring_sizes)/sizeof(ring_sizes[0]); r++) {
+        char title[64];
+        excursions::synthetic_source source(width, height, frames);
+        // PPM encoding, written to /dev/null, stands in for the cost of the output stage
+        excursions::ppm_sequence_sink sink("/dev/null");
+        excursions::stream_runner runner(source, sink, Halide::Image<uint8_t>(width, height, 3), ring_sizes[r]);
+        snprintf(title, sizeof(title), "1080p RGB blur, %d buffers", ring_sizes[r]);
+        runner.run(blur).print(title);
+    }
+
+    // IYUV file -> RGB
+    const int yuv_width = 1280, yuv_height = 720;
+    write_yuv_file("output/stream_720p.yuv", yuv_width, yuv_height, frames);
+    Halide::ImageParam yuv_in(Halide::UInt(8), 2);
+    Halide::Func rgb = color_convert(iyuv_planes(yuv_in, yuv_width, yuv_height), FORMAT_IYUV, FORMAT_RGB)[0];
+    schedule_rows(rgb);
+    rgb.compile_jit();
+
+    excursions::stream_runner::process_fn convert = [&](Halide::Image<uint8_t> &in, Halide::Image<uint8_t> &out) {
+        yuv_in.set(in);
+        rgb.realize(out);
+    };
+    for (size_t r=0; r<sizeof(ring_sizes)/sizeof(ring_sizes[0]); r++) {
+        char title[64];
+        excursions::yuv_file_source source("output/stream_720p.yuv", yuv_width, yuv_height);
+        excursions::null_sink sink;
+        excursions::stream_runner runner(source, sink, Halide::Image<uint8_t>(yuv_width, yuv_height, 3), ring_sizes[r]);
+        snprintf(title, sizeof(title), "720p IYUV -> RGB, %d buffers", ring_sizes[r]);
+        runner.run(convert).print(title);
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include <Halide.h>
+#include <string>
+#include <thread>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/thread_pool.h"
+
+// A separable blur computed in strips of rows, the strips in parallel
+static Halide::Func strip_blur(Halide::ImageParam input) {
+    Halide::Var x,y,yo,yi;
+    Halide::Func padded("padded"), blur_x("blur_x"), blur_y("blur_y");
+    padded(x,y) = Halide::cast<uint16_t>(input(clamp(x, 0, input.width()-1), clamp(y, 0, input.height()-1)));
+    blur_x(x,y) = padded(x-1,y) + 2 * padded(x,y) + padded(x+1,y);
+    blur_y(x,y) = Halide::cast<uint8_t>((blur_x(x,y-1) + 2 * blur_x(x,y) + blur_x(x,y+1)) >> 4);
+
+    const int vector_width = Scheduler::natural_vector_width(blur_y);
+    blur_y.split(y, yo, yi, 16).parallel(yo).vectorize(x, vector_width);
+    blur_x.store_at(blur_y, yo).compute_at(blur_y, yi).vectorize(x, vector_width);
+    return blur_y;
+}
+
+// Two pipelines co-located in one process, each run by its own thread on a stream of frames:
+// first both on Halide's global thread pool, then each on a pool of half the CPUs, pinned
+// to its own node (or half of the CPUs if the machine has a single node)
+int thread_pool_example(int argc, const char **argv) {
+    const int width = 3840, height = 2160, frames = 20;
+    Halide::Image<uint8_t> frame(width, height);
+    excursions::randomize(frame);
+
+    Halide::ImageParam in_a(Halide::UInt(8), 2), in_b(Halide::UInt(8), 2);
+    in_a.set(frame);
+    in_b.set(frame);
+    Halide::Func shared_a = strip_blur(in_a), shared_b = strip_blur(in_b);
+    Halide::Func pooled_a = strip_blur(in_a), pooled_b = strip_blur(in_b);
+    excursions::use_thread_pool(pooled_a);
+    excursions::use_thread_pool(pooled_b);
+    shared_a.compile_jit();
+    shared_b.compile_jit();
+    pooled_a.compile_jit();
+    pooled_b.compile_jit();
+
+    Halide::Image<uint8_t> expected = shared_a.realize(width, height);
+    Halide::Image<uint8_t> out_a(width, height), out_b(width, height);
+
+    timings shared_time;
+    {
+        interval iv(shared_time);
+        std::thread a([&]() { for (int i=0; i<frames; i++) shared_a.realize(out_a); });
+        std::thread b([&]() { for (int i=0; i<frames; i++) shared_b.realize(out_b); });
+        a.join();
+        b.join();
+    }
+    bool same = excursions::compare_images(out_a, expected) && excursions::compare_images(out_b, expected);
+
+    const excursions::numa_topology nodes = excursions::numa_topology::detect().select(2);
+    const int threads = std::max(1, nodes.cpus() / 2);
+    excursions::thread_pool pool_a(threads, excursions::PIN_NODES, nodes.node(0));
+    excursions::thread_pool pool_b(threads, excursions::PIN_NODES, nodes.node(1));
+    timings pooled_time;
+    {
+        interval iv(pooled_time);
+        std::thread a([&]() { pool_a.run([&]() { for (int i=0; i<frames; i++) pooled_a.realize(out_a); }); });
+        std::thread b([&]() { pool_b.run([&]() { for (int i=0; i<frames; i++) pooled_b.realize(out_b); }); });
+        a.join();
+        b.join();
+    }
+    same = same && excursions::compare_images(out_a, expected) && excursions::compare_images(out_b, expected);
+
+    double dev = 0;
+    printf("2 pipelines x %d frames of %dx%d:\n", frames, width, height);
+    printf("\tHalide thread pool:               %8.2f ms\n", shared_time.mean(dev));
+    printf("\t%d-thread pool per pipeline%s:  %8.2f ms\n", threads, nodes.emulated ? " (emulated nodes)" : "",
+           pooled_time.mean(dev));
+    printf("\tresults %s\n", same ? "match" : "DIFFER");
+
+    printf("%s DONE\n", __func__);
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
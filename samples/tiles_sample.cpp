@@ -0,0 +1,82 @@
+#include <Halide.h>
+#include <string>
+#include <unistd.h>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+#include "utils/roi.h"
+#include "utils/tile_coordinator.h"
+
+// Gaussian 5x5 followed by the Sobel magnitude: a 3 pixel halo
+static Halide::Func smoothed_edges(Halide::Func input) {
+    Halide::Var x,y;
+    Halide::Func wide, out("smoothed_edges");
+    wide(x,y) = Halide::cast<int32_t>(input(x,y));
+    std::pair<Halide::Func, Halide::Func> g = sobel_3x3<2>(gaussian_5x5<2>(wide));
+    Halide::Func mag = grad_magnitude(g.first, g.second);
+    out(x,y) = Halide::cast<uint8_t>(clamp(mag(x,y), 0, 255));
+    out.vectorize(x, 16).parallel(y);
+    return out;
+}
+
+// A large mosaic processed by a single process, and by pools of worker processes
+int tiles_example(int argc, const char **argv) {
+    const int width = 8192, height = 8192, runs = 3;
+    const int cores = std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+    excursions::shared_image<uint8_t> image(width, height), result(width, height);
+    if (!image.valid() || !result.valid())
+        return EXIT_FAILURE;
+    Halide::Image<uint8_t> pixels = image.image();
+    excursions::randomize(pixels);
+
+    excursions::roi_input in(Halide::UInt(8), 2);
+    Halide::Func f = smoothed_edges(in.clamped());
+    excursions::roi_pipeline roi(in, f);
+    f.compile_jit();
+
+    // Single process, all cores
+    Halide::Image<uint8_t> reference(width, height);
+    const excursions::rect frame = { 0, 0, width, height };
+    roi.realize(image.buffer(), frame, reference);
+    timings single;
+    for (int r=0; r<runs; r++) {
+        interval iv(single);
+        roi.realize(image.buffer(), frame, reference);
+    }
+    double dev = 0;
+    const double single_ms = single.mean(dev);
+    printf("%dx%d, single process, %d threads: %.1f ms\n", width, height, cores, single_ms);
+
+    printf("%8s %8s %6s %6s %8s %10s %8s\n", "workers", "threads", "tiles", "halo", "overlap", "ms", "speedup");
+    bool ok = true;
+    for (int workers=1; workers<=cores; workers*=2) {
+        excursions::tile_coordinator coordinator(in, f, 1024, 1024, workers, std::max(1, cores / workers));
+        timings tiled;
+        for (int r=0; r<runs && ok; r++) {
+            interval iv(tiled);
+            ok = coordinator.run(image.buffer(), result.buffer());
+        }
+        if (!ok)
+            break;
+
+        // Stitched tiles must match the single-process result exactly
+        Halide::Image<uint8_t> stitched = result.image();
+        int seams = 0;
+        for (int y=0; y<height; y++)
+            for (int x=0; x<width; x++)
+                seams += stitched(x, y) != reference(x, y);
+        if (seams) {
+            printf("%d pixels differ from the single-process result\n", seams);
+            ok = false;
+            break;
+        }
+
+        const excursions::tile_coordinator::stats &s = coordinator.get_stats();
+        const double ms = tiled.mean(dev);
+        printf("%8d %8d %6d %6d %7.2fx %10.1f %7.2fx\n", workers, std::max(1, cores / workers),
+               s.tiles, s.halo, s.input_overlap, ms, single_ms / ms);
+    }
+
+    printf("%s DONE\n", __func__);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/clock.h"
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+// OpenVX affine matrix (column-major 2x3) rotating the output by 'degrees' around (cx, cy)
+static void rotation_matrix(float degrees, float cx, float cy, float matrix[6]) {
+    float theta = degrees * (float)M_PI / 180.0f;
+    float cs = cosf(theta), sn = sinf(theta);
+    matrix[0] = cs;     matrix[2] = sn;     matrix[4] = cx - cs * cx - sn * cy;
+    matrix[1] = -sn;    matrix[3] = cs;     matrix[5] = cy + sn * cx - cs * cy;
+}
+
+// The baseline the tiled schedule is compared with: the same vectorization and parallel
+// rows, in row order, so that the difference is the locality of the tiles
+class RowSched : public Scheduler {
+public:
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        f.vectorize(x, natural_vector_width(f)).parallel(y);
+    }
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {}
+};
+
+static double time_realize(Halide::Func f, Halide::Image<uint8_t> &output) {
+    f.compile_jit();
+    f.realize(output);
+    timings t;
+    for (int i=0; i<10; i++) {
+        interval iv(t);
+        f.realize(output);
+    }
+    double dev = 0;
+    return t.mean(dev);
+}
+
+int warp_example(int argc, const char **argv) {
+    Halide::Image<uint8_t> input = load<uint8_t>(argv[0]);
+    Halide::Image<uint8_t> output(input.width(), input.height(), input.channels());
+    Halide::Var x,y,c;
+    Halide::Func in;
+    in(x,y,c) = input(x,y,c);
+
+    float rot30[6];
+    rotation_matrix(30, input.width() / 2.0f, input.height() / 2.0f, rot30);
+
+    warp_affine(in, input.width(), input.height(), rot30, NEAREST_NEIGHBOR, BORDER_CONSTANT).realize(output);
+    save(output, "output/warp_affine_nn.png");
+    warp_affine(in, input.width(), input.height(), rot30, BILINEAR, BORDER_CONSTANT).realize(output);
+    save(output, "output/warp_affine_bilinear.png");
+    warp_affine(in, input.width(), input.height(), rot30, BILINEAR, BORDER_REPLICATE).realize(output);
+    save(output, "output/warp_affine_replicate.png");
+    warp_affine_fixed(in, input.width(), input.height(), rot30, BILINEAR, BORDER_CONSTANT).realize(output);
+    save(output, "output/warp_affine_fixed.png");
+
+    // mild keystone
+    float keystone[9] = { 1.0f, 0.0f, 0.0002f,
+                          0.1f, 1.0f, 0.0f,
+                          0.0f, 0.0f, 1.0f };
+    warp_perspective(in, input.width(), input.height(), keystone, BILINEAR, BORDER_CONSTANT).realize(output);
+    save(output, "output/warp_perspective.png");
+
+    // Performance: rotate a large grayscale image, in parallel vectorized rows and in tiles
+    const int size = 4096;
+    Halide::Image<uint8_t> big(size, size), big_output(size, size);
+    excursions::randomize(big);
+    Halide::Func big_in;
+    big_in(x,y) = big(x,y);
+
+    const float angles[] = { 30, 90 };
+    for (size_t a=0; a<sizeof(angles)/sizeof(angles[0]); a++) {
+        float m[6];
+        rotation_matrix(angles[a], size / 2.0f, size / 2.0f, m);
+        printf("rotate %.0f degrees (%dx%d uint8):\n", angles[a], size, size);
+        printf("\tnearest            rows: %8.2f ms  tiled: %8.2f ms\n",
+               time_realize(warp_affine(big_in, size, size, m, NEAREST_NEIGHBOR, BORDER_CONSTANT, 0, true, RowSched()), big_output),
+               time_realize(warp_affine(big_in, size, size, m, NEAREST_NEIGHBOR, BORDER_CONSTANT, 0, true, TileSched()), big_output));
+        printf("\tbilinear           rows: %8.2f ms  tiled: %8.2f ms\n",
+               time_realize(warp_affine(big_in, size, size, m, BILINEAR, BORDER_CONSTANT, 0, true, RowSched()), big_output),
+               time_realize(warp_affine(big_in, size, size, m, BILINEAR, BORDER_CONSTANT, 0, true, TileSched()), big_output));
+        printf("\tbilinear (fixed)   rows: %8.2f ms  tiled: %8.2f ms\n",
+               time_realize(warp_affine_fixed(big_in, size, size, m, BILINEAR, BORDER_CONSTANT, 0, true, RowSched()), big_output),
+               time_realize(warp_affine_fixed(big_in, size, size, m, BILINEAR, BORDER_CONSTANT, 0, true, TileSched()), big_output));
+    }
+
+    printf("%s DONE\n", __func__);
+    return EXIT_SUCCESS;
+}
@@ -1,11 +1,32 @@
 #ifndef __SCHED_POLICY_H
 #define __SCHED_POLICY_H
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+
 class Scheduler {
 public:
     virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const = 0;
     virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const = 0;
     //virtual void schedule(Halide::Func f1, Halide::Func f2) const = 0;
+
+    // The number of elements of f's output type in a vector register of 'target': 16 uint8
+    // or 4 int32 with SSE, 32 uint8 or 8 int32 with AVX2
+    static int natural_vector_width(Halide::Func f,
+                                    const Halide::Target &target = Halide::get_jit_target_from_environment()) {
+        return target.natural_vector_size(f.output_types()[0]);
+    }
+
+protected:
+    // The vector width a scheduler constructed with 'vector_width' uses for f: the natural
+    // vector width of f if it is 0, 'vector_width' otherwise
+    static int vector_width_of(Halide::Func f, int vector_width) {
+        return vector_width ? vector_width : natural_vector_width(f);
+    }
 };
 
 class NoPSched : public Scheduler {
@@ -14,4 +35,559 @@ class NoPSched : public Scheduler {
     //virtual void schedule(Halide::Func f1, Halide::Func f2) const {}
 };
 
+// Tiles the output so that the input footprint of each tile stays in cache, vectorizes
+// the inner tile dimension and processes rows of tiles in parallel.
+// In this file a vector_width of 0 is the natural vector width of the scheduled function
+// (see Scheduler::natural_vector_width).
+class TileSched : public Scheduler {
+public:
+    TileSched(int tile_width = 64, int tile_height = 64, int vector_width = 0) :
+        tile_width(tile_width), tile_height(tile_height), vector_width(vector_width) {}
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        Halide::Var xi,yi;
+        f.tile(x, y, xi, yi, tile_width, tile_height).vectorize(xi, vector_width_of(f, vector_width)).parallel(y);
+    }
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {}
+
+private:
+    int tile_width, tile_height, vector_width;
+};
+
+// The numbered schedules explored by the scheduling sample.  Policy 0 leaves the function
+// unscheduled; policies 1..policies are the variants below.  Separable2dConvolutionSched
+// schedules a separable filter (fx the horizontal pass, fy the vertical one), and
+// ConvolutionSched a single-stage filter.  tests/schedule_equivalence_test.cpp checks that
+// they all produce the same output.
+// The policies vectorize by v, and split or tile by multiples of it: v is 'vector_width',
+// or the natural vector width of each function if it is 0.  A vector width of 4 gives the
+// schedules as first explored, on SSE and int32.
+class Separable2dConvolutionSched : public Scheduler {
+public:
+    static const size_t policies = 6;
+
+    Separable2dConvolutionSched(size_t policy, int vector_width = 0) : policy(policy), vector_width(vector_width) {}
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {}
+    virtual void schedule(Halide::Func fx, Halide::Func fy, Halide::Var x, Halide::Var y) const {
+        Halide::Var xi,yi;
+        const int vx = vector_width_of(fx, vector_width), vy = vector_width_of(fy, vector_width);
+        switch(policy) {
+        case 1:
+            fx.compute_at(fy, y);
+            break;
+        case 2:
+            fx.store_root().compute_at(fy, y);
+            break;
+        case 3:
+            fx.compute_at(fy, x).vectorize(x, vx);
+            break;
+        case 4:
+            fx.compute_at(fy, x).vectorize(x, vx);
+            fy.tile(x, y, xi, yi, 2*vy, 8).parallel(y).vectorize(xi, vy);
+            break;
+        case 5:
+            fx.store_root()
+                    .compute_at(fy, y)
+                    .split(x, x, xi, 2*vx)
+                    .vectorize(xi, vx)
+                    .parallel(x);
+            fy.split(x, x, xi, 2*vy)
+                    .vectorize(xi, vy)
+                    .parallel(x);
+            break;
+        case 6:
+            fx.store_at(fy, y)
+                    .compute_at(fy, yi)
+                    .vectorize(x, vx);
+            fy.split(y, y, yi, 8)
+                    .parallel(y)
+                    .vectorize(x, vy);
+            break;
+        }
+    }
+
+private:
+    size_t policy;
+    int vector_width;
+};
+
+class ConvolutionSched : public Scheduler {
+public:
+    static const size_t policies = 8;
+
+    ConvolutionSched(size_t policy, int vector_width = 0) : policy(policy), vector_width(vector_width) {}
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        Halide::Var xi,yi;
+        const int v = vector_width_of(f, vector_width);
+        switch(policy) {
+        case 1:
+            f.compute_root();
+            break;
+        case 2:
+            f.store_root().vectorize(x, v);
+            break;
+        case 3:
+            f.store_root().vectorize(x, 2*v);
+            break;
+        case 4:
+            f.store_root().split(x, x, xi, 2*v).vectorize(xi, v).parallel(x);
+            break;
+        case 5:
+            f.store_root().split(x, x, xi, 2*v).vectorize(xi, v);
+            break;
+        case 6:
+            f.tile(x, y, xi, yi, 256, 32).vectorize(xi, 2*v).parallel(y);
+            break;
+        case 7:
+            f.tile(x, y, xi, yi, 256, 32).vectorize(xi, v).parallel(y);
+            break;
+        case 8:
+            // increasing the split size doesn't help much
+            f.split(x, x, xi, 256).vectorize(xi, v).parallel(y);
+            break;
+        }
+    }
+    virtual void schedule(Halide::Func fx, Halide::Func fy, Halide::Var x, Halide::Var y) const {}
+
+private:
+    size_t policy;
+    int vector_width;
+};
+
+// Specialized fast paths for the common image geometries, each compiled into the same
+// pipeline and selected at run time from the output (and input) buffers:
+//  - an output width that is a multiple of the vector width, and unit stride in x of every
+//    input in 'inputs': no tail iteration, and dense vector loads from the inputs.  Halide
+//    requires unit stride in x of every image by default; the scheduler lifts that
+//    requirement on 'inputs' so that the test is made at run time, and inputs of any
+//    stride (interleaved images, for instance) run the generic schedule.  The output keeps
+//    its unit stride constraint, so it is not tested.
+//  - in addition, 3 or 4 channels of a 3D function: the channel loop fully unrolled inside
+//    each row, so a row of every channel is produced while its input rows are in cache
+// Any other geometry runs the generic vectorized schedule.
+class SpecializeSched : public Scheduler {
+public:
+    SpecializeSched(int vector_width = 0,
+                    const std::vector<Halide::OutputImageParam> &inputs = std::vector<Halide::OutputImageParam>()) :
+        vector_width(vector_width), inputs(inputs) {}
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        const int vector_width = vector_width_of(f, this->vector_width);
+        Halide::OutputImageParam out = f.output_buffer();
+        Halide::Expr fast = out.width() % vector_width == 0;
+        for (size_t i=0; i<inputs.size(); i++) {
+            Halide::OutputImageParam input = inputs[i];
+            input.set_stride(0, Halide::Expr());
+            fast = fast && input.stride(0) == 1;
+        }
+
+        if (f.dimensions() == 3) {
+            Halide::Var c = f.args()[2];
+            for (int channels=3; channels<=4; channels++)
+                f.specialize(fast && out.channels() == channels)
+                    .reorder(x, c, y).unroll(c).vectorize(x, vector_width).parallel(y);
+        }
+        f.specialize(fast).vectorize(x, vector_width).parallel(y);
+        f.vectorize(x, vector_width).parallel(y);
+    }
+    // f1 is produced per row of f2
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {
+        f1.compute_at(f2, y).vectorize(f1.args()[0], vector_width_of(f1, vector_width));
+        schedule(f2, x, y);
+    }
+
+private:
+    int vector_width;
+    std::vector<Halide::OutputImageParam> inputs;
+};
+
+// Batches of small images, (x,y,c,n) functions: the rows of every channel of every image
+// in the batch are fused into a single parallel loop, split into tasks of rows_per_task
+// rows.  A batch of thumbnails then spreads over all the cores even though each image has
+// few rows, and each task is long enough to amortize waking up a worker thread.  The batch
+// must have at least rows_per_task rows in total.  Functions of fewer dimensions get a
+// row-parallel schedule.
+class BatchSched : public Scheduler {
+public:
+    BatchSched(int vector_width = 0, int rows_per_task = 32) :
+        vector_width(vector_width), rows_per_task(rows_per_task) {}
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        schedule_rows(f, x, y);
+    }
+    // f1 is produced per task of f2
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {
+        Halide::Var task = schedule_rows(f2, x, y);
+        f1.compute_at(f2, task).vectorize(f1.args()[0], vector_width_of(f1, vector_width));
+    }
+
+private:
+    // Returns the parallel loop
+    Halide::Var schedule_rows(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        std::vector<Halide::Var> args = f.args();
+        f.vectorize(x, vector_width_of(f, vector_width));
+        if (args.size() < 4) {
+            f.parallel(y);
+            return y;
+        }
+        Halide::Var yc, rows, task, row;
+        f.fuse(y, args[2], yc).fuse(yc, args[3], rows)
+         .split(rows, task, row, rows_per_task).parallel(task);
+        return task;
+    }
+
+    int vector_width, rows_per_task;
+};
+
+// Reads the schedule of each stage from a text description at run time instead of a
+// numbered policy compiled into the program, so that a deployed JIT pipeline can be
+// retuned for new hardware by editing a file.  Each line is
+//     <stage> <directive> [<argument> ...]
+// where <stage> is the name of a Func (Func::name()), or the role of the Func in the
+// schedule() call: "output" for f and f2, "producer" for f1.  A name takes precedence over
+// a role.  The directives of a stage are applied in file order, the output's first:
+//     split <var> <outer> <inner> <factor>
+//     tile <x> <y> <xi> <yi> <width> <height>
+//     tile <x> <y> <xo> <yo> <xi> <yi> <width> <height>
+//     reorder <var> <var> [<var> [<var>]]          (innermost first)
+//     vectorize <var> [<width>]                    (the natural width by default)
+//     unroll <var> [<factor>]
+//     parallel <var>
+//     compute_root | store_root | compute_inline
+//     compute_at <stage> <var> | store_at <stage> <var>
+// x and y name the arguments of a stage passed to schedule() (the first two for the
+// producer), c and n its third and fourth.  Any other name must be defined by an earlier
+// split or tile of the stage (of any stage, for the <var> of compute_at and store_at): the
+// variables are shared by the stages of a schedule() call, so that a producer can be
+// computed in a tile of its consumer.  A factor or width is a number, v for the natural
+// vector width of the stage (as a vector_width of 0 above) or a multiple of it such as 2v.
+// '#' starts a comment.  Lines with errors are reported on stderr and skipped, and make the
+// scheduler invalid; so does a directive which does not fit the Func it is applied to
+// (c or n beyond its dimensions, or a missing consumer stage), when it is applied.
+// schedules/ holds examples.
+class FileSched : public Scheduler {
+public:
+    explicit FileSched(const std::string &filename) : ok(true) {
+        std::ifstream in(filename.c_str());
+        if (!in) {
+            fprintf(stderr, "%s: cannot read schedule\n", filename.c_str());
+            ok = false;
+            return;
+        }
+        parse(in, filename);
+    }
+    FileSched(std::istream &in, const std::string &source) : ok(true) {
+        parse(in, source);
+    }
+
+    // True if the schedule was read without errors
+    bool valid() const { return ok; }
+
+    // The schedule file named by the EXCURSIONS_SCHEDULE environment variable, or 'fallback'
+    // if the variable is not set or the file is not valid.  The file is read once, on the
+    // first call; after a failure to apply it, the later calls return 'fallback'.
+    static const Scheduler &from_environment(const Scheduler &fallback) {
+        const char *filename = getenv("EXCURSIONS_SCHEDULE");
+        if (!filename || !*filename)
+            return fallback;
+        static const FileSched sched(filename);
+        if (!sched.valid())
+            return fallback;
+        return sched;
+    }
+
+    virtual void schedule(Halide::Func f, Halide::Var x, Halide::Var y) const {
+        std::vector<stage> stages(1, stage(f, "output", x, y));
+        apply(stages);
+    }
+    virtual void schedule(Halide::Func f1, Halide::Func f2, Halide::Var x, Halide::Var y) const {
+        std::vector<stage> stages;
+        stages.push_back(stage(f2, "output", x, y));
+        stages.push_back(stage(f1, "producer", f1.args()[0], f1.args()[1]));
+        apply(stages);
+    }
+
+private:
+    struct directive {
+        std::string where;      // file:line
+        std::vector<std::string> words;
+    };
+
+    struct stage {
+        stage(Halide::Func f, const char *role, Halide::Var x, Halide::Var y) : f(f), role(role) {
+            const std::vector<Halide::Var> args = f.args();
+            vars["x"] = x;
+            vars["y"] = y;
+            if (args.size() > 2)
+                vars["c"] = args[2];
+            if (args.size() > 3)
+                vars["n"] = args[3];
+        }
+        Halide::Func f;
+        std::string role;
+        std::map<std::string, Halide::Var> vars;
+    };
+
+    void parse(std::istream &in, const std::string &source) {
+        // The variables defined by the splits and tiles read so far, per stage and in all
+        std::map<std::string, std::set<std::string> > stage_vars;
+        std::set<std::string> all_vars;
+        std::string line;
+        for (int number=1; std::getline(in, line); number++) {
+            std::istringstream words(line.substr(0, line.find('#')));
+            std::string name, word;
+            if (!(words >> name))
+                continue;
+            directive d;
+            d.where = source + ":" + std::to_string(number);
+            while (words >> word)
+                d.words.push_back(word);
+            if (check(d, stage_vars[name], all_vars))
+                directives[name].push_back(d);
+            else
+                ok = false;
+        }
+    }
+
+    static bool check(const directive &d, std::set<std::string> &stage_vars, std::set<std::string> &all_vars) {
+        static const struct { const char *name; size_t min_args, max_args; } syntax[] = {
+            { "split", 4, 4 },
+            { "tile", 6, 8 },
+            { "reorder", 2, 4 },
+            { "vectorize", 1, 2 },
+            { "unroll", 1, 2 },
+            { "parallel", 1, 1 },
+            { "compute_root", 0, 0 },
+            { "store_root", 0, 0 },
+            { "compute_inline", 0, 0 },
+            { "compute_at", 2, 2 },
+            { "store_at", 2, 2 },
+        };
+        if (d.words.empty()) {
+            fprintf(stderr, "%s: missing directive\n", d.where.c_str());
+            return false;
+        }
+        const std::string &op = d.words[0];
+        const size_t args = d.words.size() - 1;
+        for (size_t i=0; i<sizeof(syntax)/sizeof(syntax[0]); i++) {
+            if (op != syntax[i].name)
+                continue;
+            if (args < syntax[i].min_args || args > syntax[i].max_args || (op == "tile" && args == 7)) {
+                fprintf(stderr, "%s: wrong number of arguments to %s\n", d.where.c_str(), op.c_str());
+                return false;
+            }
+            // The factors are the trailing arguments
+            size_t factors = 0;
+            if (op == "split" || ((op == "vectorize" || op == "unroll") && args == 2))
+                factors = 1;
+            else if (op == "tile")
+                factors = 2;
+            for (size_t a=args+1-factors; a<=args; a++) {
+                int multiple;
+                bool natural;
+                if (!parse_factor(d.words[a], multiple, natural)) {
+                    fprintf(stderr, "%s: '%s' is not a factor\n", d.where.c_str(), d.words[a].c_str());
+                    return false;
+                }
+            }
+            return check_variables(d, stage_vars, all_vars);
+        }
+        fprintf(stderr, "%s: unknown directive '%s'\n", d.where.c_str(), op.c_str());
+        return false;
+    }
+
+    static bool is_argument(const std::string &name) {
+        return name == "x" || name == "y" || name == "c" || name == "n";
+    }
+
+    // The positions in w of the variables a directive uses, and of those it defines
+    static void variables(const std::vector<std::string> &w, std::vector<size_t> &uses, std::vector<size_t> &defines) {
+        const std::string &op = w[0];
+        if (op == "split") {
+            uses.push_back(1);
+            defines.push_back(2);
+            defines.push_back(3);
+        } else if (op == "tile") {
+            uses.push_back(1);
+            uses.push_back(2);
+            for (size_t i=3; i+2<w.size(); i++)
+                defines.push_back(i);
+        } else if (op == "reorder") {
+            for (size_t i=1; i<w.size(); i++)
+                uses.push_back(i);
+        } else if (op == "vectorize" || op == "unroll" || op == "parallel") {
+            uses.push_back(1);
+        }
+    }
+
+    // Each variable used must be an argument or defined by an earlier split or tile
+    static bool check_variables(const directive &d, std::set<std::string> &stage_vars, std::set<std::string> &all_vars) {
+        const std::vector<std::string> &w = d.words;
+        if (w[0] == "compute_at" || w[0] == "store_at") {
+            if (is_argument(w[2]) || all_vars.count(w[2]))
+                return true;
+            fprintf(stderr, "%s: unknown variable '%s'\n", d.where.c_str(), w[2].c_str());
+            return false;
+        }
+        std::vector<size_t> uses, defines;
+        variables(w, uses, defines);
+        for (size_t i=0; i<uses.size(); i++) {
+            const std::string &name = w[uses[i]];
+            if (!is_argument(name) && !stage_vars.count(name)) {
+                fprintf(stderr, "%s: unknown variable '%s'\n", d.where.c_str(), name.c_str());
+                return false;
+            }
+        }
+        for (size_t i=0; i<defines.size(); i++) {
+            stage_vars.insert(w[defines[i]]);
+            all_vars.insert(w[defines[i]]);
+        }
+        return true;
+    }
+
+    // A positive number, or a multiple of the natural vector width: v, 2v, ...
+    static bool parse_factor(const std::string &word, int &multiple, bool &natural) {
+        natural = !word.empty() && word[word.size()-1] == 'v';
+        const std::string number = natural ? word.substr(0, word.size()-1) : word;
+        if (number.empty()) {
+            multiple = 1;
+            return natural;
+        }
+        char *end;
+        const long value = strtol(number.c_str(), &end, 10);
+        multiple = (int)value;
+        return *end == '\0' && value > 0 && value <= 65536;
+    }
+
+    static int factor(const stage &s, const std::string &word) {
+        int multiple;
+        bool natural;
+        parse_factor(word, multiple, natural);
+        return natural ? multiple * natural_vector_width(s.f) : multiple;
+    }
+
+    // The argument of s, or the variable shared by the stages, created on first use
+    static Halide::Var var(const stage &s, const std::string &name, std::map<std::string, Halide::Var> &created) {
+        std::map<std::string, Halide::Var>::const_iterator arg = s.vars.find(name);
+        return arg != s.vars.end() ? arg->second : created[name];
+    }
+
+    // True if name is an argument of s or was defined by a split or tile already applied
+    static bool known(const stage &s, const std::string &name, const std::map<std::string, Halide::Var> &created) {
+        return s.vars.count(name) || created.count(name);
+    }
+
+    static stage *find_stage(std::vector<stage> &stages, const std::string &name) {
+        for (size_t i=0; i<stages.size(); i++)
+            if (stages[i].f.name() == name)
+                return &stages[i];
+        for (size_t i=0; i<stages.size(); i++)
+            if (stages[i].role == name)
+                return &stages[i];
+        return NULL;
+    }
+
+    void apply(std::vector<stage> &stages) const {
+        std::map<std::string, Halide::Var> created;
+        for (size_t i=0; i<stages.size(); i++) {
+            std::map<std::string, std::vector<directive> >::const_iterator found = directives.find(stages[i].f.name());
+            if (found == directives.end())
+                found = directives.find(stages[i].role);
+            if (found == directives.end())
+                continue;
+            for (size_t d=0; d<found->second.size(); d++)
+                apply(found->second[d], stages[i], stages, created);
+        }
+    }
+
+    void apply(const directive &d, stage &s, std::vector<stage> &stages,
+               std::map<std::string, Halide::Var> &created) const {
+        const std::vector<std::string> &w = d.words;
+        const std::string &op = w[0];
+        Halide::Func f = s.f;
+        std::vector<size_t> uses, defines;
+        variables(w, uses, defines);
+        for (size_t i=0; i<uses.size(); i++)
+            if (!known(s, w[uses[i]], created)) {
+                fprintf(stderr, "%s: %s has no variable '%s'\n", d.where.c_str(), s.f.name().c_str(), w[uses[i]].c_str());
+                ok = false;
+                return;
+            }
+        if (op == "split") {
+            f.split(var(s, w[1], created), var(s, w[2], created), var(s, w[3], created), factor(s, w[4]));
+        } else if (op == "tile" && w.size() == 7) {
+            f.tile(var(s, w[1], created), var(s, w[2], created), var(s, w[3], created), var(s, w[4], created),
+                   factor(s, w[5]), factor(s, w[6]));
+        } else if (op == "tile") {
+            f.tile(var(s, w[1], created), var(s, w[2], created), var(s, w[3], created), var(s, w[4], created),
+                   var(s, w[5], created), var(s, w[6], created), factor(s, w[7]), factor(s, w[8]));
+        } else if (op == "reorder") {
+            std::vector<Halide::Var> v;
+            for (size_t i=1; i<w.size(); i++)
+                v.push_back(var(s, w[i], created));
+            if (v.size() == 2)
+                f.reorder(v[0], v[1]);
+            else if (v.size() == 3)
+                f.reorder(v[0], v[1], v[2]);
+            else
+                f.reorder(v[0], v[1], v[2], v[3]);
+        } else if (op == "vectorize") {
+            f.vectorize(var(s, w[1], created), w.size() == 3 ? factor(s, w[2]) : natural_vector_width(f));
+        } else if (op == "unroll") {
+            if (w.size() == 3)
+                f.unroll(var(s, w[1], created), factor(s, w[2]));
+            else
+                f.unroll(var(s, w[1], created));
+        } else if (op == "parallel") {
+            f.parallel(var(s, w[1], created));
+        } else if (op == "compute_root") {
+            f.compute_root();
+        } else if (op == "store_root") {
+            f.store_root();
+        } else if (op == "compute_inline") {
+            f.compute_inline();
+        } else {
+            // compute_at or store_at
+            stage *consumer = find_stage(stages, w[1]);
+            if (!consumer || consumer == &s) {
+                fprintf(stderr, "%s: no consumer stage '%s' for %s\n", d.where.c_str(), w[1].c_str(), s.f.name().c_str());
+                ok = false;
+                return;
+            }
+            if (!known(*consumer, w[2], created)) {
+                fprintf(stderr, "%s: %s has no variable '%s'\n", d.where.c_str(), consumer->f.name().c_str(), w[2].c_str());
+                ok = false;
+                return;
+            }
+            if (op == "compute_at")
+                f.compute_at(consumer->f, var(*consumer, w[2], created));
+            else
+                f.store_at(consumer->f, var(*consumer, w[2], created));
+        }
+    }
+
+    // Cleared by errors in the file, and by directives which fail when they are applied
+    mutable bool ok;
+    std::map<std::string, std::vector<directive> > directives;
+};
+
+// Calls visit(name, scheduler) for every scheduler policy above, with its default
+// parameters, and every numbered policy.  A new policy is registered here so that the
+// schedule equivalence test covers it.
+template <typename Visitor>
+void for_each_sched_policy(Visitor visit) {
+    visit(std::string("NoPSched"), NoPSched());
+    visit(std::string("TileSched"), TileSched());
+    visit(std::string("SpecializeSched"), SpecializeSched());
+    visit(std::string("SpecializeSched(8)"), SpecializeSched(8));
+    visit(std::string("BatchSched"), BatchSched());
+    for (size_t p=1; p<=ConvolutionSched::policies; p++)
+        visit("ConvolutionSched(" + std::to_string(p) + ")", ConvolutionSched(p));
+    for (size_t p=1; p<=Separable2dConvolutionSched::policies; p++)
+        visit("Separable2dConvolutionSched(" + std::to_string(p) + ")", Separable2dConvolutionSched(p));
+    std::istringstream tiled("output tile x y xi yi 64 16\n"
+                             "output vectorize xi v\n"
+                             "output parallel y\n"
+                             "producer compute_at output x\n"
+                             "producer vectorize x v\n");
+    visit(std::string("FileSched"), FileSched(tiled, "FileSched"));
+}
+
 #endif // __SCHED_POLICY_H
\ No newline at end of file
@@ -92,11 +92,3 @@ TEST(box3x3Test, Normal) {
   EXPECT_EQ(true,box_3x3__test_3d());
   EXPECT_EQ(true,box_3x3__test());
 }
-
-#include <stdio.h>
-
-GTEST_API_ int main(int argc, char **argv) {
-  printf("Running main() from gtest_main.cc\n");
-  testing::InitGoogleTest(&argc, argv);
-  return RUN_ALL_TESTS();
-}
@@ -0,0 +1,489 @@
+#include <Halide.h>
+#include <limits>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using Halide::Image;
+#include "utils/image_io.h"
+
+#include "gtest/gtest.h"
+
+//
+// The bulk row conversions of image_io.h must give the same bits as convert() per sample,
+// for every type pair image_io converts and for the strides of interleaved rows.
+//
+
+// Every value of the 8 and 16-bit types, the extremes and random values of the 32-bit
+// types, and [0,1] (the range image_io maps to the integer types) for float and double
+template <typename T, bool Integer = std::numeric_limits<T>::is_integer, bool Small = (sizeof(T) <= 2)>
+struct test_samples;
+
+template <typename T>
+struct test_samples<T, true, true> {
+    static std::vector<T> get() {
+        std::vector<T> samples;
+        for (int v = std::numeric_limits<T>::min(); v <= std::numeric_limits<T>::max(); v++)
+            samples.push_back((T)v);
+        return samples;
+    }
+};
+
+template <typename T>
+struct test_samples<T, true, false> {
+    static std::vector<T> get() {
+        const T edges[] = { 0, 1, (T)-1, std::numeric_limits<T>::min(), std::numeric_limits<T>::max(),
+                            (T)0x00ffffff, (T)0x01000000, (T)0x7fffffff, (T)0x80000000u };
+        std::vector<T> samples(edges, edges + sizeof(edges) / sizeof(edges[0]));
+        srand(42);
+        for (int i = 0; i < 8192; i++)
+            samples.push_back((T)(((uint32_t)rand() << 16) ^ (uint32_t)rand()));
+        return samples;
+    }
+};
+
+template <typename T>
+struct test_samples<T, false, false> {
+    static std::vector<T> get() {
+        std::vector<T> samples;
+        for (int i = 0; i <= 4096; i++)
+            samples.push_back((T)i / 4096);
+        srand(42);
+        for (int i = 0; i < 4096; i++)
+            samples.push_back((T)rand() / RAND_MAX);
+        return samples;
+    }
+};
+
+template <typename In, typename Out>
+static ::testing::AssertionResult bulk_matches_scalar(const char *pair) {
+    const std::vector<In> samples = test_samples<In>::get();
+    for (int in_stride = 1; in_stride <= 5; in_stride++) {
+        for (int out_stride = 1; out_stride <= 5; out_stride++) {
+            // Odd counts leave a vector tail
+            const int n = (int)samples.size() / in_stride - 1;
+            std::vector<In> in(n * in_stride);
+            for (int i = 0; i < n * in_stride; i++)
+                in[i] = samples[i % samples.size()];
+            std::vector<Out> bulk(n * out_stride, 0), scalar(n * out_stride, 0);
+            convert_samples(&in[0], in_stride, &bulk[0], out_stride, n);
+            for (int i = 0; i < n; i++)
+                convert(in[i*in_stride], scalar[i*out_stride]);
+            if (memcmp(&bulk[0], &scalar[0], bulk.size() * sizeof(Out)) != 0)
+                return ::testing::AssertionFailure() << pair << " differs with in_stride " << in_stride
+                                                     << " and out_stride " << out_stride;
+        }
+    }
+    return ::testing::AssertionSuccess();
+}
+
+#define EXPECT_BULK_MATCHES(In, Out) EXPECT_TRUE((bulk_matches_scalar<In, Out>(#In " to " #Out)))
+
+TEST(ImageIOTest, BulkConversionIsBitExact) {
+    // To u8 and u16
+    EXPECT_BULK_MATCHES(uint8_t, uint8_t);
+    EXPECT_BULK_MATCHES(uint16_t, uint8_t);
+    EXPECT_BULK_MATCHES(uint32_t, uint8_t);
+    EXPECT_BULK_MATCHES(int8_t, uint8_t);
+    EXPECT_BULK_MATCHES(int16_t, uint8_t);
+    EXPECT_BULK_MATCHES(int32_t, uint8_t);
+    EXPECT_BULK_MATCHES(float, uint8_t);
+    EXPECT_BULK_MATCHES(double, uint8_t);
+    EXPECT_BULK_MATCHES(uint8_t, uint16_t);
+    EXPECT_BULK_MATCHES(uint16_t, uint16_t);
+    EXPECT_BULK_MATCHES(uint32_t, uint16_t);
+    EXPECT_BULK_MATCHES(int8_t, uint16_t);
+    EXPECT_BULK_MATCHES(int16_t, uint16_t);
+    EXPECT_BULK_MATCHES(int32_t, uint16_t);
+    EXPECT_BULK_MATCHES(float, uint16_t);
+    EXPECT_BULK_MATCHES(double, uint16_t);
+
+    // From u8 and u16
+    EXPECT_BULK_MATCHES(uint8_t, uint32_t);
+    EXPECT_BULK_MATCHES(uint8_t, int8_t);
+    EXPECT_BULK_MATCHES(uint8_t, int16_t);
+    EXPECT_BULK_MATCHES(uint8_t, int32_t);
+    EXPECT_BULK_MATCHES(uint8_t, float);
+    EXPECT_BULK_MATCHES(uint8_t, double);
+    EXPECT_BULK_MATCHES(uint16_t, uint32_t);
+    EXPECT_BULK_MATCHES(uint16_t, int8_t);
+    EXPECT_BULK_MATCHES(uint16_t, int16_t);
+    EXPECT_BULK_MATCHES(uint16_t, int32_t);
+    EXPECT_BULK_MATCHES(uint16_t, float);
+    EXPECT_BULK_MATCHES(uint16_t, double);
+}
+
+// Saved and loaded back, each sample goes through convert() twice.  The file keeps the
+// first stored_channels channels (all of them if 0).
+template <typename T, typename File>
+static bool round_trips(const std::string &filename, int channels, int stored_channels = 0) {
+    if (!stored_channels)
+        stored_channels = channels;
+    const int width = 67, height = 13;
+    Image<T> im(width, height, channels);
+    const std::vector<T> samples = test_samples<T>::get();
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                im(x, y, c) = samples[((c*height + y)*width + x) % samples.size()];
+
+    save(im, filename);
+    Image<T> loaded = load<T>(filename);
+    remove(filename.c_str());
+
+    if (loaded.width() != width || loaded.height() != height || loaded.channels() != stored_channels)
+        return false;
+    for (int c = 0; c < stored_channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++) {
+                File stored;
+                T expected;
+                convert(im(x, y, c), stored);
+                convert(stored, expected);
+                if (memcmp(&expected, &loaded(x, y, c), sizeof(T)) != 0)
+                    return false;
+            }
+    return true;
+}
+
+TEST(ImageIOTest, RoundTrip) {
+    EXPECT_TRUE((round_trips<uint8_t, uint8_t>("image_io_test_u8.png", 3)));
+    EXPECT_TRUE((round_trips<uint8_t, uint8_t>("image_io_test_u8a.png", 4)));
+    EXPECT_TRUE((round_trips<uint16_t, uint16_t>("image_io_test_u16.png", 3)));
+    EXPECT_TRUE((round_trips<float, uint16_t>("image_io_test_f32.png", 3)));
+    EXPECT_TRUE((round_trips<uint8_t, uint8_t>("image_io_test_u8.ppm", 3)));
+    EXPECT_TRUE((round_trips<uint16_t, uint16_t>("image_io_test_u16.ppm", 3)));
+    // PPM has no alpha: RGBA is saved as RGB
+    EXPECT_TRUE((round_trips<uint8_t, uint8_t>("image_io_test_u8a.ppm", 4, 3)));
+    EXPECT_TRUE((round_trips<uint16_t, uint16_t>("image_io_test_u16a.ppm", 4, 3)));
+}
+
+//
+// save_png with more than one thread compresses bands of rows in parallel and joins their
+// deflate streams, checksums and chunks itself; libpng must read back the saved samples.
+//
+
+template <typename T>
+static ::testing::AssertionResult png_round_trips(int width, int height, int channels, const png_options &options) {
+    Image<T> im = channels == 1 ? Image<T>(width, height) : Image<T>(width, height, channels);
+    // Smooth gradients with noise, so that every filter is a candidate for some rows
+    srand(width * 31 + height * 7 + channels);
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++) {
+                const int noise = rand() % 8;
+                const int value = (x * (c + 1) + y * 3 + noise) << (sizeof(T) == 2 ? 5 : 0);
+                (channels == 1 ? im(x, y) : im(x, y, c)) = (T)value;
+            }
+
+    const std::string filename = "image_io_test_parallel.png";
+    save_png(im, filename, options);
+    Image<T> loaded = load_png<T>(filename);
+    remove(filename.c_str());
+
+    if (loaded.width() != width || loaded.height() != height || loaded.channels() != channels)
+        return ::testing::AssertionFailure() << "loaded " << loaded.width() << "x" << loaded.height() << "x"
+                                             << loaded.channels();
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++) {
+                const T saved = channels == 1 ? im(x, y) : im(x, y, c);
+                const T read = channels == 1 ? loaded(x, y) : loaded(x, y, c);
+                if (saved != read)
+                    return ::testing::AssertionFailure() << "sample (" << x << "," << y << "," << c << ") is "
+                                                         << (int)read << " instead of " << (int)saved;
+            }
+    return ::testing::AssertionSuccess();
+}
+
+static const int png_thread_counts[] = { 2, 3, 7 };
+
+TEST(ImageIOTest, ParallelPngRoundTrip) {
+    for (int t = 0; t < 3; t++) {
+        const png_options options(Z_DEFAULT_COMPRESSION, PNG_ALL_FILTERS, -1, png_thread_counts[t]);
+        for (int channels = 1; channels <= 4; channels++) {
+            EXPECT_TRUE(png_round_trips<uint8_t>(67, 29, channels, options))
+                << "8-bit, " << channels << " channels, " << options.threads << " threads";
+            EXPECT_TRUE(png_round_trips<uint16_t>(67, 29, channels, options))
+                << "16-bit, " << channels << " channels, " << options.threads << " threads";
+        }
+    }
+}
+
+TEST(ImageIOTest, ParallelPngFewerRowsThanThreads) {
+    const png_options options(Z_DEFAULT_COMPRESSION, PNG_ALL_FILTERS, -1, 7);
+    for (int height = 1; height < 7; height++) {
+        EXPECT_TRUE(png_round_trips<uint8_t>(45, height, 3, options)) << height << " rows";
+        EXPECT_TRUE(png_round_trips<uint16_t>(45, height, 1, options)) << height << " rows";
+    }
+}
+
+// Rows wider than the 32 KB deflate window: each band's dictionary is the tail of the row above it
+TEST(ImageIOTest, ParallelPngWideRows) {
+    for (int t = 0; t < 3; t++) {
+        const png_options options(Z_DEFAULT_COMPRESSION, PNG_ALL_FILTERS, -1, png_thread_counts[t]);
+        EXPECT_TRUE(png_round_trips<uint8_t>(9000, 9, 4, options)) << options.threads << " threads";
+        EXPECT_TRUE(png_round_trips<uint16_t>(17000, 7, 1, options)) << options.threads << " threads";
+        EXPECT_TRUE(png_round_trips<uint8_t>(33000, 5, 1, options)) << options.threads << " threads";
+    }
+}
+
+TEST(ImageIOTest, ParallelPngSingleFilters) {
+    const int filters[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH,
+                            PNG_FILTER_SUB | PNG_FILTER_PAETH };
+    for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+        for (int t = 0; t < 3; t++) {
+            const png_options options(Z_DEFAULT_COMPRESSION, filters[f], -1, png_thread_counts[t]);
+            EXPECT_TRUE(png_round_trips<uint8_t>(67, 29, 3, options)) << "filters " << filters[f] << ", "
+                                                                      << options.threads << " threads";
+            EXPECT_TRUE(png_round_trips<uint16_t>(67, 29, 2, options)) << "filters " << filters[f] << ", "
+                                                                       << options.threads << " threads";
+        }
+    }
+    // Stored blocks and the highest level, which write different deflate headers
+    for (int level = 0; level <= 9; level += 9) {
+        const png_options options(level, PNG_ALL_FILTERS, -1, 3);
+        EXPECT_TRUE(png_round_trips<uint8_t>(67, 29, 4, options)) << "level " << level;
+    }
+}
+
+//
+// lz4_compress must produce blocks lz4_decompress reads back, across the boundaries of the
+// LZ4 length encoding, and lz4_decompress must reject blocks that are cut short or whose
+// lengths and offsets point outside the output.
+//
+
+static std::vector<uint8_t> random_bytes(size_t n, unsigned seed) {
+    std::vector<uint8_t> bytes(n);
+    srand(seed);
+    for (size_t i = 0; i < n; i++)
+        bytes[i] = (uint8_t)(rand() >> 4);
+    return bytes;
+}
+
+static ::testing::AssertionResult lz4_round_trips(const std::vector<uint8_t> &data) {
+    const uint8_t none = 0;
+    const uint8_t *in = data.empty() ? &none : &data[0];
+    std::vector<uint8_t> block;
+    excursions::lz4_compress(in, data.size(), block);
+    std::vector<uint8_t> out(data.size() + 1, 0xAA);
+    if (!excursions::lz4_decompress(&block[0], block.size(), &out[0], data.size()))
+        return ::testing::AssertionFailure() << data.size() << " bytes: block of " << block.size()
+                                             << " bytes rejected";
+    if (!std::equal(data.begin(), data.end(), out.begin()))
+        return ::testing::AssertionFailure() << data.size() << " bytes: decompressed bytes differ";
+    if (out[data.size()] != 0xAA)
+        return ::testing::AssertionFailure() << data.size() << " bytes: wrote past the output";
+    return ::testing::AssertionSuccess();
+}
+
+TEST(HbufTest, Lz4ShortAndIncompressible) {
+    for (size_t n = 0; n < 12; n++)
+        EXPECT_TRUE(lz4_round_trips(random_bytes(n, (unsigned)n)));
+    EXPECT_TRUE(lz4_round_trips(std::vector<uint8_t>(11, 0)));
+    EXPECT_TRUE(lz4_round_trips(std::vector<uint8_t>(12, 0)));
+    EXPECT_TRUE(lz4_round_trips(random_bytes(100000, 1)));
+}
+
+// Runs of one byte are matches at offset 1, which overlap the bytes they copy
+TEST(HbufTest, Lz4OverlappingMatches) {
+    EXPECT_TRUE(lz4_round_trips(std::vector<uint8_t>(100000, 0)));
+    std::vector<uint8_t> pattern = random_bytes(3000, 2);
+    for (size_t i = 3; i < pattern.size(); i++)
+        pattern[i] = pattern[i % 3];
+    EXPECT_TRUE(lz4_round_trips(pattern));
+}
+
+// Lengths around the points where the token's 4 bits overflow into extra bytes of 255
+// (15, 15+255 and 15+2*255).  Random bytes have no matches, so n of them are one literal run
+// of n; a literal run followed by a match of 'length' bytes repeating it may come out a few
+// literals longer, as the compressor skips ahead through incompressible data.
+TEST(HbufTest, Lz4LengthEncoding) {
+    std::vector<size_t> lengths;
+    const size_t boundaries[] = { 15, 270, 525 };
+    for (int b = 0; b < 3; b++)
+        for (size_t n = boundaries[b] - 6; n <= boundaries[b] + 10; n++)
+            lengths.push_back(n);
+    for (size_t l = 0; l < lengths.size(); l++)
+        EXPECT_TRUE(lz4_round_trips(random_bytes(lengths[l], (unsigned)l))) << lengths[l] << " literals";
+    for (size_t l = 0; l < lengths.size(); l++)
+        for (size_t m = 0; m < lengths.size(); m++) {
+            const size_t literals = lengths[l], length = lengths[m];
+            std::vector<uint8_t> data = random_bytes(literals + length + 20, (unsigned)(l * 131 + m));
+            for (size_t i = literals; i < literals + length; i++)
+                data[i] = data[i - literals];
+            EXPECT_TRUE(lz4_round_trips(data)) << literals << " literals, match of " << length;
+        }
+}
+
+TEST(HbufTest, Lz4RejectsMalformedBlocks) {
+    std::vector<uint8_t> data = random_bytes(2000, 3);
+    for (size_t i = 600; i < 1400; i++)
+        data[i] = data[i - 300];
+    std::vector<uint8_t> block;
+    excursions::lz4_compress(&data[0], data.size(), block);
+    ASSERT_LT(block.size(), data.size());
+    std::vector<uint8_t> out(data.size() + 1);
+    ASSERT_TRUE(excursions::lz4_decompress(&block[0], block.size(), &out[0], data.size()));
+
+    // Every truncation, and output sizes other than the one compressed
+    for (size_t size = 0; size < block.size(); size++)
+        EXPECT_FALSE(excursions::lz4_decompress(&block[0], size, &out[0], data.size())) << size << " bytes";
+    EXPECT_FALSE(excursions::lz4_decompress(&block[0], block.size(), &out[0], data.size() - 1));
+    EXPECT_FALSE(excursions::lz4_decompress(&block[0], block.size(), &out[0], data.size() + 1));
+
+    // The first sequence: a token, 600 literals in 15 + 255 + 255 + 75, then the match offset
+    ASSERT_EQ(0xF0, block[0] & 0xF0);
+    const size_t offset_at = 4 + 600;
+    ASSERT_EQ(300, block[offset_at] | (block[offset_at + 1] << 8));
+    std::vector<uint8_t> corrupt = block;
+    corrupt[offset_at] = corrupt[offset_at + 1] = 0;
+    EXPECT_FALSE(excursions::lz4_decompress(&corrupt[0], corrupt.size(), &out[0], data.size())) << "offset 0";
+    corrupt[offset_at] = (uint8_t)601;
+    corrupt[offset_at + 1] = (uint8_t)(601 >> 8);
+    EXPECT_FALSE(excursions::lz4_decompress(&corrupt[0], corrupt.size(), &out[0], data.size()))
+        << "offset before the output";
+    corrupt = block;
+    corrupt[3] = 76;
+    EXPECT_FALSE(excursions::lz4_decompress(&corrupt[0], corrupt.size(), &out[0], data.size()))
+        << "literals past the match";
+    corrupt = block;
+    corrupt.insert(corrupt.begin() + offset_at + 2, 255);
+    corrupt[0] |= 15;
+    EXPECT_FALSE(excursions::lz4_decompress(&corrupt[0], corrupt.size(), &out[0], data.size()))
+        << "match past the output";
+}
+
+//
+// .hbuf and .hbz files keep the mins and strides of the saved image.  Strides other than
+// those of a new Image<T> are loaded through a copy.
+//
+
+// The element at (x, y, c) of a buffer with mins
+template <typename T>
+static T &element(const Image<T> &im, int x, int y, int c) {
+    const buffer_t *buf = im.raw_buffer();
+    return ((T *)buf->host)[(x - buf->min[0]) * buf->stride[0] + (y - buf->min[1]) * buf->stride[1] +
+                            (c - buf->min[2]) * buf->stride[2]];
+}
+
+template <typename T>
+static ::testing::AssertionResult hbuf_round_trips(const std::string &filename, bool dense) {
+    const int width = 37, height = 11, channels = 3, padding = 5;
+    const int mins[3] = { -5, 7, 1 };
+    // Planar, or interleaved channels with padding at the end of each row
+    Image<T> storage = dense ? Image<T>(width, height, channels) : Image<T>((width + padding) * channels, height);
+    buffer_t view = *storage.raw_buffer();
+    if (!dense) {
+        view.extent[0] = width;
+        view.extent[1] = height;
+        view.extent[2] = channels;
+        view.stride[0] = channels;
+        view.stride[1] = (width + padding) * channels;
+        view.stride[2] = 1;
+    }
+    for (int i = 0; i < 3; i++)
+        view.min[i] = mins[i];
+    Image<T> im(Halide::Buffer(Halide::type_of<T>(), &view));
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                element(im, x + mins[0], y + mins[1], c + mins[2]) = (T)(x * 3 + y * 5 + c * 7) / (T)2;
+
+    save(im, filename);
+    Image<T> loaded = load<T>(filename);
+    remove(filename.c_str());
+
+    for (int i = 0; i < 3; i++) {
+        if (loaded.extent(i) != im.extent(i) || loaded.min(i) != mins[i])
+            return ::testing::AssertionFailure() << "dimension " << i << " loaded with min " << loaded.min(i)
+                                                 << " and extent " << loaded.extent(i);
+    }
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++) {
+                const int u = x + mins[0], v = y + mins[1], w = c + mins[2];
+                if (element(loaded, u, v, w) != element(im, u, v, w))
+                    return ::testing::AssertionFailure() << "element (" << u << "," << v << "," << w << ") is "
+                                                         << (double)element(loaded, u, v, w) << " instead of "
+                                                         << (double)element(im, u, v, w);
+            }
+    return ::testing::AssertionSuccess();
+}
+
+TEST(HbufTest, RoundTrip) {
+    for (int dense = 0; dense < 2; dense++) {
+        EXPECT_TRUE(hbuf_round_trips<uint8_t>("image_io_test_u8.hbuf", dense)) << "dense " << dense;
+        EXPECT_TRUE(hbuf_round_trips<uint8_t>("image_io_test_u8.hbz", dense)) << "dense " << dense;
+        EXPECT_TRUE(hbuf_round_trips<int16_t>("image_io_test_s16.hbz", dense)) << "dense " << dense;
+        EXPECT_TRUE(hbuf_round_trips<float>("image_io_test_f32.hbuf", dense)) << "dense " << dense;
+        EXPECT_TRUE(hbuf_round_trips<float>("image_io_test_f32.hbz", dense)) << "dense " << dense;
+    }
+}
+
+static std::vector<uint8_t> read_file(const std::string &filename) {
+    std::vector<uint8_t> bytes;
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return bytes;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(f);
+    return bytes;
+}
+
+static void write_file(const std::string &filename, const std::vector<uint8_t> &bytes) {
+    FILE *f = fopen(filename.c_str(), "wb");
+    ASSERT_TRUE(f != NULL);
+    ASSERT_EQ(bytes.size(), fwrite(&bytes[0], 1, bytes.size(), f));
+    fclose(f);
+}
+
+// A payload of more than one block: a compressed block of smooth rows, then a stored block of
+// noise.  Damaged copies of the file must fail to read.
+TEST(HbufTest, MultipleBlocks) {
+    const int width = 2100, height = 1000, channels = 3;
+    Image<uint8_t> im(width, height, channels);
+    const std::vector<uint8_t> noise = random_bytes((size_t)width * height * channels, 4);
+    for (int c = 0; c < channels; c++)
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                im(x, y, c) = c == 0 ? (uint8_t)(x + y) : noise[((size_t)c * height + y) * width + x];
+    ASSERT_GT((uint64_t)width * height * channels, 3 * (uint64_t)excursions::HBUF_BLOCK_SIZE / 2);
+
+    const std::string filename = "image_io_test_blocks.hbz";
+    save(im, filename);
+    std::vector<uint8_t> file = read_file(filename);
+    excursions::hbuf_header header;
+    ASSERT_TRUE(excursions::hbuf_read(filename, header));
+    ASSERT_EQ(2u, header.block_count);
+    uint32_t sizes[2];
+    memcpy(sizes, &file[header.payload_offset], sizeof(sizes));
+    EXPECT_EQ(0u, sizes[0] & excursions::HBUF_STORED);
+    EXPECT_EQ(excursions::HBUF_STORED, sizes[1] & excursions::HBUF_STORED);
+    EXPECT_LT(file.size(), header.payload_offset + header.raw_size);
+
+    Image<uint8_t> loaded = load<uint8_t>(filename);
+    EXPECT_EQ(0, memcmp(loaded.data(), im.data(), (size_t)width * height * channels));
+
+    std::vector<uint8_t> payload(header.raw_size);
+    std::vector<uint8_t> damaged(file.begin(), file.end() - 1);
+    write_file(filename, damaged);
+    EXPECT_FALSE(excursions::hbuf_read(filename, header, &payload[0])) << "truncated";
+    damaged = file;
+    damaged[header.payload_offset + 3] ^= 0x80;
+    write_file(filename, damaged);
+    EXPECT_FALSE(excursions::hbuf_read(filename, header, &payload[0])) << "compressed block marked stored";
+    damaged = file;
+    damaged[header.payload_offset] ^= 1;
+    write_file(filename, damaged);
+    EXPECT_FALSE(excursions::hbuf_read(filename, header, &payload[0])) << "wrong block size";
+    damaged = file;
+    damaged[0] = 'X';
+    write_file(filename, damaged);
+    EXPECT_FALSE(excursions::hbuf_read(filename, header, &payload[0])) << "bad magic";
+    remove(filename.c_str());
+}
@@ -0,0 +1,406 @@
+#ifndef __REFERENCE_H
+#define __REFERENCE_H
+
+//
+// Scalar golden references of the excursions functions, for validating optimized schedules.
+//
+// Each reference computes one output value, reference::f(in, x, y, c), from a source 'in'
+// which is anything callable as in(x, y, c): clamped(image) for an input clamped to its
+// edges (the 'padded' function of the samples), or another reference wrapped in a lambda,
+// so that chains of functions are referenced exactly as they are defined in Halide,
+// including the unclamped intermediates.  tabulate() evaluates a reference over an image:
+//
+//     Halide::Image<int32_t> expected = reference::tabulate<int32_t>(width, height, 0,
+//         [&](int x, int y, int c) { return reference::gaussian_3x3(reference::clamped(input), x, y, c); });
+//     excursions::compare_images(output, expected, excursions::image_tolerance()).print("gaussian_3x3");
+//
+// Grayscale functions ignore c.  Integer references use the same types and integer division
+// as the Halide definitions; floating-point references evaluate in the same order, but an
+// optimized schedule may still differ by a few ULPs (fused multiply-adds, vectorization).
+//
+// Not referenced:
+//  - optical_flow_pyr_lk: an iterative float solver over a list of points, which a scalar
+//    copy would only repeat step by step; optical_flow_sample.cpp measures its error on
+//    frames shifted by a known amount
+//  - gaussian_3x3_2 to gaussian_3x3_5: formulations of gaussian_3x3 kept to compare their
+//    speed; schedule_equivalence_test.cpp checks each against its own unscheduled output
+//  - bitwise_and/or/xor/not, convert_depth: a single Halide operator or cast per pixel
+//  - grad_magnitude, grad_angle, grad_direction, rgb_extract_luma: covered through
+//    canny_detector and rgb2luma, which are defined with them
+//  - convolve: convolve_benchmark.cpp compares it with the RDom convolutions it replaces
+//  - invert, scale: invert realizes a reduction of its input when it is defined, and scale
+//    is a stub
+//
+
+#include "Halide.h"
+#include "excursions.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace reference {
+
+// An image clamped to its edges
+template <typename T>
+class clamped_source {
+public:
+    clamped_source(const Halide::Image<T> &image) : image(image) {}
+    T operator()(int x, int y, int c) const {
+        x = std::max(0, std::min(x, image.width()-1));
+        y = std::max(0, std::min(y, image.height()-1));
+        return image.dimensions() == 2 ? image(x, y) : image(x, y, c);
+    }
+private:
+    Halide::Image<T> image;
+};
+
+template <typename T>
+clamped_source<T> clamped(const Halide::Image<T> &image) { return clamped_source<T>(image); }
+
+// An image of width x height (x channels, if not 0) with the values of f(x, y, c)
+template <typename R, typename F>
+Halide::Image<R> tabulate(int width, int height, int channels, F f) {
+    Halide::Image<R> image = channels ? Halide::Image<R>(width, height, channels) : Halide::Image<R>(width, height);
+    for (int c=0; c<std::max(channels, 1); c++)
+        for (int y=0; y<height; y++)
+            for (int x=0; x<width; x++) {
+                if (channels)
+                    image(x, y, c) = f(x, y, c);
+                else
+                    image(x, y) = f(x, y, 0);
+            }
+    return image;
+}
+
+//
+// Stencils
+//
+
+// sum(in(x+i, y+j) * k(i, j)) over the (2*radius+1)^2 window, in the order of Halide's RDom
+// (i innermost), accumulated in R
+template <typename R, typename Src>
+R convolve(const Src &in, const int *kernel, int radius, int x, int y, int c) {
+    const int size = 2 * radius + 1;
+    R sum = 0;
+    for (int j=-radius; j<=radius; j++)
+        for (int i=-radius; i<=radius; i++)
+            sum += (R)in(x+i, y+j, c) * (R)kernel[(j + radius) * size + i + radius];
+    return sum;
+}
+
+static const int gaussian_3x3_kernel[9] = { 1, 2, 1,  2, 4, 2,  1, 2, 1 };
+static const int gaussian_5x5_kernel[25] = { 1,  4,  6,  4, 1,
+                                             4, 16, 24, 16, 4,
+                                             6, 24, 36, 24, 6,
+                                             4, 16, 24, 16, 4,
+                                             1,  4,  6,  4, 1 };
+static const int gaussian_5x5_delta14_kernel[25] = { 2,  4,  5,  4, 2,
+                                                     4,  9, 12,  9, 4,
+                                                     5, 12, 15, 12, 5,
+                                                     4,  9, 12,  9, 4,
+                                                     2,  4,  5,  4, 2 };
+static const int box_3x3_kernel[9] = { 1, 1, 1,  1, 1, 1,  1, 1, 1 };
+static const int sobel_x_kernel[9] = { -1, 0, 1,  -2, 0, 2,  -1, 0, 1 };
+static const int sobel_y_kernel[9] = { -1, -2, -1,  0, 0, 0,  1, 2, 1 };
+static const int scharr_x_kernel[9] = { -3, 0, 3,  -10, 0, 10,  -3, 0, 3 };
+static const int scharr_y_kernel[9] = { -3, -10, -3,  0, 0, 0,  3, 10, 3 };
+static const int prewitt_x_kernel[9] = { -1, 0, 1,  -1, 0, 1,  -1, 0, 1 };
+static const int prewitt_y_kernel[9] = { -1, -1, -1,  0, 0, 0,  1, 1, 1 };
+
+template <typename Src>
+int32_t gaussian_3x3(const Src &in, int x, int y, int c) {
+    return convolve<int32_t>(in, gaussian_3x3_kernel, 1, x, y, c) / 16;
+}
+
+template <typename Src>
+int32_t gaussian_5x5(const Src &in, int x, int y, int c) {
+    return convolve<int32_t>(in, gaussian_5x5_kernel, 2, x, y, c) / 256;
+}
+
+template <typename Src>
+int32_t gaussian_5x5_delta14(const Src &in, int x, int y, int c) {
+    return convolve<int32_t>(in, gaussian_5x5_delta14_kernel, 2, x, y, c) / 159;
+}
+
+template <typename Src>
+int32_t box_3x3(const Src &in, int x, int y, int c) {
+    return convolve<int32_t>(in, box_3x3_kernel, 1, x, y, c) / 9;
+}
+
+// The (x, y) gradients of sobel_3x3, scharr_3x3 and prewitt_3x3
+template <typename Src>
+std::pair<int32_t, int32_t> sobel_3x3(const Src &in, int x, int y, int c) {
+    return std::make_pair(convolve<int32_t>(in, sobel_x_kernel, 1, x, y, c),
+                          convolve<int32_t>(in, sobel_y_kernel, 1, x, y, c));
+}
+
+template <typename Src>
+std::pair<int32_t, int32_t> scharr_3x3(const Src &in, int x, int y, int c) {
+    return std::make_pair(convolve<int32_t>(in, scharr_x_kernel, 1, x, y, c),
+                          convolve<int32_t>(in, scharr_y_kernel, 1, x, y, c));
+}
+
+template <typename Src>
+std::pair<int32_t, int32_t> prewitt_3x3(const Src &in, int x, int y, int c) {
+    return std::make_pair(convolve<int32_t>(in, prewitt_x_kernel, 1, x, y, c),
+                          convolve<int32_t>(in, prewitt_y_kernel, 1, x, y, c));
+}
+
+template <typename Src>
+auto erode_3x3(const Src &in, int x, int y, int c) -> decltype(in(x, y, c)) {
+    decltype(in(x, y, c)) value = in(x-1, y-1, c);
+    for (int j=-1; j<=1; j++)
+        for (int i=-1; i<=1; i++)
+            value = std::min(value, in(x+i, y+j, c));
+    return value;
+}
+
+template <typename Src>
+auto dilate_3x3(const Src &in, int x, int y, int c) -> decltype(in(x, y, c)) {
+    decltype(in(x, y, c)) value = in(x-1, y-1, c);
+    for (int j=-1; j<=1; j++)
+        for (int i=-1; i<=1; i++)
+            value = std::max(value, in(x+i, y+j, c));
+    return value;
+}
+
+// fast_unsharp_mask: a 3x3 convolution with float weights
+template <typename Src>
+float fast_unsharp_mask(const Src &in, float gamma, int x, int y, int c) {
+    const float v = (1.0f - gamma) / 9.0f, w = (8.0f * gamma + 1.0f) / 9.0f;
+    float sum = 0;
+    for (int j=-1; j<=1; j++)
+        for (int i=-1; i<=1; i++)
+            sum += (float)in(x+i, y+j, c) * (i == 0 && j == 0 ? w : v);
+    return sum;
+}
+
+//
+// Gradients
+//
+
+inline float grad_magnitude(float gx, float gy) {
+    return std::sqrt(std::pow(gx, 2.0f) + std::pow(gy, 2.0f));
+}
+
+inline float grad_angle(float gx, float gy) {
+    return std::atan2(gy, gx);
+}
+
+inline int grad_direction(float gx, float gy) {
+    const float theta = grad_angle(gx, gy);
+    const float PI38 = (3*M_PI/8), PI8 = (M_PI/8);
+    if (gx == 0)
+        return DIRECTION_VERTICAL;
+    if (theta < PI38 && theta > PI8)
+        return (gx > 0 && gy > 0) || (gx < 0 && gy < 0) ? DIRECTION_45DOWN : DIRECTION_45UP;
+    return theta < PI8 ? DIRECTION_HORIZONTAL : DIRECTION_VERTICAL;
+}
+
+// canny_detector, up to the gradient magnitude (what the Halide version computes so far)
+template <typename Src>
+float canny_detector(const Src &in, int x, int y) {
+    auto blur = [&](int i, int j, int c) { return gaussian_5x5_delta14(in, i, j, c); };
+    std::pair<int32_t, int32_t> g = sobel_3x3(blur, x, y, 0);
+    return grad_magnitude((float)g.first, (float)g.second);
+}
+
+//
+// Color and channels
+//
+
+template <typename Src>
+float rgb2luma(const Src &in, int x, int y) {
+    return 0.299f * in(x, y, RED) + 0.587f * in(x, y, GREEN) + 0.114f * in(x, y, BLUE);
+}
+
+template <typename Src>
+float unsharp_mask(const Src &in, const Src &avg_mask, float gamma, int x, int y, int c) {
+    return gamma * in(x, y, c) + (1.0f - gamma) * avg_mask(x, y, c);
+}
+
+// color_convert: BT.709 full range in Q14 fixed point, as functions/color_convert.cpp.
+// The Y, U, V values are those before saturation to uint8.
+struct yuv {
+    int32_t y, u, v;
+};
+
+inline int32_t q14(int32_t e) { return (e + 8192) >> 14; }
+
+inline uint8_t saturate_u8(int32_t e) { return (uint8_t)std::max(0, std::min(e, 255)); }
+
+template <typename Src>
+yuv rgb_to_yuv(const Src &in, int x, int y) {
+    const int32_t r = in(x, y, RED), g = in(x, y, GREEN), b = in(x, y, BLUE);
+    yuv p = { q14(3483 * r + 11718 * g + 1183 * b),
+              q14(-1878 * r - 6314 * g + 8192 * b) + 128,
+              q14(8192 * r - 7442 * g - 750 * b) + 128 };
+    return p;
+}
+
+// The chroma of the 2x2 block whose top-left pixel is (2x, 2y) (IYUV, NV12 and NV21)
+template <typename Src>
+yuv subsampled_chroma(const Src &in, int x, int y) {
+    const yuv p00 = rgb_to_yuv(in, 2*x, 2*y), p10 = rgb_to_yuv(in, 2*x+1, 2*y);
+    const yuv p01 = rgb_to_yuv(in, 2*x, 2*y+1), p11 = rgb_to_yuv(in, 2*x+1, 2*y+1);
+    yuv p = { 0, (p00.u + p10.u + p01.u + p11.u + 2) >> 2, (p00.v + p10.v + p01.v + p11.v + 2) >> 2 };
+    return p;
+}
+
+// Channel c of the RGB value of (y, u, v)
+inline uint8_t yuv_to_rgb(int32_t y, int32_t u, int32_t v, int c) {
+    u -= 128;
+    v -= 128;
+    return saturate_u8(c == RED ? y + q14(25802 * v) :
+                       c == GREEN ? y + q14(-3069 * u - 7669 * v) :
+                                    y + q14(30402 * u));
+}
+
+//
+// Geometric transforms
+//
+
+// Value of an image extended beyond width x height per the border mode
+template <typename T>
+T bordered(const Halide::Image<T> &in, border_mode border, T constant, int x, int y, int c) {
+    if (border == BORDER_CONSTANT && (x < 0 || x >= in.width() || y < 0 || y >= in.height()))
+        return constant;
+    return clamped(in)(x, y, c);
+}
+
+// Sample at the floating-point source location (sx, sy) as warp_affine/warp_perspective do
+template <typename T>
+T warp_sample(const Halide::Image<T> &in, float sx, float sy, interpolation_type interpolation,
+              border_mode border, T constant, int c) {
+    if (interpolation == NEAREST_NEIGHBOR)
+        return bordered(in, border, constant, (int)std::floor(sx + 0.5f), (int)std::floor(sy + 0.5f), c);
+    const float x0 = std::floor(sx), y0 = std::floor(sy);
+    const int ix = (int)x0, iy = (int)y0;
+    const float s = sx - x0, u = sy - y0;
+    float value = (1.0f-s) * (1.0f-u) * bordered(in, border, constant, ix,   iy,   c) +
+                  s * (1.0f-u)        * bordered(in, border, constant, ix+1, iy,   c) +
+                  (1.0f-s) * u        * bordered(in, border, constant, ix,   iy+1, c) +
+                  s * u               * bordered(in, border, constant, ix+1, iy+1, c);
+    if (std::numeric_limits<T>::is_integer)
+        value += 0.5f;
+    return (T)value;
+}
+
+template <typename T>
+T warp_affine(const Halide::Image<T> &in, const float m[6], interpolation_type interpolation,
+              border_mode border, T constant, int x, int y, int c) {
+    const float sx = m[0] * x + m[2] * y + m[4];
+    const float sy = m[1] * x + m[3] * y + m[5];
+    return warp_sample(in, sx, sy, interpolation, border, constant, c);
+}
+
+template <typename T>
+T warp_perspective(const Halide::Image<T> &in, const float m[9], interpolation_type interpolation,
+                   border_mode border, T constant, int x, int y, int c) {
+    const float z = m[2] * x + m[5] * y + m[8];
+    const float sx = (m[0] * x + m[3] * y + m[6]) / z;
+    const float sy = (m[1] * x + m[4] * y + m[7]) / z;
+    return warp_sample(in, sx, sy, interpolation, border, constant, c);
+}
+
+template <typename Src>
+auto nn_scale(const Src &in, float w_factor, float h_factor, int x, int y, int c) -> decltype(in(x, y, c)) {
+    return in((int)(((x + 0.5f) * w_factor) - 0.5f), (int)(((y + 0.5f) * h_factor) - 0.5f), c);
+}
+
+template <typename Src>
+uint8_t bilinear_scale(const Src &in, float w_factor, float h_factor, int x, int y, int c) {
+    const int x_lower = (int)(x * w_factor), y_lower = (int)(y * h_factor);
+    const float s = (x * w_factor) - x_lower, t = (y * h_factor) - y_lower;
+    return (uint8_t)((1-s) * (1-t) * in(x_lower,   y_lower,   c) +
+                     s * (1-t)     * in(x_lower+1, y_lower,   c) +
+                     (1-s) * t     * in(x_lower,   y_lower+1, c) +
+                     s * t         * in(x_lower+1, y_lower+1, c));
+}
+
+// warp_affine_fixed: 16.16 source coordinates and 8-bit bilinear weights, in int32
+inline int32_t fixed_16(float f) { return (int32_t)lroundf(f * 65536.0f); }
+
+template <typename T>
+T warp_affine_fixed(const Halide::Image<T> &in, const float m[6], interpolation_type interpolation,
+                    border_mode border, T constant, int x, int y, int c) {
+    const int32_t sx = fixed_16(m[0]) * x + fixed_16(m[2]) * y + fixed_16(m[4]);
+    const int32_t sy = fixed_16(m[1]) * x + fixed_16(m[3]) * y + fixed_16(m[5]);
+    if (interpolation == NEAREST_NEIGHBOR)
+        return bordered(in, border, constant, (sx + 32768) >> 16, (sy + 32768) >> 16, c);
+    const int32_t ix = sx >> 16, iy = sy >> 16, a = (sx >> 8) & 0xff, b = (sy >> 8) & 0xff;
+    const int32_t top = bordered(in, border, constant, ix, iy, c) * (256 - a) +
+                        bordered(in, border, constant, ix+1, iy, c) * a;
+    const int32_t bottom = bordered(in, border, constant, ix, iy+1, c) * (256 - a) +
+                           bordered(in, border, constant, ix+1, iy+1, c) * a;
+    return (T)((top * (256 - b) + bottom * b + 32768) >> 16);
+}
+
+template <typename Src>
+auto reflect_vert(const Src &in, int k, int width, int x, int y, int c) -> decltype(in(x, y, c)) {
+    const bool keep = k > width/2 ? x < k : x > k;
+    return keep ? in(x, y, c) : in(2*k - x, y, c);
+}
+
+// The sum of the source over [0,x] x [0,y], in uint32 as integral_image
+template <typename Src>
+uint32_t integral_image(const Src &in, int x, int y, int c) {
+    uint32_t sum = 0;
+    for (int j=0; j<=y; j++)
+        for (int i=0; i<=x; i++)
+            sum += (uint32_t)in(i, j, c);
+    return sum;
+}
+
+// Level l+1 of gaussian_pyramid, from level l (the input image for l=0)
+template <typename T>
+int32_t gaussian_pyramid_level(const Halide::Image<T> &previous, int x, int y) {
+    return gaussian_5x5(clamped(previous), 2*x, 2*y, 0);
+}
+
+//
+// Pixelwise arithmetic, for integer types of up to 16 bits (computed in int32_t like the
+// Halide versions)
+//
+
+template <typename T>
+T narrow(int64_t value, convert_policy policy) {
+    if (policy == CONVERT_POLICY_SATURATE)
+        value = std::max<int64_t>(std::numeric_limits<T>::min(), std::min<int64_t>(value, std::numeric_limits<T>::max()));
+    return (T)value;
+}
+
+template <typename T>
+T add(T a, T b, convert_policy policy) { return narrow<T>((int64_t)a + b, policy); }
+
+template <typename T>
+T subtract(T a, T b, convert_policy policy) { return narrow<T>((int64_t)a - b, policy); }
+
+template <typename T>
+T abs_diff(T a, T b) { return narrow<T>(a > b ? (int64_t)a - b : (int64_t)b - a, CONVERT_POLICY_SATURATE); }
+
+// In float for 8-bit types and in double otherwise, as functions/pixelwise.cpp
+template <typename T>
+T multiply(T a, T b, float scale, convert_policy policy, rounding_policy rounding) {
+    typedef typename std::conditional<sizeof(T) == 1, float, double>::type F;
+    F product = (F)a * (F)b * (F)scale;
+    if (rounding == ROUND_TO_NEAREST_EVEN)
+        product = std::nearbyint(product);
+    return narrow<T>((int64_t)product, policy);
+}
+
+template <typename T>
+T threshold_binary(T a, T threshold, T true_value, T false_value) {
+    return a > threshold ? true_value : false_value;
+}
+
+template <typename T>
+T threshold_range(T a, T lower, T upper, T true_value, T false_value) {
+    return a > upper || a < lower ? false_value : true_value;
+}
+
+} // namespace reference
+
+#endif // __REFERENCE_H
@@ -0,0 +1,394 @@
+#include <Halide.h>
+#include <limits>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "tests/reference.h"
+
+#include "gtest/gtest.h"
+
+//
+// Every function checked against its scalar reference (tests/reference.h) on odd-sized
+// random images, so that vector tails and image edges are exercised.
+//
+
+static bool verbose = false;
+
+static const int width = 37, height = 29;
+
+template <typename T>
+static bool matches(const char *name, const Halide::Image<T> &output, const Halide::Image<T> &expected,
+                    const excursions::image_tolerance &tol = excursions::image_tolerance()) {
+    excursions::image_comparison result = excursions::compare_images(output, expected, tol);
+    if (!result.match || verbose)
+        result.print(name);
+    return result.match;
+}
+
+class ReferenceTest : public ::testing::Test {
+protected:
+    ReferenceTest() : gray(width, height, "gray"), rgb(width, height, 3, "rgb") {
+        excursions::randomize(gray);
+        excursions::randomize(rgb);
+        Halide::Var x,y,c;
+        gray_in(x,y) = gray(clamp(x, 0, width-1), clamp(y, 0, height-1));
+        rgb_in(x,y,c) = rgb(clamp(x, 0, width-1), clamp(y, 0, height-1), c);
+        gray32(x,y) = Halide::cast<int32_t>(gray_in(x,y));
+        rgb32(x,y,c) = Halide::cast<int32_t>(rgb_in(x,y,c));
+    }
+
+    Halide::Image<uint8_t> gray, rgb;
+    Halide::Func gray_in, rgb_in;       // clamped uint8 inputs
+    Halide::Func gray32, rgb32;         // clamped int32 inputs
+};
+
+TEST_F(ReferenceTest, Gaussian) {
+    Halide::Image<int32_t> g3 = gaussian_3x3(rgb32).realize(width, height, 3);
+    Halide::Image<int32_t> g3t = gaussian_3x3<3>(rgb32, SpecializeSched(8)).realize(width, height, 3);
+    Halide::Image<int32_t> g3_ref = reference::tabulate<int32_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::gaussian_3x3(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("gaussian_3x3", g3, g3_ref));
+    EXPECT_TRUE(matches("gaussian_3x3<3>", g3t, g3_ref));
+
+    Halide::Image<int32_t> g3g = gaussian_3x3(gray32, true).realize(width, height);
+    Halide::Image<int32_t> g3g_ref = reference::tabulate<int32_t>(width, height, 0,
+        [&](int x, int y, int c) { return reference::gaussian_3x3(reference::clamped(gray), x, y, c); });
+    EXPECT_TRUE(matches("gaussian_3x3 gray", g3g, g3g_ref));
+
+    Halide::Image<int32_t> g5 = gaussian_5x5(rgb32).realize(width, height, 3);
+    Halide::Image<int32_t> g5_ref = reference::tabulate<int32_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::gaussian_5x5(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("gaussian_5x5", g5, g5_ref));
+
+    Halide::Image<int32_t> d14 = gaussian_5x5_delta14(gray32, true).realize(width, height);
+    Halide::Image<int32_t> d14_ref = reference::tabulate<int32_t>(width, height, 0,
+        [&](int x, int y, int c) { return reference::gaussian_5x5_delta14(reference::clamped(gray), x, y, c); });
+    EXPECT_TRUE(matches("gaussian_5x5_delta14", d14, d14_ref));
+}
+
+TEST_F(ReferenceTest, BoxErodeDilate) {
+    Halide::Image<int32_t> box = box_3x3(rgb32).realize(width, height, 3);
+    Halide::Image<int32_t> box_ref = reference::tabulate<int32_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::box_3x3(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("box_3x3", box, box_ref));
+
+    Halide::Image<uint8_t> erode = erode_3x3(rgb_in).realize(width, height, 3);
+    Halide::Image<uint8_t> erode_ref = reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::erode_3x3(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("erode_3x3", erode, erode_ref));
+
+    Halide::Image<uint8_t> dilate = dilate_3x3(rgb_in).realize(width, height, 3);
+    Halide::Image<uint8_t> dilate_ref = reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::dilate_3x3(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("dilate_3x3", dilate, dilate_ref));
+}
+
+TEST_F(ReferenceTest, Gradients) {
+    typedef std::pair<Halide::Func, Halide::Func> gradients;
+    const char *names[] = { "sobel_3x3", "scharr_3x3", "prewitt_3x3" };
+    gradients g[] = { sobel_3x3(gray32, true), scharr_3x3(gray32, true), prewitt_3x3(gray32, true) };
+    for (int i=0; i<3; i++) {
+        Halide::Image<int32_t> gx = g[i].first.realize(width, height);
+        Halide::Image<int32_t> gy = g[i].second.realize(width, height);
+        Halide::Image<int32_t> gx_ref = reference::tabulate<int32_t>(width, height, 0, [&](int x, int y, int c) {
+            std::pair<int32_t, int32_t> r = i == 0 ? reference::sobel_3x3(reference::clamped(gray), x, y, c) :
+                                            i == 1 ? reference::scharr_3x3(reference::clamped(gray), x, y, c) :
+                                                     reference::prewitt_3x3(reference::clamped(gray), x, y, c);
+            return r.first;
+        });
+        Halide::Image<int32_t> gy_ref = reference::tabulate<int32_t>(width, height, 0, [&](int x, int y, int c) {
+            std::pair<int32_t, int32_t> r = i == 0 ? reference::sobel_3x3(reference::clamped(gray), x, y, c) :
+                                            i == 1 ? reference::scharr_3x3(reference::clamped(gray), x, y, c) :
+                                                     reference::prewitt_3x3(reference::clamped(gray), x, y, c);
+            return r.second;
+        });
+        EXPECT_TRUE(matches(names[i], gx, gx_ref));
+        EXPECT_TRUE(matches(names[i], gy, gy_ref));
+    }
+
+    // The magnitude is a float square root: allow a few ULPs
+    Halide::Image<float> canny = canny_detector(gray32, true).realize(width, height);
+    Halide::Image<float> canny_ref = reference::tabulate<float>(width, height, 0,
+        [&](int x, int y, int) { return reference::canny_detector(reference::clamped(gray), x, y); });
+    EXPECT_TRUE(matches("canny_detector", canny, canny_ref, excursions::image_tolerance(1e-4, 4)));
+}
+
+TEST_F(ReferenceTest, UnsharpAndLuma) {
+    Halide::Image<float> unsharp = fast_unsharp_mask(rgb32, 5.0f).realize(width, height, 3);
+    Halide::Image<float> unsharp_ref = reference::tabulate<float>(width, height, 3,
+        [&](int x, int y, int c) { return reference::fast_unsharp_mask(reference::clamped(rgb), 5.0f, x, y, c); });
+    EXPECT_TRUE(matches("fast_unsharp_mask", unsharp, unsharp_ref, excursions::image_tolerance(1e-3, 16)));
+
+    Halide::Image<float> luma = rgb2luma(rgb_in).realize(width, height, 3);
+    Halide::Image<float> luma_ref = reference::tabulate<float>(width, height, 3,
+        [&](int x, int y, int) { return reference::rgb2luma(reference::clamped(rgb), x, y); });
+    EXPECT_TRUE(matches("rgb2luma", luma, luma_ref, excursions::image_tolerance(1e-4, 4)));
+}
+
+TEST_F(ReferenceTest, Geometry) {
+    // 20 degrees around the center, partly outside the input
+    const float theta = 20 * (float)M_PI / 180, cs = cosf(theta), sn = sinf(theta);
+    const float cx = width / 2.0f, cy = height / 2.0f;
+    const float m[6] = { cs, -sn, sn, cs, cx - cs * cx - sn * cy, cy + sn * cx - cs * cy };
+    const interpolation_type modes[] = { NEAREST_NEIGHBOR, BILINEAR };
+    for (int i=0; i<2; i++) {
+        Halide::Image<uint8_t> warp = warp_affine(rgb_in, width, height, m, modes[i], BORDER_CONSTANT, 7).realize(width, height, 3);
+        Halide::Image<uint8_t> warp_ref = reference::tabulate<uint8_t>(width, height, 3, [&](int x, int y, int c) {
+            return reference::warp_affine<uint8_t>(rgb, m, modes[i], BORDER_CONSTANT, 7, x, y, c);
+        });
+        // Contracted multiply-adds may move a sample across a rounding boundary
+        EXPECT_TRUE(matches("warp_affine", warp, warp_ref, excursions::image_tolerance(1)));
+    }
+
+    // The same rotation in fixed point, with the fixed-point rounding of the reference
+    for (int i=0; i<2; i++) {
+        Halide::Image<uint8_t> warp = warp_affine_fixed(rgb_in, width, height, m, modes[i], BORDER_CONSTANT, 7).realize(width, height, 3);
+        Halide::Image<uint8_t> warp_ref = reference::tabulate<uint8_t>(width, height, 3, [&](int x, int y, int c) {
+            return reference::warp_affine_fixed<uint8_t>(rgb, m, modes[i], BORDER_CONSTANT, 7, x, y, c);
+        });
+        EXPECT_TRUE(matches("warp_affine_fixed", warp, warp_ref));
+    }
+
+    const float p[9] = { 1.0f, 0.02f, 0.001f, -0.05f, 0.9f, 0.0005f, 2.0f, 1.0f, 1.0f };
+    Halide::Image<uint8_t> persp = warp_perspective(gray_in, width, height, p, BILINEAR, BORDER_REPLICATE, 0, true).realize(width, height);
+    Halide::Image<uint8_t> persp_ref = reference::tabulate<uint8_t>(width, height, 0, [&](int x, int y, int c) {
+        return reference::warp_perspective<uint8_t>(gray, p, BILINEAR, BORDER_REPLICATE, 0, x, y, c);
+    });
+    EXPECT_TRUE(matches("warp_perspective", persp, persp_ref, excursions::image_tolerance(1)));
+
+    const int w2 = width * 2 / 3, h2 = height * 2 / 3;
+    const float wf = (float)width / w2, hf = (float)height / h2;
+    Halide::Image<uint8_t> nn = nn_scale(rgb_in, wf, hf).realize(w2, h2, 3);
+    Halide::Image<uint8_t> nn_ref = reference::tabulate<uint8_t>(w2, h2, 3,
+        [&](int x, int y, int c) { return reference::nn_scale(reference::clamped(rgb), wf, hf, x, y, c); });
+    EXPECT_TRUE(matches("nn_scale", nn, nn_ref));
+
+    Halide::Image<uint8_t> bilinear = bilinear_scale(rgb_in, wf, hf).realize(w2, h2, 3);
+    Halide::Image<uint8_t> bilinear_ref = reference::tabulate<uint8_t>(w2, h2, 3,
+        [&](int x, int y, int c) { return reference::bilinear_scale(reference::clamped(rgb), wf, hf, x, y, c); });
+    EXPECT_TRUE(matches("bilinear_scale", bilinear, bilinear_ref, excursions::image_tolerance(1)));
+
+    Halide::Image<uint8_t> reflect = reflect_vert(rgb_in, 25, width).realize(width, height, 3);
+    Halide::Image<uint8_t> reflect_ref = reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::reflect_vert(reference::clamped(rgb), 25, width, x, y, c); });
+    EXPECT_TRUE(matches("reflect_vert", reflect, reflect_ref));
+}
+
+TEST_F(ReferenceTest, Pyramid) {
+    const int levels = 3;
+    std::vector<Halide::Func> pyramid = gaussian_pyramid(gray32, width, height, levels);
+    Halide::Image<int32_t> previous = Halide::Image<int32_t>(gray32.realize(width, height));
+    int w = width, h = height;
+    for (int l=1; l<levels; l++) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        Halide::Image<int32_t> level = pyramid[l].realize(w, h);
+        Halide::Image<int32_t> level_ref = reference::tabulate<int32_t>(w, h, 0,
+            [&](int x, int y, int) { return reference::gaussian_pyramid_level(previous, x, y); });
+        EXPECT_TRUE(matches(("gaussian_pyramid level " + std::to_string(l)).c_str(), level, level_ref));
+        previous = level_ref;
+    }
+}
+
+TEST_F(ReferenceTest, Integral) {
+    Halide::Image<uint32_t> integral = integral_image(rgb_in, width, height).realize(width, height, 3);
+    Halide::Image<uint32_t> integral_ref = reference::tabulate<uint32_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::integral_image(reference::clamped(rgb), x, y, c); });
+    EXPECT_TRUE(matches("integral_image", integral, integral_ref));
+}
+
+// RGB to NV12 and YUV4, and NV12 back to RGB, on the largest even size (the chroma of
+// NV12 is sub-sampled by 2 in both directions)
+TEST_F(ReferenceTest, ColorConvert) {
+    const int w = width & ~1, h = height & ~1;
+    image_planes nv12 = color_convert(image_planes(1, rgb_in), FORMAT_RGB, FORMAT_NV12);
+    Halide::Image<uint8_t> luma = nv12[0].realize(w, h);
+    Halide::Image<uint8_t> uv = nv12[1].realize(2, w/2, h/2);
+    Halide::Image<uint8_t> luma_ref = reference::tabulate<uint8_t>(w, h, 0, [&](int x, int y, int) {
+        return reference::saturate_u8(reference::rgb_to_yuv(reference::clamped(rgb), x, y).y);
+    });
+    // uv(c, x, y): c is the first dimension
+    Halide::Image<uint8_t> uv_ref = reference::tabulate<uint8_t>(2, w/2, h/2, [&](int c, int x, int y) {
+        const reference::yuv chroma = reference::subsampled_chroma(reference::clamped(rgb), x, y);
+        return reference::saturate_u8(c == 0 ? chroma.u : chroma.v);
+    });
+    EXPECT_TRUE(matches("color_convert RGB to NV12 Y", luma, luma_ref));
+    EXPECT_TRUE(matches("color_convert RGB to NV12 UV", uv, uv_ref));
+
+    image_planes yuv4 = color_convert(image_planes(1, rgb_in), FORMAT_RGB, FORMAT_YUV4);
+    Halide::Image<uint8_t> u = yuv4[1].realize(w, h), v = yuv4[2].realize(w, h);
+    Halide::Image<uint8_t> u_ref = reference::tabulate<uint8_t>(w, h, 0, [&](int x, int y, int) {
+        return reference::saturate_u8(reference::rgb_to_yuv(reference::clamped(rgb), x, y).u);
+    });
+    Halide::Image<uint8_t> v_ref = reference::tabulate<uint8_t>(w, h, 0, [&](int x, int y, int) {
+        return reference::saturate_u8(reference::rgb_to_yuv(reference::clamped(rgb), x, y).v);
+    });
+    EXPECT_TRUE(matches("color_convert RGB to YUV4 U", u, u_ref));
+    EXPECT_TRUE(matches("color_convert RGB to YUV4 V", v, v_ref));
+
+    Halide::Func luma_in, uv_in;
+    Halide::Var x,y,c;
+    luma_in(x,y) = luma_ref(x,y);
+    uv_in(c,x,y) = uv_ref(c,x,y);
+    image_planes src;
+    src.push_back(luma_in);
+    src.push_back(uv_in);
+    Halide::Image<uint8_t> back = color_convert(src, FORMAT_NV12, FORMAT_RGB)[0].realize(w, h, 3);
+    Halide::Image<uint8_t> back_ref = reference::tabulate<uint8_t>(w, h, 3, [&](int x, int y, int c) {
+        return reference::yuv_to_rgb(luma_ref(x, y), uv_ref(0, x/2, y/2), uv_ref(1, x/2, y/2), c);
+    });
+    EXPECT_TRUE(matches("color_convert NV12 to RGB", back, back_ref));
+}
+
+TEST_F(ReferenceTest, Channels) {
+    Halide::Image<uint8_t> green = channel_extract(rgb_in, GREEN).realize(width, height);
+    Halide::Image<uint8_t> green_ref = reference::tabulate<uint8_t>(width, height, 0,
+        [&](int x, int y, int) { return rgb(x, y, GREEN); });
+    EXPECT_TRUE(matches("channel_extract", green, green_ref));
+
+    Halide::Image<uint8_t> bgr = channel_combine(channel_extract(rgb_in, BLUE), channel_extract(rgb_in, GREEN),
+                                                 channel_extract(rgb_in, RED)).realize(width, height, 3);
+    Halide::Image<uint8_t> bgr_ref = reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return rgb(x, y, 2 - c); });
+    EXPECT_TRUE(matches("channel_combine", bgr, bgr_ref));
+}
+
+// Random values over the whole range of T, with the extremes in the first pixels
+template <typename T>
+static Halide::Image<T> full_range(unsigned seed) {
+    Halide::Image<T> image(width, height, 3);
+    srand(seed);
+    const int64_t lo = std::numeric_limits<T>::min(), span = (int64_t)std::numeric_limits<T>::max() - lo + 1;
+    for (int c=0; c<3; c++)
+        for (int y=0; y<height; y++)
+            for (int x=0; x<width; x++)
+                image(x, y, c) = (T)(lo + rand() % span);
+    for (int c=0; c<3; c++) {
+        image(0, 0, c) = std::numeric_limits<T>::max();
+        image(1, 0, c) = std::numeric_limits<T>::min();
+    }
+    return image;
+}
+
+// Products of 16-bit values exceed int32 and the 24 bits of a float mantissa
+template <typename T>
+static void expect_multiply_matches(const char *type) {
+    Halide::Image<T> a = full_range<T>(1), b = full_range<T>(2);
+    Halide::Func fa, fb;
+    Halide::Var x,y,c;
+    fa(x,y,c) = a(x,y,c);
+    fb(x,y,c) = b(x,y,c);
+    const float scales[] = { 1.0f, 1/255.0f, 1/32768.0f };
+    const convert_policy policies[] = { CONVERT_POLICY_WRAP, CONVERT_POLICY_SATURATE };
+    const rounding_policy roundings[] = { ROUND_TO_ZERO, ROUND_TO_NEAREST_EVEN };
+    for (int s=0; s<3; s++)
+        for (int p=0; p<2; p++)
+            for (int r=0; r<2; r++) {
+                Halide::Image<T> product = to_func(multiply(pixel(fa), pixel(fb), scales[s], policies[p], roundings[r]))
+                                               .realize(width, height, 3);
+                EXPECT_TRUE(matches("multiply", product, reference::tabulate<T>(width, height, 3, [&](int x, int y, int c) {
+                    return reference::multiply<T>(a(x,y,c), b(x,y,c), scales[s], policies[p], roundings[r]);
+                }))) << type << ", scale " << scales[s] << ", policy " << policies[p] << ", rounding " << roundings[r];
+                if (scales[s] == 1.0f && policies[p] == CONVERT_POLICY_SATURATE) {
+                    // max * max, and min * min: 0 unsigned, or positive and out of range signed
+                    const T min_squared = std::numeric_limits<T>::is_signed ? std::numeric_limits<T>::max() : 0;
+                    EXPECT_EQ(std::numeric_limits<T>::max(), product(0, 0, 0)) << type;
+                    EXPECT_EQ(min_squared, product(1, 0, 0)) << type;
+                }
+            }
+}
+
+TEST_F(ReferenceTest, Pixelwise) {
+    Halide::Image<uint8_t> other(width, height, 3);
+    excursions::init_monotonic(other);
+    Halide::Func b;
+    Halide::Var x,y,c;
+    b(x,y,c) = other(x,y,c);
+    PixelExpr pa = pixel(rgb_in), pb = pixel(b);
+
+    const convert_policy policies[] = { CONVERT_POLICY_WRAP, CONVERT_POLICY_SATURATE };
+    for (int i=0; i<2; i++) {
+        const convert_policy policy = policies[i];
+        Halide::Image<uint8_t> sum = to_func(add(pa, pb, policy)).realize(width, height, 3);
+        Halide::Image<uint8_t> difference = to_func(subtract(pa, pb, policy)).realize(width, height, 3);
+        Halide::Image<uint8_t> product = to_func(multiply(pa, pb, 1/64.0f, policy, ROUND_TO_NEAREST_EVEN)).realize(width, height, 3);
+        EXPECT_TRUE(matches("add", sum, reference::tabulate<uint8_t>(width, height, 3,
+            [&](int x, int y, int c) { return reference::add<uint8_t>(rgb(x,y,c), other(x,y,c), policy); })));
+        EXPECT_TRUE(matches("subtract", difference, reference::tabulate<uint8_t>(width, height, 3,
+            [&](int x, int y, int c) { return reference::subtract<uint8_t>(rgb(x,y,c), other(x,y,c), policy); })));
+        EXPECT_TRUE(matches("multiply", product, reference::tabulate<uint8_t>(width, height, 3, [&](int x, int y, int c) {
+            return reference::multiply<uint8_t>(rgb(x,y,c), other(x,y,c), 1/64.0f, policy, ROUND_TO_NEAREST_EVEN);
+        })));
+    }
+    expect_multiply_matches<uint16_t>("uint16");
+    expect_multiply_matches<int16_t>("int16");
+
+    Halide::Image<uint8_t> diff = to_func(abs_diff(pa, pb)).realize(width, height, 3);
+    EXPECT_TRUE(matches("abs_diff", diff, reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::abs_diff<uint8_t>(rgb(x,y,c), other(x,y,c)); })));
+
+    Halide::Image<uint8_t> binary = to_func(threshold_binary(pa, 100, 255, 0)).realize(width, height, 3);
+    EXPECT_TRUE(matches("threshold_binary", binary, reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::threshold_binary<uint8_t>(rgb(x,y,c), 100, 255, 0); })));
+
+    Halide::Image<uint8_t> range = to_func(threshold_range(pa, 50, 200, 255, 0)).realize(width, height, 3);
+    EXPECT_TRUE(matches("threshold_range", range, reference::tabulate<uint8_t>(width, height, 3,
+        [&](int x, int y, int c) { return reference::threshold_range<uint8_t>(rgb(x,y,c), 50, 200, 255, 0); })));
+}
+
+TEST(CompareImagesTest, StridesAndTolerance) {
+    Halide::Image<float> planar(16, 8, 3), storage;
+    excursions::init_monotonic(planar);
+    Halide::Image<float> interleaved(excursions::interleaved_buffer(storage, 16, 8, 3));
+    for (int c=0; c<3; c++)
+        for (int y=0; y<8; y++)
+            for (int x=0; x<16; x++)
+                interleaved(x, y, c) = planar(x, y, c);
+    EXPECT_TRUE(excursions::compare_images(planar, interleaved));
+
+    interleaved(5, 6, 2) = std::nextafter(planar(5, 6, 2), 1e9f);
+    interleaved(9, 1, 1) = planar(9, 1, 1) + 0.5f;
+    excursions::image_comparison exact = excursions::compare_images(planar, interleaved, excursions::image_tolerance());
+    EXPECT_FALSE(exact.match);
+    EXPECT_EQ(2u, exact.mismatches);
+    EXPECT_EQ(0.5, exact.max_error);
+    EXPECT_EQ(9, exact.max_error_at[0]);
+    EXPECT_EQ(1, exact.max_error_at[1]);
+    EXPECT_EQ(1, exact.max_error_at[2]);
+
+    excursions::image_comparison ulps = excursions::compare_images(planar, interleaved, excursions::image_tolerance(0, 1));
+    EXPECT_EQ(1u, ulps.mismatches);
+    EXPECT_TRUE(excursions::compare_images(planar, interleaved, excursions::image_tolerance(0.5)).match);
+}
+
+TEST(CompareImagesTest, NaN) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    Halide::Image<float> expected(16, 8, 3), storage;
+    excursions::init_monotonic(expected);
+    Halide::Image<float> actual(excursions::interleaved_buffer(storage, 16, 8, 3));
+    for (int c=0; c<3; c++)
+        for (int y=0; y<8; y++)
+            for (int x=0; x<16; x++)
+                actual(x, y, c) = expected(x, y, c);
+
+    // A NaN result against a finite expected value, whatever the tolerance.  The first
+    // mismatch is the first one in x, y, c order, not in the interleaved memory order.
+    actual(2, 1, 2) = nan;
+    actual(5, 1, 0) = nan;
+    const excursions::image_tolerance loose(1e9, 1 << 30);
+    excursions::image_comparison result = excursions::compare_images(actual, expected, loose);
+    EXPECT_FALSE(result.match);
+    EXPECT_EQ(2u, result.mismatches);
+    EXPECT_EQ(5, result.first_mismatch_at[0]);
+    EXPECT_EQ(1, result.first_mismatch_at[1]);
+    EXPECT_EQ(0, result.first_mismatch_at[2]);
+
+    // A finite result against a NaN expected value
+    EXPECT_FALSE(excursions::compare_images(expected, actual, loose).match);
+
+    // NaN against NaN
+    expected(2, 1, 2) = nan;
+    expected(5, 1, 0) = nan;
+    EXPECT_TRUE(excursions::compare_images(actual, expected));
+    EXPECT_TRUE(excursions::compare_images(actual, expected, excursions::image_tolerance(0, 4)).match);
+}
@@ -0,0 +1,198 @@
+#include <Halide.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "excursions.h"
+#include "utils/utils.h"
+
+#include "gtest/gtest.h"
+
+//
+// Every scheduler policy registered in sched_policy.h (for_each_sched_policy) applied to every
+// function that takes a Scheduler, on sizes that are not multiples of the vector widths or
+// of the tile sizes.  A schedule may only change the speed of a function, so the output of
+// each policy must be bit-identical to the unscheduled one.  Functions with more parameters
+// are checked with fixed values of them: a rotation for the warps, and IYUV to RGB for
+// color_convert.
+//
+
+typedef Halide::Func (*scheduled_function)(Halide::Func, const Scheduler &);
+// For the functions that also take the size of the input
+typedef Halide::Func (*sized_function)(Halide::Func, Halide::Expr width, Halide::Expr height, const Scheduler &);
+
+struct function_entry {
+    const char *name;
+    scheduled_function function;
+    sized_function sized;
+};
+
+// 10 degrees around (40, 20), partly outside the input
+static const float rotation[6] = { 0.98481f, -0.17365f, 0.17365f, 0.98481f, -2.8653f, 7.2498f };
+static const float perspective[9] = { 1.0f, 0.02f, 0.0005f, -0.05f, 0.9f, 0.0002f, 2.0f, 1.0f, 1.0f };
+
+static Halide::Func gaussian_3x3_rgb(Halide::Func in, const Scheduler &s) {
+    return gaussian_3x3(in, false, s);
+}
+
+static Halide::Func warp_affine_rotated(Halide::Func in, Halide::Expr width, Halide::Expr height, const Scheduler &s) {
+    return warp_affine(in, width, height, rotation, BILINEAR, BORDER_CONSTANT, 7, false, s);
+}
+
+static Halide::Func warp_affine_fixed_rotated(Halide::Func in, Halide::Expr width, Halide::Expr height,
+                                              const Scheduler &s) {
+    Halide::Func in8;
+    Halide::Var x,y,c;
+    in8(x,y,c) = Halide::cast<uint8_t>(in(x,y,c));
+    return warp_affine_fixed(in8, width, height, rotation, BILINEAR, BORDER_CONSTANT, 7, false, s);
+}
+
+static Halide::Func warp_perspective_tilted(Halide::Func in, Halide::Expr width, Halide::Expr height,
+                                            const Scheduler &s) {
+    return warp_perspective(in, width, height, perspective, BILINEAR, BORDER_REPLICATE, 0, false, s);
+}
+
+// The three channels of the input as the Y, U and V planes of an IYUV image, to RGB
+static Halide::Func iyuv_to_rgb(Halide::Func in, const Scheduler &s) {
+    Halide::Func y_plane, u_plane, v_plane;
+    Halide::Var x,y;
+    y_plane(x,y) = in(x,y,0);
+    u_plane(x,y) = in(x,y,1);
+    v_plane(x,y) = in(x,y,2);
+    image_planes iyuv;
+    iyuv.push_back(y_plane);
+    iyuv.push_back(u_plane);
+    iyuv.push_back(v_plane);
+    return color_convert(iyuv, FORMAT_IYUV, FORMAT_RGB, s)[0];
+}
+
+static const function_entry functions[] = {
+    { "gaussian_3x3<3>", gaussian_3x3<3> },
+    { "gaussian_5x5<3>", gaussian_5x5<3> },
+    { "box_3x3<3>", box_3x3<3> },
+    { "gaussian_3x3_2", gaussian_3x3_2 },
+    { "gaussian_3x3_3", gaussian_3x3_3 },
+    { "gaussian_3x3_4", gaussian_3x3_4 },
+    { "gaussian_3x3_5", gaussian_3x3_5 },
+    { "gaussian_3x3(bool)", gaussian_3x3_rgb },
+    { "color_convert", iyuv_to_rgb },
+    { "warp_affine", NULL, warp_affine_rotated },
+    { "warp_affine_fixed", NULL, warp_affine_fixed_rotated },
+    { "warp_perspective", NULL, warp_perspective_tilted },
+};
+
+// The tiled policies split x by up to 256 and y by up to 32, so no size is smaller
+struct size_entry {
+    int width, height;
+};
+
+static std::vector<size_entry> test_sizes() {
+    const size_entry fixed[] = {
+        { 256, 32 }, { 257, 33 }, { 263, 37 }, { 301, 64 }, { 511, 45 },
+    };
+    std::vector<size_entry> sizes(fixed, fixed + sizeof(fixed) / sizeof(fixed[0]));
+    srand(1234);
+    for (int i=0; i<3; i++) {
+        size_entry s = { 256 + rand() % 384, 32 + rand() % 64 };
+        sizes.push_back(s);
+    }
+    return sizes;
+}
+
+class ScheduleEquivalenceTest : public ::testing::TestWithParam<function_entry> {
+protected:
+    ScheduleEquivalenceTest() : input(Halide::UInt(8), 3, "input") {
+        Halide::Var x,y,c;
+        clamped(x,y,c) = Halide::cast<int32_t>(input(clamp(x, 0, input.width()-1),
+                                                     clamp(y, 0, input.height()-1), c));
+    }
+
+    Halide::Func make(const function_entry &entry, const Scheduler &s) {
+        return entry.function ? entry.function(clamped, s) : entry.sized(clamped, input.width(), input.height(), s);
+    }
+
+    Halide::ImageParam input;
+    Halide::Func clamped;
+};
+
+// warp_affine_fixed and color_convert produce uint8, the others the int32 of their input
+static excursions::image_comparison compare_outputs(Halide::Buffer output, Halide::Buffer expected) {
+    if (output.type() == Halide::UInt(8))
+        return excursions::compare_images(Halide::Image<uint8_t>(output), Halide::Image<uint8_t>(expected),
+                                          excursions::image_tolerance());
+    return excursions::compare_images(Halide::Image<int32_t>(output), Halide::Image<int32_t>(expected),
+                                      excursions::image_tolerance());
+}
+
+TEST_P(ScheduleEquivalenceTest, BitIdentical) {
+    const function_entry entry = GetParam();
+    const std::vector<size_entry> sizes = test_sizes();
+
+    std::vector<Halide::Image<uint8_t> > inputs;
+    std::vector<Halide::Buffer> expected;
+    Halide::Func unscheduled = make(entry, NoPSched());
+    for (size_t i=0; i<sizes.size(); i++) {
+        Halide::Image<uint8_t> in(sizes[i].width, sizes[i].height, 3);
+        excursions::randomize(in);
+        // Saturated pixels in the first image, for the largest intermediate sums
+        if (i == 0)
+            for (int y=0; y<in.height(); y++)
+                for (int x=0; x<in.width(); x++)
+                    for (int c=0; c<3; c++)
+                        in(x, y, c) = 255;
+        input.set(in);
+        inputs.push_back(in);
+        expected.push_back(unscheduled.realize(in.width(), in.height(), 3)[0]);
+    }
+
+    int policies = 0;
+    for_each_sched_policy([&](const std::string &policy, const Scheduler &s) {
+        Halide::Func f = make(entry, s);
+        for (size_t i=0; i<inputs.size(); i++) {
+            input.set(inputs[i]);
+            Halide::Buffer output = f.realize(inputs[i].width(), inputs[i].height(), 3)[0];
+            excursions::image_comparison result = compare_outputs(output, expected[i]);
+            if (!result.match)
+                result.print((std::string(entry.name) + " " + policy).c_str());
+            EXPECT_TRUE(result.match) << entry.name << " with " << policy << " at "
+                                      << inputs[i].width() << "x" << inputs[i].height();
+        }
+        policies++;
+    });
+    EXPECT_GT(policies, 1);
+}
+
+INSTANTIATE_TEST_CASE_P(AllFunctions, ScheduleEquivalenceTest, ::testing::ValuesIn(functions));
+
+// A misspelled or undefined variable makes a schedule file invalid, instead of scheduling a
+// variable the Func does not have
+TEST(FileSchedTest, UnknownVariables) {
+    std::istringstream defined("output split y y yi 8\n"
+                               "output parallel y\n"
+                               "output vectorize x v\n"
+                               "producer compute_at output yi\n");
+    EXPECT_TRUE(FileSched(defined, "defined").valid());
+
+    std::istringstream misspelled("output vectorize xx v\n");
+    EXPECT_FALSE(FileSched(misspelled, "misspelled").valid());
+    std::istringstream before_split("output parallel yo\n"
+                                    "output split y yo yi 8\n");
+    EXPECT_FALSE(FileSched(before_split, "before_split").valid());
+    std::istringstream other_stage("producer split x xo xi 8\n"
+                                   "output vectorize xi\n");
+    EXPECT_FALSE(FileSched(other_stage, "other_stage").valid());
+    std::istringstream consumer("producer compute_at output yi\n");
+    EXPECT_FALSE(FileSched(consumer, "consumer").valid());
+}
+
+// c is a valid name, but not a variable of a two-dimensional Func
+TEST(FileSchedTest, ApplyErrors) {
+    std::istringstream in("output vectorize c\n");
+    FileSched sched(in, "apply");
+    EXPECT_TRUE(sched.valid());
+    Halide::Func f;
+    Halide::Var x,y;
+    f(x,y) = x + y;
+    sched.schedule(f, x, y);
+    EXPECT_FALSE(sched.valid());
+}
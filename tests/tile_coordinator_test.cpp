@@ -0,0 +1,40 @@
+#include <Halide.h>
+#include <string>
+#include "excursions.h"
+#include "utils/utils.h"
+#include "utils/roi.h"
+#include "utils/tile_coordinator.h"
+
+#include "gtest/gtest.h"
+
+//
+// Tiled multi-process execution must give the output of a single realization of the whole
+// image, however many tiles there are.
+//
+
+// More tiles than the pipes of the coordinator can hold indices (16K on Linux), so the
+// coordinator must collect the finished tiles while it dispatches
+TEST(TileCoordinatorTest, ManySmallTiles) {
+    const int width = 300, height = 240, tile = 2;
+    excursions::shared_image<uint8_t> image(width, height), result(width, height);
+    ASSERT_TRUE(image.valid() && result.valid());
+    Halide::Image<uint8_t> pixels = image.image();
+    excursions::randomize(pixels);
+
+    excursions::roi_input in(Halide::UInt(8), 2);
+    Halide::Var x,y;
+    Halide::Func wide, out("blurred");
+    wide(x,y) = Halide::cast<int32_t>(in.clamped()(x,y));
+    Halide::Func blurred = gaussian_3x3<2>(wide);
+    out(x,y) = Halide::cast<uint8_t>(clamp(blurred(x,y), 0, 255));
+    out.compile_jit();
+
+    Halide::Image<uint8_t> reference(width, height);
+    const excursions::rect frame = { 0, 0, width, height };
+    excursions::roi_pipeline(in, out).realize(image.buffer(), frame, reference);
+
+    excursions::tile_coordinator coordinator(in, out, tile, tile, 4, 1);
+    ASSERT_TRUE(coordinator.run(image.buffer(), result.buffer()));
+    EXPECT_EQ((width / tile) * (height / tile), coordinator.get_stats().tiles);
+    EXPECT_TRUE(excursions::compare_images(result.image(), reference));
+}
@@ -0,0 +1,248 @@
+#ifndef __BUFFER_POOL_H
+#define __BUFFER_POOL_H
+
+//
+// A pool of image buffers, recycled by size class.
+//
+// Memory is requested from the system once per buffer, and returned to a free list of its
+// size class (a power of two, at least 4KB) when released, so a pipeline which is run
+// repeatedly on frames of the same size stops allocating pixel memory after the first frame.
+// The bookkeeping of a pooled_image (its record and the Halide::Buffer describing it) is
+// recycled as well, so creating and destroying pooled images does not touch the heap once
+// the pool is warm.  Func::realize() itself still makes a few small allocations per call,
+// for its argument lists; buffer_pool_sample counts them.
+// The pool serves two kinds of clients:
+//  - user-facing images:      excursions::pooled_image<uint8_t> out(width, height, 3);
+//                             f.realize(out.buffer());
+//  - pipeline intermediates:  excursions::use_buffer_pool(f);
+//                             (installs pool_malloc/pool_free as the custom allocator of f,
+//                             which every compute_root/compute_at allocation goes through)
+//
+
+#include "Halide.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace excursions {
+
+class buffer_pool {
+public:
+    struct stats {
+        uint64_t requests;          // allocations requested from the pool
+        uint64_t hits;              // requests served from a free list
+        uint64_t system_allocs;     // requests which went to the system allocator
+        size_t in_use;              // bytes (size-class rounded) handed out and not yet released
+        size_t footprint;           // bytes owned by the pool: in use + cached in free lists
+        size_t peak_footprint;
+
+        double hit_rate() const { return requests ? (double)hits / requests : 0; }
+        void print(const char *title) const {
+            printf("%s: %llu requests, hit rate %.1f%%, %llu system allocations, footprint %.1f MB (peak %.1f MB)\n",
+                   title, (unsigned long long)requests, 100.0 * hit_rate(), (unsigned long long)system_allocs,
+                   footprint / (1024.0 * 1024.0), peak_footprint / (1024.0 * 1024.0));
+        }
+    };
+
+    buffer_pool() : free_lists(num_classes) {
+        memset(&counters, 0, sizeof(counters));
+    }
+
+    ~buffer_pool() {
+        for (size_t c=0; c<free_lists.size(); c++)
+            for (size_t i=0; i<free_lists[c].size(); i++)
+                free(free_lists[c][i]);
+        for (size_t i=0; i<free_records.size(); i++)
+            delete free_records[i];
+    }
+
+    // The bookkeeping of a pooled_image: a reference count, its pixels, and a Halide::Buffer
+    // wrapping them.  Records are recycled with their Buffer, which a later image of the same
+    // type rewrites in place instead of allocating a new one.
+    struct image_record {
+        std::atomic<int> refs;
+        void *data;
+        Halide::Buffer buffer;
+    };
+
+    image_record *acquire_record() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free_records.empty()) {
+                image_record *record = free_records.back();
+                free_records.pop_back();
+                return record;
+            }
+        }
+        return new image_record();
+    }
+
+    void release_record(image_record *record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_records.push_back(record);
+    }
+
+    // Returns a buffer of at least 'size' bytes, aligned to 'alignment' bytes
+    void *allocate(size_t size) {
+        const int size_class = class_of(size + alignment);
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.requests++;
+        void *block;
+        if (!free_lists[size_class].empty()) {
+            counters.hits++;
+            block = free_lists[size_class].back();
+            free_lists[size_class].pop_back();
+        } else {
+            if (posix_memalign(&block, alignment, class_size(size_class)) != 0)
+                return NULL;
+            counters.system_allocs++;
+            counters.footprint += class_size(size_class);
+            counters.peak_footprint = std::max(counters.peak_footprint, counters.footprint);
+        }
+        counters.in_use += class_size(size_class);
+        // The size class is kept in front of the returned (aligned) pointer
+        *(int *)block = size_class;
+        return (uint8_t *)block + alignment;
+    }
+
+    void release(void *ptr) {
+        if (!ptr)
+            return;
+        void *block = (uint8_t *)ptr - alignment;
+        const int size_class = *(int *)block;
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.in_use -= class_size(size_class);
+        free_lists[size_class].push_back(block);
+    }
+
+    // Return all cached buffers to the system
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t c=0; c<free_lists.size(); c++) {
+            for (size_t i=0; i<free_lists[c].size(); i++) {
+                free(free_lists[c][i]);
+                counters.footprint -= class_size(c);
+            }
+            free_lists[c].clear();
+        }
+    }
+
+    stats get_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    void reset_stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.requests = counters.hits = counters.system_allocs = 0;
+        counters.peak_footprint = counters.footprint;
+    }
+
+    // The pool used by pool_malloc/pool_free
+    static buffer_pool &global() {
+        static buffer_pool pool;
+        return pool;
+    }
+
+private:
+    buffer_pool(const buffer_pool &);
+    buffer_pool &operator=(const buffer_pool &);
+
+    static const size_t alignment = 64;         // cache line, and more than Halide's 32 bytes
+    static const int min_class_bits = 12;       // 4KB
+    static const int num_classes = 64 - min_class_bits;
+
+    static size_t class_size(int size_class) { return (size_t)1 << (size_class + min_class_bits); }
+    static int class_of(size_t size) {
+        int size_class = 0;
+        while (class_size(size_class) < size)
+            size_class++;
+        return size_class;
+    }
+
+    std::mutex mutex;
+    std::vector<std::vector<void *> > free_lists;
+    std::vector<image_record *> free_records;
+    stats counters;
+};
+
+// Custom Halide allocator backed by buffer_pool::global()
+inline void *pool_malloc(void *user_context, size_t size) {
+    return buffer_pool::global().allocate(size);
+}
+
+inline void pool_free(void *user_context, void *ptr) {
+    buffer_pool::global().release(ptr);
+}
+
+// Allocate the intermediate buffers of f from the global pool
+inline void use_buffer_pool(Halide::Func f) {
+    f.set_custom_allocator(pool_malloc, pool_free);
+}
+
+// A dense, planar image whose pixels come from a buffer pool and go back to it when the
+// last copy of the pooled_image is destroyed
+template <typename T>
+class pooled_image {
+public:
+    pooled_image() : pool(NULL), record(NULL) {}
+    pooled_image(int width, int height, int channels = 0, buffer_pool &pool = buffer_pool::global())
+        : pool(&pool), record(pool.acquire_record()) {
+        record->refs = 1;
+        record->data = pool.allocate((size_t)width * height * std::max(channels, 1) * sizeof(T));
+        buffer_t buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.host = (uint8_t *)record->data;
+        buf.elem_size = sizeof(T);
+        buf.extent[0] = width;      buf.stride[0] = 1;
+        buf.extent[1] = height;     buf.stride[1] = width;
+        buf.extent[2] = channels;   buf.stride[2] = channels ? width * height : 0;
+        if (record->buffer.defined() && record->buffer.type() == Halide::type_of<T>())
+            *record->buffer.raw_buffer() = buf;
+        else
+            record->buffer = Halide::Buffer(Halide::type_of<T>(), &buf);
+    }
+    pooled_image(const pooled_image &other) : pool(other.pool), record(other.record) {
+        if (record)
+            record->refs++;
+    }
+    pooled_image &operator=(const pooled_image &other) {
+        if (other.record)
+            other.record->refs++;
+        release();
+        pool = other.pool;
+        record = other.record;
+        return *this;
+    }
+    ~pooled_image() { release(); }
+
+    bool defined() const { return record != NULL; }
+    int width() const { return record->buffer.extent(0); }
+    int height() const { return record->buffer.extent(1); }
+    int channels() const { return record->buffer.extent(2); }
+    T *data() const { return (T *)record->data; }
+
+    // Views of the pixels; they are valid while this pooled_image (or a copy) is alive
+    Halide::Buffer buffer() const { return record->buffer; }
+    Halide::Image<T> image() const { return Halide::Image<T>(buffer()); }
+
+private:
+    void release() {
+        if (record && --record->refs == 0) {
+            pool->release(record->data);
+            pool->release_record(record);
+        }
+        record = NULL;
+    }
+
+    buffer_pool *pool;
+    buffer_pool::image_record *record;
+};
+
+} // namespace excursions
+
+#endif // __BUFFER_POOL_H
@@ -5,14 +5,20 @@
 
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <limits>
 #include <string>
+#include <cmath>
+#include <cassert>
+#include <stdio.h>
+#include <stdint.h>
 
 #define __DEBUG printf
 
 #ifdef _WIN32
 extern "C" bool QueryPerformanceCounter(uint64_t *);
 extern "C" bool QueryPerformanceFrequency(uint64_t *);
-double current_time() {
+inline double current_time() {
     uint64_t t, freq;
     QueryPerformanceCounter(&t);
     QueryPerformanceFrequency(&freq);
@@ -20,7 +26,7 @@ double current_time() {
 }
 #else
 #include <sys/time.h>
-double current_time() {
+inline double current_time() {
     static bool first_call = true;
     static timeval reference_time;
     if (first_call) {
@@ -45,52 +51,54 @@ public:
         samples.push_back(duration);
     }
 
+    // Returns the mean duration after discarding the two fastest and the two slowest samples
+    // (all of them if there are 4 or fewer).  The samples are kept, so mean() can be called
+    // again and dump() lists every sample.
     double mean(double &std_dev) {
-        max = std::numeric_limits<float>::min();
-        min = std::numeric_limits<float>::max();
-
-        auto imax = std::max_element(samples.begin(), samples.end());
-        auto imin = std::min_element(samples.begin(), samples.end());
-        __DEBUG("here1-1\n");
-        samples.erase(imin);
-        samples.erase(imax);
-        __DEBUG("here1-2\n");
-        imax = std::max_element(samples.begin(), samples.end());
-        imin = std::min_element(samples.begin(), samples.end());
-        __DEBUG("here1-2-1\n");
-        samples.erase(imin);
-        samples.erase(imax);
-        __DEBUG("here1-3\n");
-        min = *imin;
-        max = *imin;
-
-        double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
-        double mean = sum / samples.size();
-        __DEBUG("here1-4\n");
-
-        std::vector<double> diff(samples.size());
-        std::transform(samples.begin(), samples.end(), diff.begin(), std::bind2nd(std::minus<double>(), mean));
-        double sq_sum = std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
-        std_dev = std::sqrt(sq_sum / samples.size());
+        std::vector<double> trimmed(samples);
+        std::sort(trimmed.begin(), trimmed.end());
+        if (trimmed.size() > 4)
+            trimmed = std::vector<double>(trimmed.begin() + 2, trimmed.end() - 2);
+        if (trimmed.empty()) {
+            std_dev = 0;
+            return 0;
+        }
+        min = trimmed.front();
+        max = trimmed.back();
+
+        double sum = std::accumulate(trimmed.begin(), trimmed.end(), 0.0);
+        double mean = sum / trimmed.size();
+
+        double sq_sum = 0;
+        for (size_t i=0; i<trimmed.size(); i++)
+            sq_sum += (trimmed[i] - mean) * (trimmed[i] - mean);
+        std_dev = std::sqrt(sq_sum / trimmed.size());
         return mean;
     }
 
+    // Text appended to the report written by dump(), such as the per-stage table of a
+    // stage_profile (profiler.h)
+    void add_section(const std::string &text) {
+        sections.push_back(text);
+    }
+
     void dump() {
         FILE *fd = fopen("dump.txt", "w");
         assert(fd);
         fprintf(fd, "%s - %lu\n", desc.c_str(), samples.size());
         for (size_t i=0; i<samples.size(); i++) 
             fprintf(fd, "%f\n", samples[i]);
-        __DEBUG("here1\n");
         double dev = 0;
         double m = mean(dev);
-        __DEBUG("here2\n");
         fprintf(fd, "mean=%f std_dev=%f\n", m, dev);
+        for (size_t i=0; i<sections.size(); i++)
+            fprintf(fd, "\n%s", sections[i].c_str());
         fclose(fd);
     }
 
 private:
     std::vector<double> samples; 
+    std::vector<std::string> sections;
     double min, max;
     std::string desc;
 };
@@ -102,4 +110,145 @@ struct interval {
   ~interval() { t.add(current_time() - start); }
 };
 
+//
+// Hardware performance counters (Linux perf_event).
+//
+// perf_counters counts CPU cycles, retired instructions, last-level cache references and
+// misses between start() and stop().  The counters are inherited by threads created after
+// they are opened, so open them before the first parallel realize (or call
+// halide_shutdown_thread_pool() first) to include Halide's worker threads.
+// When the counters are not permitted (see /proc/sys/kernel/perf_event_paranoid) or not
+// supported, available() is false and stop() returns a sample with valid == false.
+//
+struct perf_sample {
+    bool valid;
+    uint64_t cycles, instructions, cache_references, cache_misses;
+
+    double ipc() const { return cycles ? (double)instructions / cycles : 0; }
+    double cache_miss_rate() const { return cache_references ? (double)cache_misses / cache_references : 0; }
+    // Every last-level cache miss moves one cache line from (or to) memory
+    double memory_bytes() const { return cache_misses * 64.0; }
+};
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+
+class perf_counters {
+public:
+    perf_counters() {
+        const uint64_t configs[num_counters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                 PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES };
+        for (int i=0; i<num_counters; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+    }
+
+    ~perf_counters() {
+        for (int i=0; i<num_counters; i++)
+            if (fds[i] >= 0)
+                close(fds[i]);
+    }
+
+    bool available() const {
+        for (int i=0; i<num_counters; i++)
+            if (fds[i] < 0)
+                return false;
+        return true;
+    }
+
+    void start() {
+        for (int i=0; i<num_counters; i++) {
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    perf_sample stop() {
+        uint64_t values[num_counters] = { 0 };
+        bool valid = available();
+        for (int i=0; i<num_counters; i++) {
+            if (fds[i] < 0)
+                continue;
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            // value, time enabled, time running: scale up when the counter was multiplexed
+            uint64_t data[3];
+            if (read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0) {
+                valid = false;
+                continue;
+            }
+            values[i] = data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+        }
+        perf_sample sample = { valid, values[0], values[1], values[2], values[3] };
+        return sample;
+    }
+
+private:
+    static const int num_counters = 4;
+    int fds[num_counters];
+};
+#else
+class perf_counters {
+public:
+    bool available() const { return false; }
+    void start() {}
+    perf_sample stop() {
+        perf_sample sample = { false, 0, 0, 0, 0 };
+        return sample;
+    }
+};
+#endif // __linux__
+
+// Accumulates the counters of several runs
+class perf_timings {
+public:
+    perf_timings() : runs(0) {
+        total.valid = true;
+        total.cycles = total.instructions = total.cache_references = total.cache_misses = 0;
+    }
+
+    void add(const perf_sample &sample) {
+        total.valid = total.valid && sample.valid;
+        total.cycles += sample.cycles;
+        total.instructions += sample.instructions;
+        total.cache_references += sample.cache_references;
+        total.cache_misses += sample.cache_misses;
+        runs++;
+    }
+
+    bool valid() const { return runs > 0 && total.valid; }
+    double ipc() const { return total.ipc(); }
+    double cache_miss_rate() const { return total.cache_miss_rate(); }
+    // Mean memory traffic per run, divided by the number of pixels processed per run
+    double bytes_per_pixel(double pixels) const { return runs ? total.memory_bytes() / runs / pixels : 0; }
+    double cycles_per_pixel(double pixels) const { return runs ? (double)total.cycles / runs / pixels : 0; }
+
+private:
+    perf_sample total;
+    int runs;
+};
+
+// Counts the hardware events of a scope, like interval does for its duration
+struct perf_interval {
+    perf_counters &counters;
+    perf_timings &t;
+    perf_interval(perf_counters &counters, perf_timings &t) : counters(counters), t(t) { counters.start(); }
+    ~perf_interval() { t.add(counters.stop()); }
+};
+
 #endif // __CLOCK_H
\ No newline at end of file
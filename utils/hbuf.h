@@ -0,0 +1,330 @@
+#ifndef __HBUF_H
+#define __HBUF_H
+
+//
+// A binary container for Halide buffers, for intermediates passed between pipeline stages
+// or cached on disk.
+//
+// The file holds a buffer_t as it is in memory: its element type, dimensions, mins, extents
+// and strides, and the elements at the offsets given by the strides (the host memory from
+// the first to the last element, padding included).  The payload starts on a 4 KB
+// boundary, so an uncompressed file can be mmap'ed and used in place with no conversion
+// (see mapped_image.h), and read() straight into an image otherwise.
+//
+// The payload may be compressed with a fast LZ77 compressor producing LZ4 blocks (the LZ4
+// block format, without the frame): it is split into blocks of HBUF_BLOCK_SIZE bytes
+// compressed independently, and a block that does not shrink is stored as is.
+//
+// Layout (little-endian):
+//     hbuf_header, zero padded to payload_offset
+//     uncompressed: the raw_size bytes of the payload
+//     compressed: uint32_t sizes[block_count] of the blocks, then the blocks; the top bit
+//                 of a size marks a stored block
+//
+// load<T>() and save() of image_io.h read and write .hbuf (uncompressed) and .hbz
+// (compressed) files.  Like image_io.h, this header needs buffer_t, from Halide.h or
+// static_image.h.
+//
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace excursions {
+
+enum hbuf_compression {
+    HBUF_NONE = 0,
+    HBUF_LZ4 = 1
+};
+
+static const uint32_t HBUF_ALIGNMENT = 4096;
+static const uint32_t HBUF_BLOCK_SIZE = 1 << 22;
+static const uint32_t HBUF_STORED = 0x80000000u;
+
+struct hbuf_header {
+    char magic[8];              // "EXCHBUF1"
+    uint32_t payload_offset;    // a multiple of HBUF_ALIGNMENT
+    uint8_t type_code;          // 0=int, 1=uint, 2=float, as halide_type_code
+    uint8_t type_bits;
+    uint8_t dimensions;
+    uint8_t compression;        // hbuf_compression
+    int32_t min[4], extent[4], stride[4];
+    uint64_t raw_size;          // bytes of the uncompressed payload
+    uint64_t stored_size;       // bytes of the payload in the file
+    uint32_t block_count;
+    char reserved[44];
+};
+
+// The type code and bits of the element type T
+template <typename T>
+inline void hbuf_type_of(uint8_t &code, uint8_t &bits) {
+    code = !std::numeric_limits<T>::is_integer ? 2 : std::numeric_limits<T>::is_signed ? 0 : 1;
+    bits = sizeof(T) * 8;
+}
+
+// A header for 'buf', whose elements are of the given type; returns false if a stride
+// is negative
+inline bool hbuf_describe(const buffer_t &buf, uint8_t type_code, uint8_t type_bits,
+                          hbuf_compression compression, hbuf_header &header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "EXCHBUF1", 8);
+    header.payload_offset = HBUF_ALIGNMENT;
+    header.type_code = type_code;
+    header.type_bits = type_bits;
+    header.compression = compression;
+    uint64_t span = 1;
+    for (int i=0; i<4 && buf.extent[i] > 0; i++) {
+        if (buf.stride[i] < 0)
+            return false;
+        header.dimensions = i + 1;
+        header.min[i] = buf.min[i];
+        header.extent[i] = buf.extent[i];
+        header.stride[i] = buf.stride[i];
+        span += (uint64_t)(buf.extent[i] - 1) * buf.stride[i];
+    }
+    header.raw_size = span * (type_bits / 8);
+    header.stored_size = header.raw_size;
+    return true;
+}
+
+// LZ4 block compression of n bytes into 'out', greedy with a single-entry hash table.
+// The last 5 bytes are literals and the last match starts at least 12 bytes from the end,
+// as the LZ4 format requires.
+inline void lz4_compress(const uint8_t *in, size_t n, std::vector<uint8_t> &out) {
+    const int hash_bits = 14;
+    const size_t min_match = 4, last_literals = 5, match_limit = 12;
+    std::vector<uint32_t> table(1 << hash_bits, 0);
+    out.clear();
+    out.reserve(n + n / 255 + 16);
+
+    size_t ip = 0, anchor = 0;
+    uint32_t misses = 0;
+    while (n >= match_limit && ip + match_limit <= n) {
+        uint32_t sequence;
+        memcpy(&sequence, in + ip, 4);
+        const uint32_t h = (sequence * 2654435761u) >> (32 - hash_bits);
+        const size_t ref = table[h];
+        table[h] = (uint32_t)ip;
+        uint32_t candidate;
+        memcpy(&candidate, in + ref, 4);
+        if (ref >= ip || ip - ref > 65535 || candidate != sequence) {
+            // Skip faster through incompressible data
+            ip += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+        size_t length = min_match;
+        while (ip + length < n - last_literals && in[ref + length] == in[ip + length])
+            length++;
+
+        const size_t literals = ip - anchor;
+        out.push_back((uint8_t)((std::min(literals, (size_t)15) << 4) | std::min(length - min_match, (size_t)15)));
+        if (literals >= 15) {
+            size_t rest = literals - 15;
+            for (; rest >= 255; rest -= 255)
+                out.push_back(255);
+            out.push_back((uint8_t)rest);
+        }
+        out.insert(out.end(), in + anchor, in + ip);
+        const size_t offset = ip - ref;
+        out.push_back((uint8_t)offset);
+        out.push_back((uint8_t)(offset >> 8));
+        if (length - min_match >= 15) {
+            size_t rest = length - min_match - 15;
+            for (; rest >= 255; rest -= 255)
+                out.push_back(255);
+            out.push_back((uint8_t)rest);
+        }
+        ip += length;
+        anchor = ip;
+    }
+
+    const size_t literals = n - anchor;
+    out.push_back((uint8_t)(std::min(literals, (size_t)15) << 4));
+    if (literals >= 15) {
+        size_t rest = literals - 15;
+        for (; rest >= 255; rest -= 255)
+            out.push_back(255);
+        out.push_back((uint8_t)rest);
+    }
+    out.insert(out.end(), in + anchor, in + n);
+}
+
+// Decompresses an LZ4 block of 'size' bytes into exactly n bytes; returns false if the
+// block is malformed
+inline bool lz4_decompress(const uint8_t *in, size_t size, uint8_t *out, size_t n) {
+    const uint8_t *end = in + size;
+    size_t op = 0;
+    while (in < end) {
+        const uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t b;
+            do {
+                if (in >= end)
+                    return false;
+                b = *in++;
+                literals += b;
+            } while (b == 255);
+        }
+        if ((size_t)(end - in) < literals || n - op < literals)
+            return false;
+        memcpy(out + op, in, literals);
+        in += literals;
+        op += literals;
+        if (in == end)
+            break;      // the last sequence has no match
+
+        if (end - in < 2)
+            return false;
+        const size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t length = (token & 15) + 4;
+        if ((token & 15) == 15) {
+            uint8_t b;
+            do {
+                if (in >= end)
+                    return false;
+                b = *in++;
+                length += b;
+            } while (b == 255);
+        }
+        if (offset == 0 || offset > op || n - op < length)
+            return false;
+        // Matches may overlap their output
+        const uint8_t *match = out + op - offset;
+        if (offset >= length) {
+            memcpy(out + op, match, length);
+        } else {
+            for (size_t i=0; i<length; i++)
+                out[op + i] = match[i];
+        }
+        op += length;
+    }
+    return op == n;
+}
+
+// Writes the elements of 'buf' and its header to 'filename'
+inline bool hbuf_write(const std::string &filename, const buffer_t &buf, uint8_t type_code,
+                       uint8_t type_bits, hbuf_compression compression = HBUF_NONE) {
+    hbuf_header header;
+    if (!hbuf_describe(buf, type_code, type_bits, compression, header)) {
+        fprintf(stderr, "hbuf: %s: negative strides are not supported\n", filename.c_str());
+        return false;
+    }
+    const uint8_t *payload = buf.host;
+
+    std::vector<uint32_t> sizes;
+    std::vector<std::vector<uint8_t> > blocks;
+    if (compression == HBUF_LZ4) {
+        header.block_count = (uint32_t)((header.raw_size + HBUF_BLOCK_SIZE - 1) / HBUF_BLOCK_SIZE);
+        header.stored_size = header.block_count * sizeof(uint32_t);
+        blocks.resize(header.block_count);
+        for (uint32_t b=0; b<header.block_count; b++) {
+            const uint64_t first = (uint64_t)b * HBUF_BLOCK_SIZE;
+            const size_t n = (size_t)std::min<uint64_t>(HBUF_BLOCK_SIZE, header.raw_size - first);
+            lz4_compress(payload + first, n, blocks[b]);
+            if (blocks[b].size() >= n) {
+                blocks[b].assign(payload + first, payload + first + n);
+                sizes.push_back((uint32_t)n | HBUF_STORED);
+            } else {
+                sizes.push_back((uint32_t)blocks[b].size());
+            }
+            header.stored_size += blocks[b].size();
+        }
+    }
+
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "hbuf: could not create %s\n", filename.c_str());
+        return false;
+    }
+    std::vector<char> padded(header.payload_offset, 0);
+    memcpy(&padded[0], &header, sizeof(header));
+    bool ok = fwrite(&padded[0], 1, padded.size(), f) == padded.size();
+    if (compression == HBUF_LZ4) {
+        ok = ok && fwrite(&sizes[0], sizeof(uint32_t), sizes.size(), f) == sizes.size();
+        for (size_t b=0; b<blocks.size() && ok; b++)
+            ok = fwrite(&blocks[b][0], 1, blocks[b].size(), f) == blocks[b].size();
+    } else {
+        ok = ok && fwrite(payload, 1, header.raw_size, f) == header.raw_size;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "hbuf: could not write %s\n", filename.c_str());
+    return ok;
+}
+
+// Whether a type code and bits (as in hbuf_header) describe an element type: an integer of
+// 8, 16, 32 or 64 bits, or a float or double
+inline bool hbuf_type_valid(int code, int bits) {
+    if (code == 2)
+        return bits == 32 || bits == 64;
+    return (code == 0 || code == 1) && (bits == 8 || bits == 16 || bits == 32 || bits == 64);
+}
+
+// Checks the header of an hbuf file of 'size' bytes
+inline bool hbuf_valid(const hbuf_header &header, uint64_t size) {
+    if (memcmp(header.magic, "EXCHBUF1", 8) != 0 || header.payload_offset % HBUF_ALIGNMENT != 0 ||
+        header.dimensions < 1 || header.dimensions > 4 ||
+        !hbuf_type_valid(header.type_code, header.type_bits) || header.compression > HBUF_LZ4 ||
+        header.payload_offset + header.stored_size > size)
+        return false;
+    uint64_t span = 1;
+    for (int i=0; i<header.dimensions; i++) {
+        if (header.extent[i] <= 0 || header.stride[i] < 0)
+            return false;
+        span += (uint64_t)(header.extent[i] - 1) * header.stride[i];
+    }
+    return span * (header.type_bits / 8) == header.raw_size &&
+           (header.compression != HBUF_NONE || header.stored_size == header.raw_size);
+}
+
+// Reads the header of 'filename', and its payload decompressed into 'payload' (which must
+// have room for header.raw_size bytes) if payload is not NULL
+inline bool hbuf_read(const std::string &filename, hbuf_header &header, uint8_t *payload = NULL) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) {
+        fprintf(stderr, "hbuf: could not open %s\n", filename.c_str());
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && hbuf_valid(header, size) &&
+              fseek(f, header.payload_offset, SEEK_SET) == 0;
+    if (ok && payload) {
+        if (header.compression == HBUF_NONE) {
+            ok = fread(payload, 1, header.raw_size, f) == header.raw_size;
+        } else {
+            std::vector<uint32_t> sizes(header.block_count);
+            std::vector<uint8_t> block;
+            ok = header.block_count == (header.raw_size + HBUF_BLOCK_SIZE - 1) / HBUF_BLOCK_SIZE &&
+                 fread(&sizes[0], sizeof(uint32_t), sizes.size(), f) == sizes.size();
+            for (uint32_t b=0; b<header.block_count && ok; b++) {
+                const uint64_t first = (uint64_t)b * HBUF_BLOCK_SIZE;
+                const size_t n = (size_t)std::min<uint64_t>(HBUF_BLOCK_SIZE, header.raw_size - first);
+                const size_t stored = sizes[b] & ~HBUF_STORED;
+                if (sizes[b] & HBUF_STORED) {
+                    ok = stored == n && fread(payload + first, 1, n, f) == n;
+                } else {
+                    block.resize(stored);
+                    ok = fread(&block[0], 1, stored, f) == stored &&
+                         lz4_decompress(&block[0], stored, payload + first, n);
+                }
+            }
+        }
+    }
+    fclose(f);
+    if (!ok)
+        fprintf(stderr, "hbuf: %s is not a valid hbuf file\n", filename.c_str());
+    return ok;
+}
+
+} // namespace excursions
+
+#endif // __HBUF_H
@@ -0,0 +1,93 @@
+#ifndef __IMAGE_BATCH_H
+#define __IMAGE_BATCH_H
+
+//
+// Batches of same-size images, stacked along a 4th dimension so that a whole batch is
+// processed by one realize call:
+//
+//     excursions::image_batch<uint8_t> in(64, 64, 3, 256), out(64, 64, 3, 256);
+//     for (int n=0; n<256; n++)
+//         in.set(n, thumbnails[n]);
+//     input.set(in.buffer());              // a 4D ImageParam
+//     f.realize(out.buffer());             // f defined over image_coords<4>, see BatchSched
+//     Halide::Image<uint8_t> first = out.image(0);
+//
+// Pixel (x,y,c) of image n is at (x,y,c,n); grayscale images are stacked with one channel.
+// buffer(first, count) is a view of a range of the batch, and image(n) a view of one
+// image, so the images can also be written and read in place without copies.
+//
+
+#include "Halide.h"
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+namespace excursions {
+
+template <typename T>
+class image_batch {
+public:
+    image_batch() {}
+    image_batch(int width, int height, int channels, int count)
+        : images(width, height, std::max(channels, 1), count) {}
+
+    // A batch holding a copy of 'list', which must all have the same size
+    image_batch(const std::vector<Halide::Image<T> > &list)
+        : images(list[0].width(), list[0].height(), std::max(list[0].channels(), 1), (int)list.size()) {
+        for (size_t n=0; n<list.size(); n++)
+            set(n, list[n]);
+    }
+
+    int width() const { return images.width(); }
+    int height() const { return images.height(); }
+    int channels() const { return images.channels(); }
+    int count() const { return images.extent(3); }
+
+    // The whole (x,y,c,n) batch
+    Halide::Buffer buffer() const { return images; }
+
+    // A view of images [first, first+count) of the batch, as a batch of 'count' images;
+    // valid while this batch is alive
+    Halide::Buffer buffer(int first, int count) const {
+        buffer_t buf = *images.raw_buffer();
+        buf.host += (size_t)first * buf.stride[3] * sizeof(T);
+        buf.extent[3] = count;
+        return Halide::Buffer(Halide::type_of<T>(), &buf);
+    }
+
+    // A view of image n: 3D, or 2D if the batch has one channel; valid while this batch is alive
+    Halide::Image<T> image(int n) const {
+        buffer_t buf = *images.raw_buffer();
+        buf.host += (size_t)n * buf.stride[3] * sizeof(T);
+        buf.extent[3] = buf.stride[3] = 0;
+        if (buf.extent[2] == 1)
+            buf.extent[2] = buf.stride[2] = 0;
+        return Halide::Image<T>(Halide::Buffer(Halide::type_of<T>(), &buf));
+    }
+
+    // Copy 'image' (2D or 3D, of the batch size) into slot n
+    void set(int n, const Halide::Image<T> &image) {
+        const int planes = std::max(image.channels(), 1);
+        for (int c=0; c<planes; c++)
+            for (int y=0; y<height(); y++) {
+                T *dst = &images(0, y, c, n);
+                if (image.stride(0) == 1) {
+                    memcpy(dst, &pixel(image, 0, y, c), width() * sizeof(T));
+                } else {
+                    for (int x=0; x<width(); x++)
+                        dst[x] = pixel(image, x, y, c);
+                }
+            }
+    }
+
+private:
+    static const T &pixel(const Halide::Image<T> &image, int x, int y, int c) {
+        return image.dimensions() == 2 ? image(x, y) : image(x, y, c);
+    }
+
+    Halide::Image<T> images;
+};
+
+} // namespace excursions
+
+#endif // __IMAGE_BATCH_H
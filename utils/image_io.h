@@ -8,10 +8,16 @@
 #define STATIC_IMAGE_LOADER_H
 
 #include <png.h>
+#include <zlib.h>
 #include <string>
 #include <stdio.h>
 #include <algorithm>
 #include <string.h>
+#include <vector>
+#include <thread>
+#include <functional>
+
+#include "hbuf.h"
 
 //#include <sys/time.h>
 
@@ -54,6 +60,128 @@ inline void convert(uint16_t in, float &out) {out = in/65535.0f;}
 inline void convert(uint16_t in, double &out) {out = in/65535.0f;}
 
 
+// Bulk conversion of whole rows, with the semantics of convert() above.
+//
+// convert_samples() converts n samples read every in_stride elements of 'in' into every
+// out_stride elements of 'out'.  Converting row by row (instead of calling convert() per
+// sample inside the pixel and channel loops) lets the compiler vectorize the conversion:
+// the loops have no aliasing, and the strides of interleaved images (2, 3 or 4 channels)
+// are compile-time constants.  A conversion between identical types is a copy.
+template <int InStride, int OutStride, typename In, typename Out>
+inline void convert_samples_fixed(const In *__restrict in, Out *__restrict out, int n) {
+    for (int i = 0; i < n; i++) {
+        convert(in[i*InStride], out[i*OutStride]);
+    }
+}
+
+template <int InStride, typename In, typename Out>
+inline void convert_samples_from(const In *in, Out *out, int out_stride, int n) {
+    switch (out_stride) {
+    case 1: convert_samples_fixed<InStride, 1>(in, out, n); return;
+    case 2: convert_samples_fixed<InStride, 2>(in, out, n); return;
+    case 3: convert_samples_fixed<InStride, 3>(in, out, n); return;
+    case 4: convert_samples_fixed<InStride, 4>(in, out, n); return;
+    }
+    for (int i = 0; i < n; i++) {
+        convert(in[i*InStride], out[i*out_stride]);
+    }
+}
+
+template <typename In, typename Out>
+inline void convert_samples_strided(const In *in, int in_stride, Out *out, int out_stride, int n) {
+    switch (in_stride) {
+    case 1: convert_samples_from<1>(in, out, out_stride, n); return;
+    case 2: convert_samples_from<2>(in, out, out_stride, n); return;
+    case 3: convert_samples_from<3>(in, out, out_stride, n); return;
+    case 4: convert_samples_from<4>(in, out, out_stride, n); return;
+    }
+    for (int i = 0; i < n; i++) {
+        convert(in[i*in_stride], out[i*out_stride]);
+    }
+}
+
+template <typename In, typename Out>
+inline void convert_samples(const In *in, int in_stride, Out *out, int out_stride, int n) {
+    convert_samples_strided(in, in_stride, out, out_stride, n);
+}
+
+template <typename T>
+inline void convert_samples(const T *in, int in_stride, T *out, int out_stride, int n) {
+    if (in_stride == 1 && out_stride == 1) {
+        memcpy(out, in, n * sizeof(T));
+    } else {
+        convert_samples_strided(in, in_stride, out, out_stride, n);
+    }
+}
+
+// Converts the 'channels' interleaved samples of each of n pixels into 'channels' planes
+// 'plane_stride' elements apart (the layout of PNG and PPM rows into that of Image<T>).
+// Every channel is converted in the same pass over the row, with a compile-time channel
+// count for 1 to 4 channels.
+template <int Channels, typename In, typename Out>
+inline void deinterleave_fixed(const In *__restrict in, Out *__restrict out, int plane_stride, int n) {
+    for (int x = 0; x < n; x++) {
+        for (int c = 0; c < Channels; c++) {
+            convert(in[x*Channels + c], out[c*plane_stride + x]);
+        }
+    }
+}
+
+template <typename In, typename Out>
+inline void deinterleave_row(const In *in, int channels, Out *out, int plane_stride, int n) {
+    switch (channels) {
+    case 1: convert_samples(in, 1, out, 1, n); return;
+    case 2: deinterleave_fixed<2>(in, out, plane_stride, n); return;
+    case 3: deinterleave_fixed<3>(in, out, plane_stride, n); return;
+    case 4: deinterleave_fixed<4>(in, out, plane_stride, n); return;
+    }
+    for (int c = 0; c < channels; c++) {
+        convert_samples(in + c, channels, out + c*plane_stride, 1, n);
+    }
+}
+
+// The reverse of deinterleave_row(): the samples of each plane are in_stride elements
+// apart, and the pixels of 'out' pixel_stride elements apart
+template <int Channels, int PixelStride, typename In, typename Out>
+inline void interleave_fixed(const In *__restrict in, int plane_stride, Out *__restrict out, int n) {
+    for (int x = 0; x < n; x++) {
+        for (int c = 0; c < Channels; c++) {
+            convert(in[c*plane_stride + x], out[x*PixelStride + c]);
+        }
+    }
+}
+
+template <typename In, typename Out>
+inline void interleave_row(const In *in, int in_stride, int plane_stride, int channels,
+                           Out *out, int pixel_stride, int n) {
+    if (in_stride == 1 && channels == pixel_stride) {
+        switch (channels) {
+        case 1: convert_samples(in, 1, out, 1, n); return;
+        case 2: interleave_fixed<2, 2>(in, plane_stride, out, n); return;
+        case 3: interleave_fixed<3, 3>(in, plane_stride, out, n); return;
+        case 4: interleave_fixed<4, 4>(in, plane_stride, out, n); return;
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        convert_samples(in + c*plane_stride, in_stride, out + c, pixel_stride, n);
+    }
+}
+
+// Big-endian 16-bit samples (PNG, and PPM on little-endian hosts)
+inline void load_be16(const uint8_t *__restrict in, uint16_t *__restrict out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = (uint16_t)((in[2*i] << 8) | in[2*i+1]);
+    }
+}
+
+inline void store_be16(const uint16_t *__restrict in, uint8_t *__restrict out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[2*i] = in[i] >> 8;
+        out[2*i+1] = in[i] & 0xff;
+    }
+}
+
+
 inline bool ends_with_ignore_case(std::string a, std::string b) {
     if (a.length() < b.length()) { return false; }
     std::transform(a.begin(), a.end(), a.begin(), ::tolower);
@@ -129,25 +257,14 @@ Image<T> load_png(std::string filename) {
     T *ptr = (T*)im.data();
     if (bit_depth == 8) {
         for (int y = 0; y < im.height(); y++) {
-            uint8_t *srcPtr = (uint8_t *)(row_pointers[y]);
-            for (int x = 0; x < im.width(); x++) {
-                for (int c = 0; c < im.channels(); c++) {
-                    convert(*srcPtr++, ptr[c*c_stride]);
-                }
-                ptr++;
-            }
+            deinterleave_row((uint8_t *)(row_pointers[y]), im.channels(),
+                             ptr + y*im.stride(1), c_stride, im.width());
         }
     } else if (bit_depth == 16) {
+        std::vector<uint16_t> row(im.width() * im.channels());
         for (int y = 0; y < im.height(); y++) {
-            uint8_t *srcPtr = (uint8_t *)(row_pointers[y]);
-            for (int x = 0; x < im.width(); x++) {
-                for (int c = 0; c < im.channels(); c++) {
-                    uint16_t hi = (*srcPtr++) << 8;
-                    uint16_t lo = hi | (*srcPtr++);
-                    convert(lo, ptr[c*c_stride]);
-                }
-                ptr++;
-            }
+            load_be16((uint8_t *)(row_pointers[y]), &row[0], (int)row.size());
+            deinterleave_row(&row[0], im.channels(), ptr + y*im.stride(1), c_stride, im.width());
         }
     }
 
@@ -163,8 +280,256 @@ Image<T> load_png(std::string filename) {
     return im;
 }
 
+// Encoder settings of save_png; the defaults are those of libpng.
+//  - compression_level: the zlib level, from 0 (stored) to 9, or Z_DEFAULT_COMPRESSION
+//  - filters: the row filters to choose from, a mask of PNG_FILTER_NONE, PNG_FILTER_SUB,
+//    PNG_FILTER_UP, PNG_FILTER_AVG and PNG_FILTER_PAETH, or PNG_ALL_FILTERS.  With more than
+//    one, each row takes the filter that gives the smallest sum of absolute values
+//  - strategy: the zlib strategy (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE, Z_HUFFMAN_ONLY),
+//    or -1 for libpng's choice, Z_FILTERED unless the rows are unfiltered
+//  - threads: 1 writes through libpng.  With more (0 for one per core) the rows are split
+//    into bands, each compressed by its own thread into a raw deflate stream; the streams
+//    end on a byte boundary (Z_SYNC_FLUSH) and are concatenated into a single zlib stream,
+//    whose Adler-32 is combined from those of the bands, as pigz does.  Each band's
+//    window is primed with the last 32 KB of the rows above it, so the files are about as
+//    small as with a single thread.
+struct png_options {
+    int compression_level;
+    int filters;
+    int strategy;
+    int threads;
+
+    png_options(int compression_level = Z_DEFAULT_COMPRESSION, int filters = PNG_ALL_FILTERS,
+                int strategy = -1, int threads = 1) :
+        compression_level(compression_level), filters(filters), strategy(strategy), threads(threads) {}
+};
+
+// Row y of im as PNG samples, 16-bit ones big-endian
 template<typename T>
-void save_png(Image<T> im, std::string filename) {
+void png_scanline(const Image<T> &im, int y, int bit_depth, uint16_t *scratch, uint8_t *out) {
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    const T *src = (const T *)im.data() + y*im.stride(1);
+    if (bit_depth == 16) {
+        interleave_row(src, im.stride(0), c_stride, im.channels(), scratch, im.channels(), im.width());
+        store_be16(scratch, out, im.width() * im.channels());
+    } else {
+        interleave_row(src, im.stride(0), c_stride, im.channels(), out, im.channels(), im.width());
+    }
+}
+
+inline uint8_t paeth_predictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+// Filters the 'bytes' bytes of row 'raw' into 'out': the filter type followed by the
+// filtered bytes.  'prior' is the row above (zeros for the first row); bpp is the number
+// of bytes per pixel.  'candidates' has room for 5 filtered rows.
+inline void filter_png_row(const uint8_t *raw, const uint8_t *prior, int bytes, int bpp,
+                           int filters, uint8_t *candidates, uint8_t *out) {
+    int best = -1;
+    long best_sum = 0;
+    for (int type = 0; type < 5; type++) {
+        if (!(filters & (PNG_FILTER_NONE << type))) {
+            continue;
+        }
+        uint8_t *f = candidates + type*(bytes + 1);
+        f[0] = type;
+        f++;
+        const int head = std::min(bpp, bytes);
+        switch (type) {
+        case 0:
+            memcpy(f, raw, bytes);
+            break;
+        case 1:
+            memcpy(f, raw, head);
+            for (int i = bpp; i < bytes; i++) f[i] = raw[i] - raw[i - bpp];
+            break;
+        case 2:
+            for (int i = 0; i < bytes; i++) f[i] = raw[i] - prior[i];
+            break;
+        case 3:
+            for (int i = 0; i < head; i++) f[i] = raw[i] - (prior[i] >> 1);
+            for (int i = bpp; i < bytes; i++) f[i] = raw[i] - ((raw[i - bpp] + prior[i]) >> 1);
+            break;
+        case 4:
+            for (int i = 0; i < head; i++) f[i] = raw[i] - prior[i];
+            for (int i = bpp; i < bytes; i++) f[i] = raw[i] - paeth_predictor(raw[i - bpp], prior[i], prior[i - bpp]);
+            break;
+        }
+        // A single allowed filter needs no heuristic
+        long sum = 0;
+        if (filters != (PNG_FILTER_NONE << type)) {
+            for (int i = 0; i < bytes; i++) {
+                sum += abs((int8_t)f[i]);
+            }
+        }
+        if (best < 0 || sum < best_sum) {
+            best = type;
+            best_sum = sum;
+        }
+    }
+    if (best < 0) {
+        out[0] = 0;
+        memcpy(out + 1, raw, bytes);
+    } else {
+        memcpy(out, candidates + best*(bytes + 1), bytes + 1);
+    }
+}
+
+// The compressed rows [first, last) of a PNG image
+struct png_band {
+    int first, last;
+    std::vector<uint8_t> deflated;
+    uLong adler;                // of the filtered rows
+    z_off_t length;             // of the filtered rows
+    bool ok;
+};
+
+template<typename T>
+void compress_png_band(const Image<T> &im, int bit_depth, const png_options &options,
+                       bool final_band, png_band &band) {
+    const int bpp = im.channels() * bit_depth / 8;
+    const int bytes = im.width() * bpp;
+    std::vector<uint16_t> scratch(im.width() * im.channels());
+    std::vector<uint8_t> raw(bytes), prior(bytes), zeros(bytes, 0), filtered(bytes + 1), candidates(5 * (bytes + 1));
+    const int strategy = options.strategy >= 0 ? options.strategy :
+                         (options.filters == PNG_FILTER_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED);
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    band.ok = deflateInit2(&z, options.compression_level, Z_DEFLATED, -15, 8, strategy) == Z_OK;
+    band.adler = adler32(0, NULL, 0);
+    band.length = 0;
+    if (!band.ok) {
+        return;
+    }
+
+    // The window starts with the filtered rows above the band, as if a single stream
+    // compressed the whole image
+    if (band.first > 0) {
+        const int window = 32768;
+        const int rows = std::min(band.first, (window + bytes) / (bytes + 1));
+        std::vector<uint8_t> dictionary;
+        for (int y = band.first - rows - 1; y < band.first; y++) {
+            if (y >= 0) {
+                png_scanline(im, y, bit_depth, &scratch[0], &raw[0]);
+                if (y >= band.first - rows) {
+                    filter_png_row(&raw[0], y > 0 ? &prior[0] : &zeros[0], bytes, bpp, options.filters,
+                                   &candidates[0], &filtered[0]);
+                    dictionary.insert(dictionary.end(), filtered.begin(), filtered.end());
+                }
+                raw.swap(prior);
+            }
+        }
+        const size_t size = std::min(dictionary.size(), (size_t)window);
+        deflateSetDictionary(&z, &dictionary[dictionary.size() - size], (uInt)size);
+    }
+
+    uint8_t out[65536];
+    for (int y = band.first; y < band.last; y++) {
+        png_scanline(im, y, bit_depth, &scratch[0], &raw[0]);
+        filter_png_row(&raw[0], y > 0 ? &prior[0] : &zeros[0], bytes, bpp, options.filters,
+                       &candidates[0], &filtered[0]);
+        raw.swap(prior);
+        band.adler = adler32(band.adler, &filtered[0], bytes + 1);
+        band.length += bytes + 1;
+
+        const bool end = y == band.last - 1;
+        z.next_in = &filtered[0];
+        z.avail_in = bytes + 1;
+        int flush = !end ? Z_NO_FLUSH : (final_band ? Z_FINISH : Z_SYNC_FLUSH);
+        do {
+            z.next_out = out;
+            z.avail_out = sizeof(out);
+            int status = deflate(&z, flush);
+            if (status == Z_STREAM_ERROR) {
+                band.ok = false;
+                break;
+            }
+            band.deflated.insert(band.deflated.end(), out, out + sizeof(out) - z.avail_out);
+        } while (z.avail_out == 0);
+    }
+    deflateEnd(&z);
+}
+
+inline void put_be32(uint32_t value, uint8_t *out) {
+    out[0] = value >> 24;   out[1] = value >> 16;   out[2] = value >> 8;    out[3] = value;
+}
+
+inline bool write_png_chunk(FILE *f, const char *type, const uint8_t *data, size_t size) {
+    uint8_t length[4], crc[4];
+    put_be32((uint32_t)size, length);
+    uLong sum = crc32(0, (const Bytef *)type, 4);
+    bool ok = fwrite(length, 1, 4, f) == 4 && fwrite(type, 1, 4, f) == 4;
+    if (size > 0) {
+        sum = crc32(sum, data, (uInt)size);
+        ok = ok && fwrite(data, 1, size, f) == size;
+    }
+    put_be32((uint32_t)sum, crc);
+    return ok && fwrite(crc, 1, 4, f) == 4;
+}
+
+template<typename T>
+void save_png_parallel(Image<T> im, std::string filename, png_byte color_type, int bit_depth,
+                       const png_options &options) {
+    int threads = options.threads > 0 ? options.threads : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, std::min(threads, im.height()));
+
+    std::vector<png_band> bands(threads);
+    std::vector<std::thread> workers;
+    for (int b = 0; b < threads; b++) {
+        bands[b].first = (int)((int64_t)im.height() * b / threads);
+        bands[b].last = (int)((int64_t)im.height() * (b + 1) / threads);
+        workers.push_back(std::thread(compress_png_band<T>, std::cref(im), bit_depth, std::cref(options),
+                                      b == threads - 1, std::ref(bands[b])));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    // zlib header: deflate with a 32 KB window, and the level class
+    const int level = options.compression_level == Z_DEFAULT_COMPRESSION ? 6 : options.compression_level;
+    const int level_class = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    const uint8_t cmf = 0x78;
+    uint8_t flg = level_class << 6;
+    flg += 31 - (cmf * 256 + flg) % 31;
+    uLong adler = adler32(0, NULL, 0);
+    for (int b = 0; b < threads; b++) {
+        _assert(bands[b].ok, "[write_png_file] Compression of rows %d to %d failed\n", bands[b].first, bands[b].last);
+        adler = adler32_combine(adler, bands[b].adler, bands[b].length);
+    }
+    const uint8_t header[2] = { cmf, flg };
+    uint8_t trailer[4];
+    put_be32((uint32_t)adler, trailer);
+    bands.front().deflated.insert(bands.front().deflated.begin(), header, header + 2);
+    bands.back().deflated.insert(bands.back().deflated.end(), trailer, trailer + 4);
+
+    FILE *f = fopen(filename.c_str(), "wb");
+    _assert(f, "[write_png_file] File %s could not be opened for writing\n", filename.c_str());
+    const uint8_t signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+    uint8_t ihdr[13];
+    put_be32(im.width(), ihdr);
+    put_be32(im.height(), ihdr + 4);
+    ihdr[8] = bit_depth;
+    ihdr[9] = color_type;
+    ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+    ihdr[11] = PNG_FILTER_TYPE_BASE;
+    ihdr[12] = PNG_INTERLACE_NONE;
+    bool ok = fwrite(signature, 1, 8, f) == 8 && write_png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    // One IDAT chunk per band: the decoder sees the concatenation of their data
+    for (int b = 0; b < threads && ok; b++) {
+        ok = write_png_chunk(f, "IDAT", &bands[b].deflated[0], bands[b].deflated.size());
+    }
+    ok = ok && write_png_chunk(f, "IEND", NULL, 0);
+    fclose(f);
+    _assert(ok, "[write_png_file] Error writing %s\n", filename.c_str());
+}
+
+template<typename T>
+void save_png(Image<T> im, std::string filename, const png_options &options = png_options()) {
     png_structp png_ptr;
     png_infop info_ptr;
     png_bytep *row_pointers;
@@ -180,6 +545,11 @@ void save_png(Image<T> im, std::string filename) {
                               };
     color_type = color_types[im.channels() - 1];
 
+    if (options.threads != 1) {
+        save_png_parallel(im, filename, color_type, sizeof(T) == 1 ? 8 : 16, options);
+        return;
+    }
+
     // open file
     FILE *f = fopen(filename.c_str(), "wb");
     _assert(f, "[write_png_file] File %s could not be opened for writing\n", filename.c_str());
@@ -194,6 +564,11 @@ void save_png(Image<T> im, std::string filename) {
     _assert(!setjmp(png_jmpbuf(png_ptr)), "[write_png_file] Error during init_io\n");
 
     png_init_io(png_ptr, f);
+    png_set_compression_level(png_ptr, options.compression_level);
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options.filters);
+    if (options.strategy >= 0) {
+        png_set_compression_strategy(png_ptr, options.strategy);
+    }
 
     unsigned int bit_depth = 16;
     if (sizeof(T) == 1) {
@@ -215,31 +590,20 @@ void save_png(Image<T> im, std::string filename) {
 
     int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
     T *srcPtr = (T*)im.data();
+    std::vector<uint16_t> row(im.width() * im.channels());
 
     for (int y = 0; y < im.height(); y++) {
         row_pointers[y] = new png_byte[png_get_rowbytes(png_ptr, info_ptr)];
         uint8_t *dstPtr = (uint8_t *)(row_pointers[y]);
         if (bit_depth == 16) {
             // convert to uint16_t
-            for (int x = 0; x < im.width(); x++) {
-                for (int c = 0; c < im.channels(); c++) {
-                    uint16_t out;
-                    convert(srcPtr[c*c_stride], out);
-                    *dstPtr++ = out >> 8;
-                    *dstPtr++ = out & 0xff;
-                }
-                srcPtr++;
-            }
+            interleave_row(srcPtr + y*im.stride(1), im.stride(0), c_stride, im.channels(),
+                           &row[0], im.channels(), im.width());
+            store_be16(&row[0], dstPtr, (int)row.size());
         } else if (bit_depth == 8) {
             // convert to uint8_t
-            for (int x = 0; x < im.width(); x++) {
-                for (int c = 0; c < im.channels(); c++) {
-                    uint8_t out;
-                    convert(srcPtr[c*c_stride], out);
-                    *dstPtr++ = out;
-                }
-                srcPtr++;
-            }
+            interleave_row(srcPtr + y*im.stride(1), im.stride(0), c_stride, im.channels(),
+                           dstPtr, im.channels(), im.width());
         } else {
             _assert(bit_depth == 8 || bit_depth == 16, "We only support saving 8- and 16-bit images.");
         }
@@ -309,28 +673,19 @@ Image<T> load_ppm(std::string filename) {
 
         T *im_data = (T*) im.data();
         for (int y = 0; y < im.height(); y++) {
-            uint8_t *row = (uint8_t *)(&data[(y*width)*3]);
-            for (int x = 0; x < im.width(); x++) {
-                convert(*row++, im_data[(0*height+y)*width+x]);
-                convert(*row++, im_data[(1*height+y)*width+x]);
-                convert(*row++, im_data[(2*height+y)*width+x]);
-            }
+            deinterleave_row(&data[(y*width)*3], 3, im_data + y*width, width*height, width);
         }
         delete[] data;
     } else if (bit_depth == 16) {
-        int little_endian = is_little_endian();
-        uint16_t *data = new uint16_t[width*height*3];
+        // The samples are big-endian whatever the host byte order
+        uint8_t *data = new uint8_t[width*height*3*2];
         _assert(fread((void *) data, sizeof(uint16_t), width*height*3, f) == (size_t) (width*height*3), "Could not read PPM 16-bit data\n");
         fclose(f);
         T *im_data = (T*) im.data();
+        std::vector<uint16_t> row(width*3);
         for (int y = 0; y < im.height(); y++) {
-            uint16_t *row = (uint16_t *) (&data[(y*width)*3]);
-            for (int x = 0; x < im.width(); x++) {
-                uint16_t value;
-                value = *row++; SWAP_ENDIAN16(little_endian, value); convert(value, im_data[(0*height+y)*width+x]);
-                value = *row++; SWAP_ENDIAN16(little_endian, value); convert(value, im_data[(1*height+y)*width+x]);
-                value = *row++; SWAP_ENDIAN16(little_endian, value); convert(value, im_data[(2*height+y)*width+x]);
-            }
+            load_be16(&data[(y*width)*3*2], &row[0], width*3);
+            deinterleave_row(&row[0], 3, im_data + y*width, width*height, width);
         }
         delete[] data;
     }
@@ -348,31 +703,26 @@ void save_ppm(Image<T> im, std::string filename) {
     fprintf(f, "P6\n%d %d\n%d\n", im.width(), im.height(), (1<<bit_depth)-1);
     int width = im.width(), height = im.height();
 
+    int c_stride = (im.channels() == 1) ? 0 : im.stride(2);
+    // A PPM pixel has 3 samples: the alpha channel of a 4-channel image is dropped
+    const int channels = std::min(im.channels(), 3);
+    T *src = (T*) im.data();
     if (bit_depth == 8) {
         uint8_t *data = new uint8_t[width*height*3];
         for (int y = 0; y < im.height(); y++) {
-            for (int x = 0; x < im.width(); x++) {
-                uint8_t *p = (uint8_t *)(&data[(y*width+x)*3]);
-                for (int c = 0; c < im.channels(); c++) {
-                    convert(im(x, y, c), p[c]);
-                }
-            }
+            interleave_row(src + y*im.stride(1), im.stride(0), c_stride, channels,
+                           &data[(y*width)*3], 3, width);
         }
         _assert(fwrite((void *) data, sizeof(uint8_t), width*height*3, f) == (size_t) (width*height*3), "Could not write PPM 8-bit data\n");
         delete[] data;
     } else if (bit_depth == 16) {
-        int little_endian = is_little_endian();
-        uint16_t *data = new uint16_t[width*height*3];
+        // The samples are big-endian whatever the host byte order
+        uint8_t *data = new uint8_t[width*height*3*2];
+        std::vector<uint16_t> row(width*3);
         for (int y = 0; y < im.height(); y++) {
-            for (int x = 0; x < im.width(); x++) {
-                uint16_t *p = (uint16_t *)(&data[(y*width+x)*3]);
-                for (int c = 0; c < im.channels(); c++) {
-                    uint16_t value;
-                    convert(im(x, y, c), value);
-                    SWAP_ENDIAN16(little_endian, value);
-                    p[c] = value;
-                }
-            }
+            interleave_row(src + y*im.stride(1), im.stride(0), c_stride, channels,
+                           &row[0], 3, width);
+            store_be16(&row[0], &data[(y*width)*3*2], width*3);
         }
         _assert(fwrite((void *) data, sizeof(uint16_t), width*height*3, f) == (size_t) (width*height*3), "Could not write PPM 16-bit data\n");
         delete[] data;
@@ -380,25 +730,86 @@ void save_ppm(Image<T> im, std::string filename) {
     fclose(f);
 }
 
+// Loads an hbuf file (see hbuf.h) of elements of type T, with the dimensions and mins it
+// was saved with.  The payload is read straight into the image when the strides of the
+// file are those of a new Image<T>, and copied element by element otherwise.
+template<typename T>
+Image<T> load_hbuf(std::string filename) {
+    excursions::hbuf_header header;
+    _assert(excursions::hbuf_read(filename, header), "Could not read %s\n", filename.c_str());
+    uint8_t code, bits;
+    excursions::hbuf_type_of<T>(code, bits);
+    _assert(header.type_code == code && header.type_bits == bits,
+            "%s does not hold elements of the requested type\n", filename.c_str());
+
+    int extent[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < header.dimensions; i++) {
+        extent[i] = header.extent[i];
+    }
+    Image<T> im(extent[0], extent[1], extent[2], extent[3]);
+    buffer_t *buf = im.raw_buffer();
+    bool dense = true;
+    for (int i = 0; i < header.dimensions; i++) {
+        buf->min[i] = header.min[i];
+        dense = dense && buf->stride[i] == header.stride[i];
+    }
+    if (dense) {
+        _assert(excursions::hbuf_read(filename, header, buf->host), "Could not read %s\n", filename.c_str());
+    } else {
+        std::vector<uint8_t> payload(header.raw_size);
+        _assert(excursions::hbuf_read(filename, header, &payload[0]), "Could not read %s\n", filename.c_str());
+        const T *src = (const T *)&payload[0];
+        T *dst = (T *)buf->host;
+        for (int w = 0; w < std::max(extent[3], 1); w++)
+            for (int z = 0; z < std::max(extent[2], 1); z++)
+                for (int y = 0; y < std::max(extent[1], 1); y++)
+                    for (int x = 0; x < extent[0]; x++) {
+                        dst[x*buf->stride[0] + y*buf->stride[1] + z*buf->stride[2] + w*buf->stride[3]] =
+                            src[x*header.stride[0] + y*header.stride[1] + z*header.stride[2] + w*header.stride[3]];
+                    }
+    }
+    im.set_host_dirty();
+    return im;
+}
+
+// Saves im as an hbuf file (see hbuf.h), keeping its mins and strides; the payload is
+// LZ4-compressed if 'compression' is HBUF_LZ4
+template<typename T>
+void save_hbuf(Image<T> im, std::string filename,
+               excursions::hbuf_compression compression = excursions::HBUF_NONE) {
+    im.copy_to_host();
+    uint8_t code, bits;
+    excursions::hbuf_type_of<T>(code, bits);
+    _assert(excursions::hbuf_write(filename, *im.raw_buffer(), code, bits, compression),
+            "Could not write %s\n", filename.c_str());
+}
+
 template<typename T>
 Image<T> load(std::string filename) {
     if (ends_with_ignore_case(filename, ".png")) {
         return load_png<T>(filename);
     } else if (ends_with_ignore_case(filename, ".ppm")) {
         return load_ppm<T>(filename);
+    } else if (ends_with_ignore_case(filename, ".hbuf") || ends_with_ignore_case(filename, ".hbz")) {
+        return load_hbuf<T>(filename);
     } else {
-        _assert(false, "[load] unsupported file extension (png|ppm supported)");
+        _assert(false, "[load] unsupported file extension (png|ppm|hbuf|hbz supported)");
     }
 }
 
+// options apply to PNG files only
 template<typename T>
-void save(Image<T> im, std::string filename) {
+void save(Image<T> im, std::string filename, const png_options &options = png_options()) {
     if (ends_with_ignore_case(filename, ".png")) {
-        save_png<T>(im, filename);
+        save_png<T>(im, filename, options);
     } else if (ends_with_ignore_case(filename, ".ppm")) {
         save_ppm<T>(im, filename);
+    } else if (ends_with_ignore_case(filename, ".hbuf")) {
+        save_hbuf<T>(im, filename);
+    } else if (ends_with_ignore_case(filename, ".hbz")) {
+        save_hbuf<T>(im, filename, excursions::HBUF_LZ4);
     } else {
-        _assert(false, "[save] unsupported file extension (png|ppm supported)");
+        _assert(false, "[save] unsupported file extension (png|ppm|hbuf|hbz supported)");
     }
 }
 
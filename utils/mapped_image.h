@@ -0,0 +1,277 @@
+#ifndef __MAPPED_IMAGE_H
+#define __MAPPED_IMAGE_H
+
+//
+// Memory-mapped image files.
+//
+// The file is mmap'ed and the host pointer of a buffer_t points straight at its pixel
+// payload, so pixels are never copied or converted on load or save, and processes which
+// map the same file share its pages through the page cache.
+//
+// Supported formats:
+//   P5 (PGM) and P6 (PPM) with 8-bit samples.  P6 pixels are interleaved, so the buffer has
+//      strides (3, 3*width, 1); functions realized into a P6 image must be scheduled for
+//      an interleaved output (see schedule_interleaved).
+//   A raw planar format: a 64-byte header (see raw_header) followed by the channel planes,
+//      each of them width x height elements of any Halide type, without padding.
+//   Uncompressed hbuf files (see hbuf.h), with the mins and strides they were saved with.
+//      Created files are planar and dense, like the raw format.
+//
+// Reading:
+//     excursions::mapped_image in("input.ppm");
+//     Halide::ImageParam p(Halide::UInt(8), 3);
+//     p.set(in.buffer());
+// Writing (the file is created with its final size and realized into in place):
+//     excursions::mapped_image out("output.raw", excursions::MAPPED_RAW, width, height, 3);
+//     f.realize(out.buffer());
+//
+
+#include "Halide.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hbuf.h"
+
+namespace excursions {
+
+enum mapped_format {
+    MAPPED_PGM,     // P5
+    MAPPED_PPM,     // P6
+    MAPPED_RAW,     // planar, see raw_header
+    MAPPED_HBUF     // uncompressed hbuf, see hbuf.h
+};
+
+// Header of the raw planar format
+struct raw_header {
+    char magic[8];          // "EXCRAW1\0"
+    int32_t width, height, channels;
+    int32_t type_code;      // 0=int, 1=uint, 2=float
+    int32_t type_bits;
+    char reserved[36];
+};
+
+class mapped_image {
+public:
+    // Map an existing file
+    explicit mapped_image(const std::string &filename, bool writable = false)
+        : data(NULL), size(0), pixels(NULL) {
+        int fd = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "mapped_image: could not open %s\n", filename.c_str());
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = st.st_size;
+            void *p = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            data = p == MAP_FAILED ? NULL : (uint8_t *)p;
+        }
+        close(fd);
+        if (!data || !parse_header()) {
+            fprintf(stderr, "mapped_image: %s is not an 8-bit P5/P6, raw planar or uncompressed hbuf image\n", filename.c_str());
+            unmap();
+        }
+    }
+
+    // Create (or truncate) a file for a width x height x channels image and map it for writing
+    mapped_image(const std::string &filename, mapped_format format, int width, int height,
+                 int channels = 1, Halide::Type type = Halide::UInt(8))
+        : data(NULL), size(0), pixels(NULL) {
+        if ((format == MAPPED_PGM || format == MAPPED_PPM) && (type != Halide::UInt(8) || channels != (format == MAPPED_PPM ? 3 : 1))) {
+            fprintf(stderr, "mapped_image: P5/P6 images must be 8-bit with 1/3 channels\n");
+            return;
+        }
+        std::vector<char> header(64, 0);
+        size_t header_size;
+        if (format == MAPPED_HBUF) {
+            buffer_t planar;
+            memset(&planar, 0, sizeof(planar));
+            planar.extent[0] = width;
+            planar.extent[1] = height;
+            planar.extent[2] = channels > 1 ? channels : 0;
+            planar.stride[0] = 1;
+            planar.stride[1] = width;
+            planar.stride[2] = width * height;
+            hbuf_header hbuf;
+            hbuf_describe(planar, type.is_float() ? 2 : type.is_uint() ? 1 : 0, type.bits, HBUF_NONE, hbuf);
+            header.assign(hbuf.payload_offset, 0);
+            memcpy(&header[0], &hbuf, sizeof(hbuf));
+            header_size = header.size();
+        } else if (format == MAPPED_RAW) {
+            raw_header raw;
+            memset(&raw, 0, sizeof(raw));
+            memcpy(raw.magic, "EXCRAW1", 8);
+            raw.width = width;
+            raw.height = height;
+            raw.channels = channels;
+            raw.type_code = type.is_float() ? 2 : type.is_uint() ? 1 : 0;
+            raw.type_bits = type.bits;
+            memcpy(&header[0], &raw, sizeof(raw));
+            header_size = sizeof(raw);
+        } else {
+            header_size = snprintf(&header[0], header.size(), "P%c\n%d %d\n255\n", format == MAPPED_PPM ? '6' : '5', width, height);
+        }
+        size = header_size + (size_t)width * height * channels * (type.bits / 8);
+
+        int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "mapped_image: could not create %s\n", filename.c_str());
+            size = 0;
+            return;
+        }
+        if (ftruncate(fd, size) == 0) {
+            void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            data = p == MAP_FAILED ? NULL : (uint8_t *)p;
+        }
+        close(fd);
+        if (!data) {
+            fprintf(stderr, "mapped_image: could not map %s\n", filename.c_str());
+            size = 0;
+            return;
+        }
+        memcpy(data, &header[0], header_size);
+        parse_header();
+    }
+
+    ~mapped_image() { unmap(); }
+
+    bool valid() const { return pixels != NULL; }
+    int width() const { return buf.extent[0]; }
+    int height() const { return buf.extent[1]; }
+    int channels() const { return buf.extent[2] ? buf.extent[2] : 1; }
+    Halide::Type type() const { return pixel_type; }
+
+    // A buffer aliasing the pixels of the file.  It is valid for the lifetime of this object.
+    Halide::Buffer buffer() const {
+        return Halide::Buffer(pixel_type, &buf);
+    }
+
+    // Flush modified pages to the file
+    void sync() {
+        if (data)
+            msync(data, size, MS_SYNC);
+    }
+
+private:
+    mapped_image(const mapped_image &);
+    mapped_image &operator=(const mapped_image &);
+
+    void unmap() {
+        if (data)
+            munmap(data, size);
+        data = NULL;
+        pixels = NULL;
+        size = 0;
+    }
+
+    // Reads an integer field of a PNM header, skipping whitespace and comments
+    bool pnm_field(size_t &pos, int &value) const {
+        for (;;) {
+            while (pos < size && isspace(data[pos]))
+                pos++;
+            if (pos < size && data[pos] == '#') {
+                while (pos < size && data[pos] != '\n')
+                    pos++;
+                continue;
+            }
+            break;
+        }
+        if (pos >= size || !isdigit(data[pos]))
+            return false;
+        value = 0;
+        while (pos < size && isdigit(data[pos]))
+            value = value * 10 + (data[pos++] - '0');
+        return true;
+    }
+
+    // Set up 'buf' for the pixel payload of the file
+    bool parse_header() {
+        memset(&buf, 0, sizeof(buf));
+        int width = 0, height = 0, channels = 1;
+        bool interleaved = false;
+        size_t offset;
+        if (size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6')) {
+            int maxval;
+            size_t pos = 2;
+            if (!pnm_field(pos, width) || !pnm_field(pos, height) || !pnm_field(pos, maxval) || maxval != 255)
+                return false;
+            offset = pos + 1;   // a single whitespace character follows maxval
+            channels = data[1] == '6' ? 3 : 1;
+            interleaved = true;
+            pixel_type = Halide::UInt(8);
+        } else if (size >= sizeof(raw_header) && memcmp(data, "EXCRAW1", 8) == 0) {
+            raw_header raw;
+            memcpy(&raw, data, sizeof(raw));
+            if (!hbuf_type_valid(raw.type_code, raw.type_bits))
+                return false;
+            width = raw.width;
+            height = raw.height;
+            channels = raw.channels;
+            pixel_type = raw.type_code == 2 ? Halide::Float(raw.type_bits) :
+                         raw.type_code == 1 ? Halide::UInt(raw.type_bits) : Halide::Int(raw.type_bits);
+            offset = sizeof(raw);
+        } else if (size >= sizeof(hbuf_header) && memcmp(data, "EXCHBUF1", 8) == 0) {
+            return parse_hbuf_header();
+        } else {
+            return false;
+        }
+
+        // Dividing the payload rather than multiplying the extents, which may overflow
+        const int elem_size = pixel_type.bits / 8;
+        if (width <= 0 || height <= 0 || channels <= 0 || offset > size ||
+            (size - offset) / elem_size / width / height < (size_t)channels)
+            return false;
+
+        pixels = data + offset;
+        buf.host = pixels;
+        buf.elem_size = elem_size;
+        buf.extent[0] = width;
+        buf.extent[1] = height;
+        buf.extent[2] = channels > 1 ? channels : 0;
+        if (interleaved) {
+            buf.stride[0] = channels;
+            buf.stride[1] = channels * width;
+            buf.stride[2] = 1;
+        } else {
+            buf.stride[0] = 1;
+            buf.stride[1] = width;
+            buf.stride[2] = width * height;
+        }
+        return true;
+    }
+
+    // Set up 'buf' as it was described when the hbuf file was saved
+    bool parse_hbuf_header() {
+        hbuf_header header;
+        memcpy(&header, data, sizeof(header));
+        if (!hbuf_valid(header, size) || header.compression != HBUF_NONE)
+            return false;
+        pixel_type = header.type_code == 2 ? Halide::Float(header.type_bits) :
+                     header.type_code == 1 ? Halide::UInt(header.type_bits) : Halide::Int(header.type_bits);
+        pixels = data + header.payload_offset;
+        buf.host = pixels;
+        buf.elem_size = header.type_bits / 8;
+        for (int i = 0; i < header.dimensions; i++) {
+            buf.min[i] = header.min[i];
+            buf.extent[i] = header.extent[i];
+            buf.stride[i] = header.stride[i];
+        }
+        return true;
+    }
+
+    uint8_t *data;
+    size_t size;
+    uint8_t *pixels;
+    buffer_t buf;
+    Halide::Type pixel_type;
+};
+
+} // namespace excursions
+
+#endif // __MAPPED_IMAGE_H
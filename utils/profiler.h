@@ -0,0 +1,149 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+//
+// Per-stage profiling, built on Halide's sampling profiler.
+//
+// A pipeline compiled for profile_target() records, for every Func, the time spent computing
+// it, the number of threads active while it runs and the memory it allocates.  stage_profile
+// collects these counters after each run and reports them as a per-stage table over all runs:
+//
+//     f.compile_jit(profile_target());
+//     stage_profile profile;
+//     for (int i=0; i<runs; i++) {
+//         f.realize(output);
+//         profile.collect();
+//     }
+//     profile.print();
+//
+// To merge the table into the report written by timings::dump(), add it as a section:
+//
+//     t.add_section(profile.table());
+//
+// Give the Funcs names (Halide::Func f("name")) to make the table readable.
+//
+
+#include "Halide.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+
+// The JIT target with Halide's profiler enabled
+inline Halide::Target profile_target(Halide::Target target = Halide::get_jit_target_from_environment()) {
+    target.set_feature(Halide::Target::Profile);
+    return target;
+}
+
+class stage_profile {
+public:
+    stage_profile() : runs(0), total_time(0) {}
+
+    // Accumulate the profiler counters of the last run(s), and reset them for the next run.
+    // The sampling thread may still be updating the counters (and reordering the list of
+    // pipelines), so they are read with the profiler state locked.
+    void collect() {
+        halide_profiler_state *state = halide_profiler_get_state();
+        halide_mutex_lock(&state->lock);
+        halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)state->pipelines;
+        double run_time = 0;
+        for (; p; p = (halide_profiler_pipeline_stats *)p->next) {
+            if (p->runs == 0)
+                continue;
+            run_time += p->time / 1000000.0;
+            for (int i=0; i<p->num_funcs; i++) {
+                const halide_profiler_func_stats &fs = p->funcs[i];
+                stage &s = stage_named(fs.name);
+                s.times.push_back(fs.time / 1000000.0);
+                s.active_threads += fs.active_threads_denominator ?
+                    (double)fs.active_threads_numerator / fs.active_threads_denominator : 0;
+                s.memory_peak = std::max(s.memory_peak, (uint64_t)fs.memory_peak);
+                s.memory_total += fs.memory_total;
+                s.allocs += fs.num_allocs;
+            }
+        }
+        halide_mutex_unlock(&state->lock);
+        total_time += run_time;
+        runs++;
+        // halide_profiler_reset() takes the lock itself
+        halide_profiler_reset();
+    }
+
+    // One row per Func: mean/min/max time per run, share of the pipeline time, mean number
+    // of active threads, peak memory and bytes allocated per run
+    std::string table() const {
+        std::string out;
+        append(out, "%-24s %9s %9s %9s %6s %7s %10s %12s %7s\n", "stage", "mean ms", "min ms", "max ms",
+               "%", "threads", "peak KB", "alloc KB/run", "allocs");
+        for (size_t i=0; i<stages.size(); i++) {
+            const stage &s = stages[i];
+            if (s.times.empty())
+                continue;
+            double sum = 0, lo = s.times[0], hi = s.times[0];
+            for (size_t r=0; r<s.times.size(); r++) {
+                sum += s.times[r];
+                lo = std::min(lo, s.times[r]);
+                hi = std::max(hi, s.times[r]);
+            }
+            const double n = s.times.size();
+            append(out, "%-24s %9.3f %9.3f %9.3f %6.1f %7.2f %10.1f %12.1f %7.1f\n", s.name.c_str(),
+                   sum / n, lo, hi, total_time > 0 ? 100.0 * sum / total_time : 0.0, s.active_threads / n,
+                   s.memory_peak / 1024.0, s.memory_total / 1024.0 / n, s.allocs / n);
+        }
+        append(out, "%-24s %9.3f   (%d runs)\n", "total", runs ? total_time / runs : 0.0, runs);
+        return out;
+    }
+
+    void print(FILE *f = stdout) const {
+        fputs(table().c_str(), f);
+    }
+
+    void reset() {
+        stages.clear();
+        index.clear();
+        runs = 0;
+        total_time = 0;
+    }
+
+private:
+    static void append(std::string &out, const char *format, ...) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        out += line;
+    }
+
+    struct stage {
+        std::string name;
+        std::vector<double> times;  // ms, per run
+        double active_threads;      // sum over runs
+        uint64_t memory_peak;
+        uint64_t memory_total;      // sum over runs
+        uint64_t allocs;            // sum over runs
+    };
+
+    stage &stage_named(const char *name) {
+        std::string key = name ? name : "?";
+        std::map<std::string, size_t>::iterator it = index.find(key);
+        if (it != index.end())
+            return stages[it->second];
+        stage s;
+        s.name = key;
+        s.active_threads = 0;
+        s.memory_peak = s.memory_total = s.allocs = 0;
+        index[key] = stages.size();
+        stages.push_back(s);
+        return stages.back();
+    }
+
+    std::vector<stage> stages;      // in the order the profiler reports them
+    std::map<std::string, size_t> index;
+    int runs;
+    double total_time;              // ms, sum over runs
+};
+
+#endif // __PROFILER_H
@@ -0,0 +1,148 @@
+#ifndef __ROI_H
+#define __ROI_H
+
+//
+// Region-of-interest realization.
+//
+// A pipeline defined over an roi_input can be realized over any rectangle of its output.
+// The input rectangle it needs is the output rectangle grown by the stencil halo of every
+// stage, clipped to the image, and only that part of the input is handed to the pipeline
+// and read.  Halide's bounds inference measures the halo once per pipeline, so realizing
+// many rectangles (the tiles of tile_coordinator.h, or the same rectangle frame after frame)
+// costs no further bounds queries:
+//
+//     excursions::roi_input in(Halide::UInt(8), 2);
+//     Halide::Func f = ...pipeline over in.clamped()...;
+//     excursions::roi_pipeline roi(in, f);
+//     excursions::rect r = { 1000, 600, 320, 240 };
+//     Halide::Image<uint8_t> out(r.width, r.height);
+//     roi.realize(image, r, out);          // out(i,j) is f(r.x+i, r.y+j)
+//
+// The input is clamped to the edges of the full image, not of the part that is read, so
+// an ROI result is identical to the same rectangle of a full-frame result.  The image
+// handed to realize() may be a mapped_image, in which case only the pages holding the
+// input rectangle are read from the file.
+//
+
+#include "Halide.h"
+#include <algorithm>
+#include <string>
+#include <stdio.h>
+
+namespace excursions {
+
+struct rect {
+    int x, y, width, height;
+};
+
+// A view of the rectangle r of 'image', with its min at (r.x, r.y) (other dimensions are
+// kept whole); valid while 'image' is alive
+inline Halide::Buffer crop(Halide::Buffer image, const rect &r) {
+    buffer_t buf = *image.raw_buffer();
+    const int offset[2] = { r.x - buf.min[0], r.y - buf.min[1] };
+    for (int d=0; d<2; d++)
+        buf.host += (ssize_t)offset[d] * buf.stride[d] * buf.elem_size;
+    buf.min[0] = r.x;       buf.extent[0] = r.width;
+    buf.min[1] = r.y;       buf.extent[1] = r.height;
+    return Halide::Buffer(image.type(), &buf);
+}
+
+// The input of an ROI pipeline: an image parameter which may be bound to a part of an
+// image only, and the size of the full image
+class roi_input {
+public:
+    roi_input(Halide::Type type, int dimensions, const std::string &name = "roi_input") :
+        param(type, dimensions, name), image_width(name + "_width"), image_height(name + "_height") {}
+
+    // The input clamped to the edges of the full image; define the pipeline over this
+    Halide::Func clamped() const {
+        Halide::Var x,y,c;
+        Halide::Func in("roi_clamped");
+        Halide::Expr cx = clamp(x, 0, image_width-1), cy = clamp(y, 0, image_height-1);
+        if (param.dimensions() == 2)
+            in(x,y) = param(cx, cy);
+        else
+            in(x,y,c) = param(cx, cy, c);
+        return in;
+    }
+
+    Halide::ImageParam param;
+    Halide::Param<int> image_width, image_height;
+};
+
+class roi_pipeline {
+public:
+    roi_pipeline(roi_input &input, Halide::Func output) : input(input), output(output), halo_known(false) {}
+
+    // The input rectangle read to compute the output rectangle r of an image of size
+    // width x height: r grown by the halo of the pipeline and clipped to the image
+    rect input_region(const rect &r, int width, int height) {
+        return required_region(r, width, height);
+    }
+
+    // Compute the output rectangle r of 'image' into 'result', a buffer of r's size.
+    // Only input_region(r) of 'image' is read.
+    void realize(Halide::Buffer image, const rect &r, Halide::Buffer result) {
+        if (result.extent(0) != r.width || result.extent(1) != r.height) {
+            fprintf(stderr, "roi_pipeline: %dx%d output buffer for a %dx%d region\n",
+                    result.extent(0), result.extent(1), r.width, r.height);
+            return;
+        }
+        // A view of the result placed at (r.x, r.y) in the output coordinates
+        buffer_t placed = *result.raw_buffer();
+        placed.min[0] = r.x;
+        placed.min[1] = r.y;
+        Halide::Buffer out(result.type(), &placed);
+        const rect region = required_region(r, image.extent(0), image.extent(1));
+        input.image_width.set(image.extent(0));
+        input.image_height.set(image.extent(1));
+        input.param.set(crop(image, region));
+        output.realize(out);
+    }
+
+private:
+    // The input rectangle needed to compute r: r grown by the halo, clipped to the image
+    rect required_region(const rect &r, int width, int height) {
+        if (!halo_known)
+            infer_halo();
+        const int x0 = std::max(0, r.x - halo.left), y0 = std::max(0, r.y - halo.top);
+        const int x1 = std::min(width, r.x + r.width + halo.right);
+        const int y1 = std::min(height, r.y + r.height + halo.bottom);
+        rect region = { x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0) };
+        return region;
+    }
+
+    // Bounds inference of the input rectangle of a probe rectangle far from the edges of a
+    // large image, so that clamping does not clip it.  The halo of a stencil pipeline does
+    // not depend on where the rectangle is.
+    void infer_halo() {
+        const int probe = 64, center = 1 << 20;
+        const int dimensions = output.dimensions();
+        input.image_width.set(2 * center);
+        input.image_height.set(2 * center);
+        Halide::Buffer query(output.output_types()[0], probe, probe, dimensions > 2 ? 1 : 0, dimensions > 3 ? 1 : 0);
+        query.set_min(center, center);
+        // With the input unbound, bounds inference binds it to a buffer of the required region
+        input.param.set(Halide::Buffer());
+        output.infer_input_bounds(query);
+        Halide::Buffer required = input.param.get();
+        halo.left = center - required.min(0);
+        halo.top = center - required.min(1);
+        halo.right = required.min(0) + required.extent(0) - (center + probe);
+        halo.bottom = required.min(1) + required.extent(1) - (center + probe);
+        input.param.set(Halide::Buffer());
+        halo_known = true;
+    }
+
+    roi_input &input;
+    Halide::Func output;
+    // How far the input read for an output rectangle extends beyond it on each side
+    struct {
+        int left, top, right, bottom;
+    } halo;
+    bool halo_known;
+};
+
+} // namespace excursions
+
+#endif // __ROI_H
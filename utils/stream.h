@@ -0,0 +1,360 @@
+#ifndef __STREAM_H
+#define __STREAM_H
+
+//
+// Continuous (video) stream processing.
+//
+// A stream_runner pulls frames from a frame_source, runs a compiled pipeline on each frame
+// and pushes the results to a frame_sink.  Reading, processing and writing run on three
+// threads, so that frame N is processed while frame N+1 is decoded and frame N-1 is written.
+// All frames live in a fixed ring of buffers which are allocated once, before the stream
+// starts.
+//
+// Sources:   ppm_sequence_source  numbered binary PPM files (8 bit), e.g. "frames/%05d.ppm"
+//            yuv_file_source      a raw IYUV (I420) file: the Y, U and V planes of each frame
+//                                 are stored one after the other.  A frame is read into a
+//                                 width x (height * 3/2) image with the same layout.
+//            synthetic_source     a moving test pattern
+// Sinks:     ppm_sequence_sink, null_sink
+//
+
+#include "Halide.h"
+#include "clock.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+namespace excursions {
+
+class frame_source {
+public:
+    virtual ~frame_source() {}
+    // The frame buffers the source reads into
+    virtual Halide::Image<uint8_t> allocate_frame() const = 0;
+    // Read the next frame into 'frame'.  Returns false at the end of the stream.
+    virtual bool read(Halide::Image<uint8_t> &frame) = 0;
+};
+
+class frame_sink {
+public:
+    virtual ~frame_sink() {}
+    virtual void write(const Halide::Image<uint8_t> &frame, int frame_number) = 0;
+};
+
+// Reads an 8-bit P6 header; returns false if the file is not one
+inline bool read_ppm_header(FILE *f, int &width, int &height) {
+    char header[256];
+    int maxval;
+    if (fscanf(f, "%255s %d %d %d", header, &width, &height, &maxval) != 4 || fgetc(f) == EOF)
+        return false;
+    return (header[0] == 'P' || header[0] == 'p') && header[1] == '6' && maxval == 255;
+}
+
+class ppm_sequence_source : public frame_source {
+public:
+    // 'pattern' is a printf pattern with one integer conversion, e.g. "frames/%05d.ppm".
+    // The sequence ends at the first missing frame, or after 'count' frames if count >= 0.
+    ppm_sequence_source(const std::string &pattern, int first = 0, int count = -1)
+        : pattern(pattern), next(first), last(count < 0 ? -1 : first + count) {
+        FILE *f = open(first);
+        width = height = 0;
+        if (f) {
+            read_ppm_header(f, width, height);
+            fclose(f);
+        }
+        row.resize(width * 3);
+    }
+
+    virtual Halide::Image<uint8_t> allocate_frame() const {
+        return Halide::Image<uint8_t>(width, height, 3);
+    }
+
+    virtual bool read(Halide::Image<uint8_t> &frame) {
+        if (last >= 0 && next >= last)
+            return false;
+        FILE *f = open(next);
+        if (!f)
+            return false;
+        int w, h;
+        bool ok = read_ppm_header(f, w, h) && w == width && h == height;
+        // de-interleave one row at a time into the planar frame
+        for (int y=0; ok && y<height; y++) {
+            ok = fread(&row[0], 1, row.size(), f) == row.size();
+            for (int x=0; ok && x<width; x++) {
+                frame(x, y, 0) = row[3*x];
+                frame(x, y, 1) = row[3*x + 1];
+                frame(x, y, 2) = row[3*x + 2];
+            }
+        }
+        fclose(f);
+        next++;
+        if (!ok)
+            fprintf(stderr, "ppm_sequence_source: frame %d is not a %dx%d 8-bit PPM\n", next - 1, width, height);
+        return ok;
+    }
+
+private:
+    FILE *open(int n) const {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), pattern.c_str(), n);
+        return fopen(filename, "rb");
+    }
+
+    std::string pattern;
+    int next, last;
+    int width, height;
+    std::vector<uint8_t> row;
+};
+
+class yuv_file_source : public frame_source {
+public:
+    yuv_file_source(const std::string &filename, int width, int height)
+        : width(width), height(height), f(fopen(filename.c_str(), "rb")) {
+        if (!f)
+            fprintf(stderr, "yuv_file_source: could not open %s\n", filename.c_str());
+    }
+    ~yuv_file_source() {
+        if (f)
+            fclose(f);
+    }
+
+    virtual Halide::Image<uint8_t> allocate_frame() const {
+        return Halide::Image<uint8_t>(width, height * 3 / 2);
+    }
+
+    virtual bool read(Halide::Image<uint8_t> &frame) {
+        const size_t frame_size = (size_t)width * (height * 3 / 2);
+        return f && fread(frame.data(), 1, frame_size, f) == frame_size;
+    }
+
+private:
+    int width, height;
+    FILE *f;
+};
+
+class synthetic_source : public frame_source {
+public:
+    synthetic_source(int width, int height, int count) : width(width), height(height), count(count), next(0) {}
+
+    virtual Halide::Image<uint8_t> allocate_frame() const {
+        return Halide::Image<uint8_t>(width, height, 3);
+    }
+
+    // Diagonal color bands, moving by a few pixels per frame
+    virtual bool read(Halide::Image<uint8_t> &frame) {
+        if (next >= count)
+            return false;
+        for (int c=0; c<3; c++)
+            for (int y=0; y<height; y++)
+                for (int x=0; x<width; x++)
+                    frame(x, y, c) = (uint8_t)((x + y + 3*next) * (c + 1));
+        next++;
+        return true;
+    }
+
+private:
+    int width, height, count, next;
+};
+
+class ppm_sequence_sink : public frame_sink {
+public:
+    ppm_sequence_sink(const std::string &pattern) : pattern(pattern) {}
+
+    virtual void write(const Halide::Image<uint8_t> &frame, int frame_number) {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), pattern.c_str(), frame_number);
+        FILE *f = fopen(filename, "wb");
+        if (!f) {
+            fprintf(stderr, "ppm_sequence_sink: could not open %s\n", filename);
+            return;
+        }
+        const int width = frame.width(), height = frame.height();
+        const int channels = frame.dimensions() > 2 ? frame.channels() : 1;
+        row.resize(width * 3);
+        fprintf(f, "P6\n%d %d\n255\n", width, height);
+        for (int y=0; y<height; y++) {
+            for (int x=0; x<width; x++)
+                for (int c=0; c<3; c++)
+                    row[3*x + c] = channels == 1 ? frame(x, y) : frame(x, y, std::min(c, channels - 1));
+            fwrite(&row[0], 1, row.size(), f);
+        }
+        fclose(f);
+    }
+
+private:
+    std::string pattern;
+    std::vector<uint8_t> row;
+};
+
+class null_sink : public frame_sink {
+public:
+    virtual void write(const Halide::Image<uint8_t> &frame, int frame_number) {}
+};
+
+struct stream_stats {
+    int frames;
+    double fps;                 // throughput, frames per second
+    double mean_latency;        // ms, from the start of reading a frame to the end of writing it
+    double max_latency;
+    double p99_latency;
+    double jitter;              // ms, standard deviation of the interval between written frames
+    double mean_process;        // ms, time spent in the pipeline per frame
+
+    void print(const char *title) const {
+        printf("%s: %d frames, %.1f fps, latency mean %.2f ms p99 %.2f ms max %.2f ms, "
+               "jitter %.2f ms, pipeline %.2f ms/frame\n",
+               title, frames, fps, mean_latency, p99_latency, max_latency, jitter, mean_process);
+    }
+};
+
+class stream_runner {
+public:
+    // Runs the pipeline on one input frame, writing into the output frame
+    typedef std::function<void(Halide::Image<uint8_t> &, Halide::Image<uint8_t> &)> process_fn;
+
+    // 'output_frame' is the shape of the output frames; 'ring_size' buffers are allocated
+    // for the input frames, and as many for the output frames
+    stream_runner(frame_source &source, frame_sink &sink, Halide::Image<uint8_t> output_frame, int ring_size = 3)
+        : source(source), sink(sink) {
+        for (int i=0; i<ring_size; i++) {
+            inputs.push_back(source.allocate_frame());
+            outputs.push_back(i == 0 ? output_frame : Halide::Image<uint8_t>(output_frame.width(),
+                              output_frame.height(), output_frame.dimensions() > 2 ? output_frame.channels() : 0));
+        }
+        input_slots.resize(ring_size);
+        output_slots.resize(ring_size);
+    }
+
+    stream_stats run(process_fn process) {
+        slot_queue free_in, full_in, free_out, full_out;
+        for (size_t i=0; i<inputs.size(); i++) {
+            free_in.push(i);
+            free_out.push(i);
+        }
+        std::vector<double> latencies, write_times;
+        timings process_time;
+        const double start = current_time();
+
+        std::thread reader([&]() {
+            int n = 0;
+            for (;;) {
+                int slot = free_in.pop();
+                if (slot < 0)
+                    break;
+                input_slots[slot].start = current_time();
+                input_slots[slot].frame_number = n++;
+                if (!source.read(inputs[slot]))
+                    break;
+                full_in.push(slot);
+            }
+            full_in.close();
+        });
+
+        std::thread writer([&]() {
+            for (;;) {
+                int slot = full_out.pop();
+                if (slot < 0)
+                    break;
+                sink.write(outputs[slot], output_slots[slot].frame_number);
+                double now = current_time();
+                latencies.push_back(now - output_slots[slot].start);
+                write_times.push_back(now);
+                free_out.push(slot);
+            }
+        });
+
+        for (;;) {
+            int in = full_in.pop();
+            if (in < 0)
+                break;
+            int out = free_out.pop();
+            {
+                interval iv(process_time);
+                process(inputs[in], outputs[out]);
+            }
+            output_slots[out] = input_slots[in];
+            free_in.push(in);
+            full_out.push(out);
+        }
+        full_out.close();
+        free_in.close();
+        reader.join();
+        writer.join();
+
+        stream_stats stats;
+        stats.frames = latencies.size();
+        double elapsed = current_time() - start;
+        stats.fps = elapsed > 0 ? stats.frames * 1000.0 / elapsed : 0;
+        double dev = 0;
+        stats.mean_process = process_time.mean(dev);
+        stats.mean_latency = stats.max_latency = stats.p99_latency = stats.jitter = 0;
+        if (!latencies.empty()) {
+            stats.mean_latency = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+            std::sort(latencies.begin(), latencies.end());
+            stats.max_latency = latencies.back();
+            stats.p99_latency = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        }
+        if (write_times.size() > 2) {
+            std::vector<double> periods;
+            for (size_t i=1; i<write_times.size(); i++)
+                periods.push_back(write_times[i] - write_times[i-1]);
+            double mean = std::accumulate(periods.begin(), periods.end(), 0.0) / periods.size();
+            double sq_sum = 0;
+            for (size_t i=0; i<periods.size(); i++)
+                sq_sum += (periods[i] - mean) * (periods[i] - mean);
+            stats.jitter = std::sqrt(sq_sum / periods.size());
+        }
+        return stats;
+    }
+
+private:
+    struct slot_info {
+        int frame_number;
+        double start;
+    };
+
+    // A blocking FIFO of ring slot indices.  pop() returns -1 once the queue is closed and empty.
+    class slot_queue {
+    public:
+        slot_queue() : closed(false) {}
+        void push(int slot) {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots.push_back(slot);
+            cv.notify_one();
+        }
+        int pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (slots.empty() && !closed)
+                cv.wait(lock);
+            if (slots.empty())
+                return -1;
+            int slot = slots.front();
+            slots.pop_front();
+            return slot;
+        }
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            cv.notify_all();
+        }
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<int> slots;
+        bool closed;
+    };
+
+    frame_source &source;
+    frame_sink &sink;
+    std::vector<Halide::Image<uint8_t> > inputs, outputs;
+    std::vector<slot_info> input_slots, output_slots;
+};
+
+} // namespace excursions
+
+#endif // __STREAM_H
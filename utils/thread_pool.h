@@ -0,0 +1,433 @@
+#ifndef __THREAD_POOL_H
+#define __THREAD_POOL_H
+
+//
+// Per-pipeline thread pools, with CPU affinity and NUMA-local placement of the work.
+//
+// Halide runs the parallel loops of every pipeline of the process on one global thread
+// pool, sized by HL_NUM_THREADS when it is first used.  use_thread_pool(f) installs a
+// custom do_par_for and do_task in f instead, which run its parallel loops on the
+// excursions::thread_pool the calling thread is attached to.  Pipelines co-located in a
+// process can then each be capped to their own number of threads, and the workers of a pool
+// can be pinned to cores, or to the CPUs of NUMA nodes.
+//
+// A parallel loop is split into one contiguous range of iterations per worker, and worker
+// k always starts with range k; a worker that is done with its range takes the remaining
+// iterations of the others.  As memory is placed on the node of the thread that first
+// writes it (first touch), an intermediate produced by rows in parallel is then mostly
+// read back by the workers of the node it was placed on.  numa_image places the pages of
+// its rows the same way before they are first written by the user.
+//
+//     excursions::thread_pool pool(8, excursions::PIN_NODES);
+//     excursions::use_thread_pool(f);
+//     pool.run([&]() { f.realize(out); });
+//
+// A pipeline with the custom do_par_for that is realized by a thread not attached to a
+// pool runs its parallel loops serially.  Parallel loops nested in a parallel loop run
+// serially in the worker running the outer iteration.
+//
+
+#include "Halide.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace excursions {
+
+// The CPUs of each NUMA node this process may run on
+struct numa_topology {
+    std::vector<std::vector<int> > nodes;
+    bool emulated;      // nodes are groups of the CPUs of fewer physical nodes
+
+    numa_topology() : emulated(false) {}
+
+    int cpus() const {
+        int n = 0;
+        for (size_t i=0; i<nodes.size(); i++)
+            n += (int)nodes[i].size();
+        return n;
+    }
+
+    // The nodes of /sys/devices/system/node, restricted to the affinity mask of the
+    // process; a single node of the allowed CPUs if the system does not expose them
+    static numa_topology detect() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            for (int c=0; c<std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN)); c++)
+                CPU_SET(c, &allowed);
+
+        numa_topology topology;
+        for (int node=0; ; node++) {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE *f = fopen(path, "r");
+            if (!f)
+                break;
+            char list[4096] = "";
+            if (!fgets(list, sizeof(list), f))
+                list[0] = 0;
+            fclose(f);
+            std::vector<int> cpus = parse_cpulist(list, allowed);
+            if (!cpus.empty())
+                topology.nodes.push_back(cpus);
+        }
+        if (topology.nodes.empty()) {
+            std::vector<int> cpus;
+            for (int c=0; c<CPU_SETSIZE; c++)
+                if (CPU_ISSET(c, &allowed))
+                    cpus.push_back(c);
+            topology.nodes.push_back(cpus);
+        }
+        return topology;
+    }
+
+    // 'count' nodes: the first 'count' nodes if there are as many, otherwise the CPUs of all
+    // the nodes split into 'count' groups of consecutive CPUs (at least one CPU each), which
+    // stand in for the nodes of a larger machine
+    numa_topology select(int count) const {
+        numa_topology t;
+        if ((int)nodes.size() >= count) {
+            t.nodes.assign(nodes.begin(), nodes.begin() + count);
+            t.emulated = emulated;
+            return t;
+        }
+        std::vector<int> all;
+        for (size_t i=0; i<nodes.size(); i++)
+            all.insert(all.end(), nodes[i].begin(), nodes[i].end());
+        for (int g=0; g<count; g++) {
+            const size_t first = all.size() * g / count, last = std::max(first + 1, all.size() * (g + 1) / count);
+            t.nodes.push_back(std::vector<int>(all.begin() + std::min(first, all.size() - 1),
+                                               all.begin() + std::min(last, all.size())));
+        }
+        t.emulated = true;
+        return t;
+    }
+
+    // Node i alone
+    numa_topology node(int i) const {
+        numa_topology t;
+        t.nodes.push_back(nodes[i]);
+        t.emulated = emulated;
+        return t;
+    }
+
+private:
+    // "0-3,8-11" to the CPUs which are also in 'allowed'
+    static std::vector<int> parse_cpulist(const char *list, const cpu_set_t &allowed) {
+        std::vector<int> cpus;
+        const char *p = list;
+        while (*p >= '0' && *p <= '9') {
+            char *end;
+            const int first = (int)strtol(p, &end, 10);
+            int last = first;
+            p = end;
+            if (*p == '-') {
+                last = (int)strtol(p + 1, &end, 10);
+                p = end;
+            }
+            for (int c=first; c<=last && c<CPU_SETSIZE; c++)
+                if (CPU_ISSET(c, &allowed))
+                    cpus.push_back(c);
+            if (*p == ',')
+                p++;
+        }
+        return cpus;
+    }
+};
+
+// Where the workers of a pool run
+enum thread_placement {
+    PIN_NONE,       // anywhere, as the OS schedules them
+    PIN_CORES,      // each worker on one CPU
+    PIN_NODES       // each worker on the CPUs of one node
+};
+
+class thread_pool;
+
+// The pool of the calling thread, used by pool_do_par_for
+inline thread_pool *&current_thread_pool() {
+    static thread_local thread_pool *pool = NULL;
+    return pool;
+}
+
+// True in the workers of every pool
+inline bool &in_pool_worker() {
+    static thread_local bool worker = false;
+    return worker;
+}
+
+class thread_pool {
+public:
+    typedef int (*task_function)(void *user_context, int index, uint8_t *closure);
+
+    // 'threads' workers (by default one per CPU of the topology), placed on the nodes of
+    // 'topology' in blocks: the first threads/nodes workers on node 0, and so on
+    explicit thread_pool(int threads = 0, thread_placement placement = PIN_NONE,
+                         const numa_topology &topology = numa_topology::detect())
+        : topology(topology), placement(placement), next_id(1), stopping(false) {
+        if (threads <= 0)
+            threads = std::max(1, this->topology.cpus());
+        for (int k=0; k<threads; k++)
+            workers.push_back(std::thread(&thread_pool::worker_loop, this, k, threads));
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t k=0; k<workers.size(); k++)
+            workers[k].join();
+    }
+
+    int threads() const { return (int)workers.size(); }
+
+    // The node of 'topology' worker k runs on
+    int node_of(int k) const { return node_of(k, threads()); }
+
+    // Runs f(user_context, i, closure) for i in [min, min + extent) on the workers, and
+    // returns the first non-zero result, or 0.  With 'balance' set, a worker which is done
+    // with its own range helps with the others.
+    int par_for(void *user_context, task_function f, int min, int extent, uint8_t *closure,
+                bool balance = true) {
+        if (extent <= 0)
+            return 0;
+        if (in_pool_worker()) {
+            for (int i=min; i<min+extent; i++) {
+                int result = f(user_context, i, closure);
+                if (result)
+                    return result;
+            }
+            return 0;
+        }
+
+        job j(user_context, f, min, extent, closure, (int)workers.size(), balance);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            j.id = next_id++;
+            jobs.push_back(&j);
+        }
+        wake.notify_all();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return j.finished == j.participants; });
+        return j.result;
+    }
+
+    // Runs 'work' in the calling thread, with the parallel loops of the pipelines set up by
+    // use_thread_pool on this pool
+    template <typename Work>
+    void run(Work work) {
+        thread_pool *previous = current_thread_pool();
+        current_thread_pool() = this;
+        work();
+        current_thread_pool() = previous;
+    }
+
+private:
+    thread_pool(const thread_pool &);
+    thread_pool &operator=(const thread_pool &);
+
+    // A parallel loop, split into one range of iterations per worker
+    struct job {
+        job(void *user_context, task_function f, int min, int extent, uint8_t *closure,
+            int participants, bool balance)
+            : user_context(user_context), f(f), closure(closure), participants(participants),
+              balance(balance), id(0), joined(0), finished(0), result(0), next(participants), end(participants) {
+            for (int k=0; k<participants; k++) {
+                next[k] = min + (int)((int64_t)extent * k / participants);
+                end[k] = min + (int)((int64_t)extent * (k + 1) / participants);
+            }
+        }
+
+        // Runs the iterations of range k not taken by another worker yet
+        void run_range(int k) {
+            for (int i = next[k]++; i < end[k]; i = next[k]++) {
+                int r = f(user_context, i, closure);
+                if (r) {
+                    int expected = 0;
+                    result.compare_exchange_strong(expected, r);
+                }
+            }
+        }
+
+        void *user_context;
+        task_function f;
+        uint8_t *closure;
+        int participants;
+        bool balance;
+        uint64_t id;
+        int joined, finished;       // workers, under the pool mutex
+        std::atomic<int> result;
+        std::vector<std::atomic<int> > next;
+        std::vector<int> end;
+    };
+
+    int node_of(int k, int threads) const {
+        return (int)((size_t)k * topology.nodes.size() / threads);
+    }
+
+    void pin(int k, int threads) {
+        if (placement == PIN_NONE || topology.nodes.empty())
+            return;
+        const int node = node_of(k, threads);
+        const std::vector<int> &cpus = topology.nodes[node];
+        if (cpus.empty())
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (placement == PIN_NODES) {
+            for (size_t c=0; c<cpus.size(); c++)
+                CPU_SET(cpus[c], &set);
+        } else {
+            // The workers of a node are consecutive; spread them over its CPUs
+            int first = 0;
+            while (node_of(first, threads) < node)
+                first++;
+            CPU_SET(cpus[(k - first) % cpus.size()], &set);
+        }
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error)
+            fprintf(stderr, "thread_pool: could not pin worker %d: %s\n", k, strerror(error));
+    }
+
+    void worker_loop(int k, int threads) {
+        pin(k, threads);
+        in_pool_worker() = true;
+        current_thread_pool() = this;
+        uint64_t last = 0;
+        for (;;) {
+            job *j = NULL;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || (!jobs.empty() && jobs.back()->id > last); });
+                if (stopping)
+                    return;
+                // The oldest job this worker has not joined yet; jobs leave the queue when
+                // every worker has joined them
+                for (size_t i=0; i<jobs.size() && !j; i++)
+                    if (jobs[i]->id > last)
+                        j = jobs[i];
+                last = j->id;
+                if (++j->joined == j->participants)
+                    jobs.erase(std::find(jobs.begin(), jobs.end(), j));
+            }
+
+            j->run_range(k);
+            if (j->balance)
+                for (int other=1; other<j->participants; other++)
+                    j->run_range((k + other) % j->participants);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++j->finished == j->participants)
+                done.notify_all();
+        }
+    }
+
+    numa_topology topology;
+    thread_placement placement;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::deque<job *> jobs;
+    uint64_t next_id;
+    bool stopping;
+};
+
+// Custom Halide do_par_for and do_task running the parallel loops on the pool of the
+// calling thread (see thread_pool::run), or serially without one
+inline int pool_do_task(void *user_context, int (*f)(void *, int, uint8_t *), int idx, uint8_t *closure) {
+    return f(user_context, idx, closure);
+}
+
+inline int pool_do_par_for(void *user_context, int (*f)(void *, int, uint8_t *), int min, int extent,
+                           uint8_t *closure) {
+    thread_pool *pool = current_thread_pool();
+    if (pool)
+        return pool->par_for(user_context, f, min, extent, closure);
+    for (int i=min; i<min+extent; i++) {
+        int result = pool_do_task(user_context, f, i, closure);
+        if (result)
+            return result;
+    }
+    return 0;
+}
+
+// Run the parallel loops of f on the pool of the thread that realizes it
+inline void use_thread_pool(Halide::Func f) {
+    f.set_custom_do_par_for(pool_do_par_for);
+    f.set_custom_do_task(pool_do_task);
+}
+
+// A dense, planar image in fresh pages whose rows are first written by the workers of a
+// pool, each the rows of its range of a parallel loop over y, so they are placed on the
+// nodes of the workers that process them
+template <typename T>
+class numa_image {
+public:
+    numa_image(thread_pool &pool, int width, int height, int channels = 0)
+        : size((size_t)width * height * std::max(channels, 1) * sizeof(T)) {
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "numa_image: mmap of %zu bytes failed: %s\n", size, strerror(errno));
+            data = NULL;
+        }
+        memset(&buf, 0, sizeof(buf));
+        buf.host = (uint8_t *)data;
+        buf.elem_size = sizeof(T);
+        buf.extent[0] = width;      buf.stride[0] = 1;
+        buf.extent[1] = height;     buf.stride[1] = width;
+        buf.extent[2] = channels;   buf.stride[2] = channels ? width * height : 0;
+        if (data)
+            pool.par_for(this, touch_rows, 0, height, NULL, false);
+    }
+
+    ~numa_image() {
+        if (data)
+            munmap(data, size);
+    }
+
+    bool valid() const { return data != NULL; }
+    int width() const { return buf.extent[0]; }
+    int height() const { return buf.extent[1]; }
+    int channels() const { return buf.extent[2]; }
+    T *pixels() const { return (T *)data; }
+
+    // A view of the pixels; it is valid for the lifetime of this object
+    Halide::Buffer buffer() const { return Halide::Buffer(Halide::type_of<T>(), &buf); }
+
+private:
+    numa_image(const numa_image &);
+    numa_image &operator=(const numa_image &);
+
+    // Writes row y of every channel
+    static int touch_rows(void *user_context, int y, uint8_t *) {
+        numa_image *im = (numa_image *)user_context;
+        for (int c=0; c<std::max(im->buf.extent[2], 1); c++)
+            memset(im->pixels() + (size_t)c * im->buf.stride[2] + (size_t)y * im->buf.stride[1], 0,
+                   (size_t)im->buf.extent[0] * sizeof(T));
+        return 0;
+    }
+
+    size_t size;
+    void *data;
+    buffer_t buf;
+};
+
+} // namespace excursions
+
+#endif // __THREAD_POOL_H
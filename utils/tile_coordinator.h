@@ -0,0 +1,242 @@
+#ifndef __TILE_COORDINATOR_H
+#define __TILE_COORDINATOR_H
+
+//
+// Multi-process tiled execution of an ROI pipeline (see roi.h) over very large images.
+//
+// The output is split into tiles, and a pool of forked worker processes realizes them.
+// Each tile reads its own input rectangle: the tile grown by the halo of the pipeline
+// (the stencil footprint found by bounds inference) and clipped to the image.  Input
+// rectangles of neighbouring tiles overlap by the halo, and the output tiles do not, so
+// the workers write the tiles straight into the output without seams.
+//
+// The input and output images live in shared memory (shared_image) so the workers see them
+// without copies.  Tiles are dispatched over a pipe: the coordinator writes the tile indices,
+// each idle worker reads the next one, and reports the tiles it finished on a second pipe.
+// At most max_outstanding tiles are dispatched and not yet reported, so neither pipe ever
+// holds more than PIPE_BUF bytes: the coordinator never blocks writing a task while the
+// workers block writing their reports, however many tiles there are.
+// The local workers stand in for the nodes of a cluster: only tile indices travel over the
+// pipes, and the images could as well be mapped files on a shared file system.
+//
+//     excursions::shared_image<uint8_t> in(width, height), out(width, height);
+//     excursions::roi_input input(Halide::UInt(8), 2);
+//     Halide::Func f = ...pipeline over input.clamped()...;
+//     f.compile_jit();
+//     excursions::tile_coordinator tiles(input, f, 1024, 1024, 4);
+//     tiles.run(in.buffer(), out.buffer());
+//
+// The workers are forked after the JIT compilation, so they share the compiled pipeline.
+// Halide's thread pool does not survive fork(), so run() shuts it down first, and each
+// worker creates its own with threads_per_worker threads.
+//
+
+#include "Halide.h"
+#include "roi.h"
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+namespace excursions {
+
+// An image in anonymous shared memory, visible to the processes forked after it is created
+template <typename T>
+class shared_image {
+public:
+    shared_image(int width, int height, int channels = 0)
+        : size((size_t)width * height * std::max(channels, 1) * sizeof(T)) {
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "shared_image: mmap of %zu bytes failed: %s\n", size, strerror(errno));
+            data = NULL;
+        }
+        memset(&buf, 0, sizeof(buf));
+        buf.host = (uint8_t *)data;
+        buf.elem_size = sizeof(T);
+        buf.extent[0] = width;      buf.stride[0] = 1;
+        buf.extent[1] = height;     buf.stride[1] = width;
+        buf.extent[2] = channels;   buf.stride[2] = channels ? width * height : 0;
+    }
+    ~shared_image() {
+        if (data)
+            munmap(data, size);
+    }
+
+    bool valid() const { return data != NULL; }
+    // Views of the pixels; they are valid while this shared_image is alive
+    Halide::Buffer buffer() const { return Halide::Buffer(Halide::type_of<T>(), &buf); }
+    Halide::Image<T> image() const { return Halide::Image<T>(buffer()); }
+
+private:
+    shared_image(const shared_image &);
+    shared_image &operator=(const shared_image &);
+
+    size_t size;
+    void *data;
+    buffer_t buf;
+};
+
+class tile_coordinator {
+public:
+    struct stats {
+        int tiles;
+        int workers;
+        int halo;               // widest input margin around a tile
+        double input_overlap;   // input pixels read over all tiles / input pixels
+    };
+
+    tile_coordinator(roi_input &input, Halide::Func output, int tile_width = 1024, int tile_height = 1024,
+                     int workers = (int)sysconf(_SC_NPROCESSORS_ONLN), int threads_per_worker = 0)
+        : roi(input, output), tile_width(tile_width), tile_height(tile_height),
+          workers(std::max(workers, 1)), threads_per_worker(threads_per_worker) {
+        memset(&last, 0, sizeof(last));
+    }
+
+    // The output tiles of a width x height image, in row-major order
+    std::vector<rect> tiles(int width, int height) const {
+        std::vector<rect> list;
+        for (int y=0; y<height; y+=tile_height)
+            for (int x=0; x<width; x+=tile_width) {
+                rect t = { x, y, std::min(tile_width, width - x), std::min(tile_height, height - y) };
+                list.push_back(t);
+            }
+        return list;
+    }
+
+    // Realize 'result' from 'image' (both shared_image buffers, of the same width and
+    // height); returns false if a worker failed or died before finishing its tiles
+    bool run(Halide::Buffer image, Halide::Buffer result) {
+        const int width = image.extent(0), height = image.extent(1);
+        const std::vector<rect> list = tiles(width, height);
+
+        // Overlap of the input rectangles, from the halo of the pipeline
+        double pixels_read = 0;
+        last.halo = 0;
+        for (size_t i=0; i<list.size(); i++) {
+            const rect &t = list[i];
+            const rect in = roi.input_region(t, width, height);
+            pixels_read += (double)in.width * in.height;
+            last.halo = std::max(last.halo, std::max(std::max(t.x - in.x, t.y - in.y),
+                                 std::max(in.x + in.width - t.x - t.width, in.y + in.height - t.y - t.height)));
+        }
+        last.tiles = (int)list.size();
+        last.workers = workers;
+        last.input_overlap = pixels_read / ((double)width * height);
+
+        int tasks[2], done[2];
+        if (pipe(tasks) != 0 || pipe(done) != 0) {
+            fprintf(stderr, "tile_coordinator: pipe failed: %s\n", strerror(errno));
+            return false;
+        }
+        // A worker killed while the coordinator writes tasks must not kill the coordinator.
+        // SIGPIPE is ignored only while the tasks are written; the caller's handler is restored.
+        struct sigaction ignore, previous;
+        memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGPIPE, &ignore, &previous);
+        halide_shutdown_thread_pool();
+
+        std::vector<pid_t> pids;
+        for (int w=0; w<workers; w++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(tasks[1]);
+                close(done[0]);
+                worker(image, result, list, tasks[0], done[1]);
+                _exit(EXIT_SUCCESS);
+            }
+            if (pid < 0) {
+                fprintf(stderr, "tile_coordinator: fork failed: %s\n", strerror(errno));
+                break;
+            }
+            pids.push_back(pid);
+        }
+        close(tasks[0]);
+        close(done[1]);
+
+        // Dispatch while draining the reports.  At the end of the tasks (or when a write
+        // fails) the tasks pipe is closed: the workers exit when it is drained, and the
+        // reports end when the last worker exits.
+        const int count = pids.empty() ? 0 : (int)list.size();
+        int dispatched = 0, finished = 0, index;
+        bool tasks_open = true;
+        for (;;) {
+            bool failed = false;
+            while (tasks_open && dispatched < count && dispatched - finished < max_outstanding) {
+                if (write(tasks[1], &dispatched, sizeof(dispatched)) != (ssize_t)sizeof(dispatched)) {
+                    failed = true;
+                    break;
+                }
+                dispatched++;
+            }
+            if (tasks_open && (failed || dispatched == count)) {
+                close(tasks[1]);
+                sigaction(SIGPIPE, &previous, NULL);
+                tasks_open = false;
+            }
+            if (read(done[0], &index, sizeof(index)) != (ssize_t)sizeof(index))
+                break;
+            finished++;
+        }
+        // Every worker died with tiles left
+        if (tasks_open) {
+            close(tasks[1]);
+            sigaction(SIGPIPE, &previous, NULL);
+        }
+        close(done[0]);
+
+        bool ok = finished == (int)list.size();
+        for (size_t w=0; w<pids.size(); w++) {
+            int status = 0;
+            waitpid(pids[w], &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                fprintf(stderr, "tile_coordinator: worker %d failed\n", (int)pids[w]);
+                ok = false;
+            }
+        }
+        if (finished != (int)list.size())
+            fprintf(stderr, "tile_coordinator: %d of %d tiles finished\n", finished, (int)list.size());
+        return ok;
+    }
+
+    const stats &get_stats() const { return last; }
+
+private:
+    void worker(Halide::Buffer image, Halide::Buffer result, const std::vector<rect> &list,
+                int tasks, int done) {
+        if (threads_per_worker > 0) {
+            char value[16];
+            snprintf(value, sizeof(value), "%d", threads_per_worker);
+            setenv("HL_NUM_THREADS", value, 1);
+        }
+        int index;
+        while (read(tasks, &index, sizeof(index)) == (ssize_t)sizeof(index)) {
+            roi.realize(image, list[index], crop(result, list[index]));
+            if (write(done, &index, sizeof(index)) != (ssize_t)sizeof(index))
+                break;
+        }
+        halide_shutdown_thread_pool();
+    }
+
+    // Tiles dispatched and not yet reported: the tasks and the reports in flight each fit
+    // in one atomic pipe write, so writing them never blocks on a full pipe
+    static const int max_outstanding = PIPE_BUF / (int)sizeof(int);
+
+    roi_pipeline roi;
+    int tile_width, tile_height;
+    int workers, threads_per_worker;
+    stats last;
+};
+
+} // namespace excursions
+
+#endif // __TILE_COORDINATOR_H
@@ -7,10 +7,12 @@
 //  purposes.
 //
 // TODO: the functions in this file assume printf is used for user i/o.  This needs to be paramaterized
-// TODO: functions currently ignore strides
+// TODO: functions other than compare_images currently ignore strides
 
 #include "Halide.h"
 #include <stdio.h>
+#include <string.h>
+#include <cmath>
 #include <limits>       // std::numeric_limits
 
 #define USE_HALIDE_JIT     1
@@ -151,20 +153,146 @@ void init_monotonic(Halide::Image<T> &img) {
     }
 }
 
-// Returns true if images are binary equals
+// Element-wise tolerance of compare_images: a value matches the expected value if it is
+// within 'absolute' of it, or, for floating-point images, within 'ulps' units in the last
+// place of it.  The default tolerance is an exact match.
+struct image_tolerance {
+    double absolute;
+    int ulps;
+    explicit image_tolerance(double absolute = 0, int ulps = 0) : absolute(absolute), ulps(ulps) {}
+};
+
+struct image_comparison {
+    bool match;                 // same extents, and every element within the tolerance
+    size_t mismatches;          // elements outside the tolerance
+    double max_error;           // largest absolute difference
+    int max_error_at[4];        // coordinates of the largest difference
+    int first_mismatch_at[4];   // coordinates of the first mismatch, scanning x, then y, z and w
+
+    void print(const char *title, FILE *f = stdout) const {
+        if (match) {
+            fprintf(f, "%s: match, max error %g\n", title, max_error);
+            return;
+        }
+        fprintf(f, "%s: %zu mismatches, first at (%d,%d,%d,%d), max error %g at (%d,%d,%d,%d)\n", title, mismatches,
+                first_mismatch_at[0], first_mismatch_at[1], first_mismatch_at[2], first_mismatch_at[3], max_error,
+                max_error_at[0], max_error_at[1], max_error_at[2], max_error_at[3]);
+    }
+};
+
+// The distance between two floats in units in the last place
+inline int64_t ulp_distance(float a, float b) {
+    int32_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    // Map the sign-magnitude representation to a monotonic one
+    int64_t la = ia < 0 ? (int64_t)INT32_MIN - ia : ia;
+    int64_t lb = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+    return la > lb ? la - lb : lb - la;
+}
+
+inline int64_t ulp_distance(double a, double b) {
+    int64_t ia, ib;
+    memcpy(&ia, &a, sizeof(ia));
+    memcpy(&ib, &b, sizeof(ib));
+    if (ia < 0)
+        ia = INT64_MIN - ia;
+    if (ib < 0)
+        ib = INT64_MIN - ib;
+    // The difference of values of opposite signs may not fit in an int64_t
+    const uint64_t d = ia > ib ? (uint64_t)ia - (uint64_t)ib : (uint64_t)ib - (uint64_t)ia;
+    return d > (uint64_t)INT64_MAX ? INT64_MAX : (int64_t)d;
+}
+
 template <typename T>
-bool compare_images(Halide::Image<T> im1, Halide::Image<T> im2) {
-    if (im1.dimensions() != im2.dimensions())
+bool within_tolerance(T actual, T expected, const image_tolerance &tol) {
+    const double error = std::fabs((double)actual - (double)expected);
+    if (error <= tol.absolute)
+        return true;
+    if (std::numeric_limits<T>::is_integer)
         return false;
-    
-    size_t img_size = sizeof(T);  // image size in bytes
-    for (int d=0; d<im1.dimensions(); d++) {
-        if (im1.extent(d) != im2.extent(d))
-            return false;
-        img_size *= im1.extent(d);
+    if (actual != actual || expected != expected)   // a NaN matches only a NaN
+        return actual != actual && expected != expected;
+    const int64_t ulps = sizeof(T) == sizeof(float) ? ulp_distance((float)actual, (float)expected)
+                                                    : ulp_distance((double)actual, (double)expected);
+    return tol.ulps > 0 && ulps <= tol.ulps;
+}
+
+// Compares 'actual' with 'expected' element by element, within 'tol'.  The images may have
+// any strides and mins (elements are matched by their offset from the min of each image).
+// Each row is first scanned with a branch-free loop, which the compiler vectorizes for
+// unit-stride rows; only the rows with an error above the tolerance (or a NaN in either
+// image) or above the largest error seen so far are scanned again to locate the errors.
+template <typename T>
+image_comparison compare_images(const Halide::Image<T> &actual, const Halide::Image<T> &expected,
+                                const image_tolerance &tol) {
+    image_comparison result;
+    memset(&result, 0, sizeof(result));
+    result.match = actual.dimensions() == expected.dimensions();
+    for (int d=0; d<actual.dimensions() && result.match; d++)
+        result.match = actual.extent(d) == expected.extent(d);
+    if (!result.match)
+        return result;
+
+    const buffer_t *a = actual.raw_buffer(), *e = expected.raw_buffer();
+    int extent[4];
+    for (int d=0; d<4; d++)
+        extent[d] = d < actual.dimensions() ? std::max(a->extent[d], 1) : 1;
+    const int width = extent[0], sa = a->stride[0], se = e->stride[0];
+
+    for (int w=0; w<extent[3]; w++)
+    for (int z=0; z<extent[2]; z++)
+    for (int y=0; y<extent[1]; y++) {
+        const T *ra = (const T *)a->host + (ssize_t)y * a->stride[1] + (ssize_t)z * a->stride[2] + (ssize_t)w * a->stride[3];
+        const T *re = (const T *)e->host + (ssize_t)y * e->stride[1] + (ssize_t)z * e->stride[2] + (ssize_t)w * e->stride[3];
+
+        double row_max = 0;
+        int above = 0;
+        for (int x=0; x<width; x++) {
+            const double error = std::fabs((double)ra[x * sa] - (double)re[x * se]);
+            row_max = error > row_max ? error : row_max;
+            // Also counts NaN errors, which compare false with everything
+            above += !(error <= tol.absolute);
+        }
+        if (above == 0 && row_max <= result.max_error)
+            continue;
+
+        for (int x=0; x<width; x++) {
+            const T va = ra[x * sa], ve = re[x * se];
+            const double error = std::fabs((double)va - (double)ve);
+            const int at[4] = { a->min[0] + x, a->min[1] + y, a->min[2] + z, a->min[3] + w };
+            if (error > result.max_error) {
+                result.max_error = error;
+                memcpy(result.max_error_at, at, sizeof(at));
+            }
+            if (!(error <= tol.absolute) && !within_tolerance(va, ve, tol)) {
+                if (result.mismatches++ == 0)
+                    memcpy(result.first_mismatch_at, at, sizeof(at));
+            }
+        }
     }
+    result.match = result.mismatches == 0;
+    return result;
+}
 
-    return (memcmp(im1.data(), im2.data(), img_size) == 0) ;
+// Returns true if the images have the same extents and values (regardless of strides)
+template <typename T>
+bool compare_images(Halide::Image<T> im1, Halide::Image<T> im2) {
+    return compare_images(im1, im2, image_tolerance()).match;
+}
+
+// Returns a width x height x channels buffer with an interleaved layout (the channel
+// is the innermost dimension in memory), as used by most image file formats and displays.
+// The pixels are owned by 'storage', which must outlive the returned buffer.
+template <typename T>
+Halide::Buffer interleaved_buffer(Halide::Image<T> &storage, int width, int height, int channels) {
+    storage = Halide::Image<T>(channels, width, height);
+    buffer_t buf = *storage.raw_buffer();
+    buf.extent[0] = width;    buf.stride[0] = channels;           buf.min[0] = 0;
+    buf.extent[1] = height;   buf.stride[1] = channels * width;   buf.min[1] = 0;
+    buf.extent[2] = channels; buf.stride[2] = 1;                  buf.min[2] = 0;
+    buf.extent[3] = 0;        buf.stride[3] = 0;                  buf.min[3] = 0;
+    return Halide::Buffer(Halide::type_of<T>(), &buf);
 }
 
 template <typename T>